@@ -0,0 +1,422 @@
+/* batch.c - Processing files without a display.
+   Copyright (C) 2026 g10 Code GmbH
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The batch mode runs the file operations of GPA from the command
+   line:
+
+     gpa --batch COMMAND [OPTIONS] FILE...
+
+   COMMAND is one of "encrypt", "sign", "decrypt" and "verify".  The
+   files are processed by the same operations as in the file manager,
+   but without showing any windows; messages are written to stderr.
+   Existing files are only replaced with --yes, and only once the new
+   file is complete.  For each file a line
+
+     OK|ERR COMMAND INPUT OUTPUT DETAIL
+
+   is written to stdout as soon as the file is done; the fields are
+   separated by a single space and percent escaped.  OUTPUT is "-" if
+   there is none.  For ERR, DETAIL is the gpg-error code followed by
+   its description.  For verify and decrypt, a line
+
+     SIG INPUT STATUS FINGERPRINT
+
+   follows for each signature, with STATUS being one of "good",
+   "expired", "expiredkey", "revoked", "bad" and "error".  The final
+   line is
+
+     SUMMARY FILES OK FAILED
+
+   where files not processed at all are counted as failed.  The exit
+   status is 0 if all files were processed successfully, 1 if some
+   failed and 2 on usage errors.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gpa.h"
+#include "i18n.h"
+#include "get-path.h"
+#include "options.h"
+#include "gpafileencryptop.h"
+#include "gpafilesignop.h"
+#include "gpafiledecryptop.h"
+#include "gpafileverifyop.h"
+
+
+/* The batch commands.  */
+enum batch_command
+  {
+    BATCH_ENCRYPT,
+    BATCH_SIGN,
+    BATCH_DECRYPT,
+    BATCH_VERIFY
+  };
+
+static const char *command_names[] =
+  { "encrypt", "sign", "decrypt", "verify", NULL };
+
+
+/* The command line options.  */
+static gchar **opt_recipients;
+static gchar **opt_signers;
+static gboolean opt_armor;
+static gboolean opt_detach;
+static gboolean opt_clear;
+
+static GOptionEntry batch_option_entries[] =
+  {
+    { "recipient", 'r', 0, G_OPTION_ARG_STRING_ARRAY, &opt_recipients,
+      N_("Encrypt for KEY"), "KEY" },
+    { "local-user", 'u', 0, G_OPTION_ARG_STRING_ARRAY, &opt_signers,
+      N_("Sign using KEY"), "KEY" },
+    { "armor", 'a', 0, G_OPTION_ARG_NONE, &opt_armor,
+      N_("Create ASCII armored output"), NULL },
+    { "detach", 'b', 0, G_OPTION_ARG_NONE, &opt_detach,
+      N_("Create detached signatures"), NULL },
+    { "clear", 0, 0, G_OPTION_ARG_NONE, &opt_clear,
+      N_("Create cleartext signatures"), NULL },
+    { "yes", 'y', 0, G_OPTION_ARG_NONE, &batch_overwrite,
+      N_("Overwrite existing files"), NULL },
+    { "workers", 'j', 0, G_OPTION_ARG_INT, &file_workers,
+      N_("Process up to N files at the same time"), "N" },
+    { NULL }
+  };
+
+
+/* The state of the batch run.  */
+static struct
+{
+  enum batch_command command;
+
+  /* The keys given on the command line.  */
+  GList *recipients;
+  GList *signers;
+
+  GMainLoop *loop;
+  unsigned int n_files;
+  unsigned int n_ok;
+} batch;
+
+
+
+/* Return a malloced copy of STRING for use as a field of a result
+   line.  */
+static gchar *
+escape_field (const char *string)
+{
+  GString *result;
+  const unsigned char *s;
+
+  if (!string || !*string)
+    return g_strdup ("-");
+
+  result = g_string_sized_new (strlen (string));
+  for (s = (const unsigned char *) string; *s; s++)
+    {
+      if (*s <= ' ' || *s == '%' || *s == 0x7f)
+        g_string_append_printf (result, "%%%02X", *s);
+      else
+        g_string_append_c (result, *s);
+    }
+  return g_string_free (result, FALSE);
+}
+
+
+/* Print a line with the KEYWORD and the fields given as NULL
+   terminated list of strings.  */
+static void
+print_line (const char *keyword, ...)
+{
+  va_list arg_ptr;
+  const char *text;
+  gchar *field;
+
+  fputs (keyword, stdout);
+  va_start (arg_ptr, keyword);
+  while ((text = va_arg (arg_ptr, const char *)))
+    {
+      field = escape_field (text);
+      putc (' ', stdout);
+      fputs (field, stdout);
+      g_free (field);
+    }
+  va_end (arg_ptr);
+  putc ('\n', stdout);
+}
+
+
+/* Check the signatures in RESULT.  Returns an error if there is no
+   signature or if a signature is not good.  */
+static gpg_error_t
+check_signatures (gpgme_verify_result_t result)
+{
+  gpgme_signature_t sig;
+
+  if (!result || !result->signatures)
+    return gpg_error (GPG_ERR_NO_DATA);
+  for (sig = result->signatures; sig; sig = sig->next)
+    if (sig->status)
+      return sig->status;
+  return 0;
+}
+
+
+/* Print the result line for ITEM and the lines for its signatures.  */
+static void
+file_done_cb (GpaFileOperation *op, gpa_file_item_t item, guint err,
+              gpointer data)
+{
+  const char *command = command_names[batch.command];
+  gpgme_signature_t sig;
+  char detail[300];
+
+  /* Unlike the file manager, a file whose signatures can not be
+     verified has failed.  */
+  if (!err && batch.command == BATCH_VERIFY)
+    err = check_signatures (item->verify_result);
+
+  if (err)
+    {
+      snprintf (detail, sizeof detail, "%u %s",
+                gpg_err_code (err), gpg_strerror (err));
+      print_line ("ERR", command, item->filename_in, item->filename_out,
+                  detail, NULL);
+    }
+  else
+    {
+      print_line ("OK", command, item->filename_in, item->filename_out,
+                  "-", NULL);
+      batch.n_ok++;
+    }
+
+  for (sig = item->verify_result? item->verify_result->signatures : NULL;
+       sig; sig = sig->next)
+    {
+      const char *status;
+
+      switch (gpg_err_code (sig->status))
+        {
+        case GPG_ERR_NO_ERROR:   status = "good"; break;
+        case GPG_ERR_SIG_EXPIRED: status = "expired"; break;
+        case GPG_ERR_KEY_EXPIRED: status = "expiredkey"; break;
+        case GPG_ERR_CERT_REVOKED: status = "revoked"; break;
+        case GPG_ERR_BAD_SIGNATURE: status = "bad"; break;
+        default: status = "error"; break;
+        }
+      print_line ("SIG", item->filename_in, status, sig->fpr, NULL);
+    }
+  fflush (stdout);
+}
+
+
+static void
+completed_cb (GpaOperation *op, gpg_error_t err, gpointer data)
+{
+  g_main_loop_quit (batch.loop);
+}
+
+
+/* Start the encrypt or sign operation OP with the keys from the
+   command line.  The decrypt and verify operations start by
+   themselves.  */
+static gboolean
+start_cb (gpointer data)
+{
+  if (batch.command == BATCH_ENCRYPT)
+    gpa_file_encrypt_operation_run (data, batch.recipients,
+                                    batch.signers != NULL, batch.signers,
+                                    opt_armor);
+  else
+    gpa_file_sign_operation_run (data, batch.signers, opt_armor,
+                                 opt_detach? GPGME_SIG_MODE_DETACH
+                                 : opt_clear? GPGME_SIG_MODE_CLEAR
+                                 : GPGME_SIG_MODE_NORMAL);
+  return FALSE;
+}
+
+
+
+/* Look up the keys given by NAMES and store them at R_KEYS.  */
+static gpg_error_t
+lookup_keys (gchar **names, int secret, GList **r_keys)
+{
+  gpg_error_t err = 0;
+  gpgme_ctx_t ctx;
+  gpgme_key_t key;
+  int i;
+
+  *r_keys = NULL;
+  if (!names || !*names)
+    return 0;
+
+  err = gpgme_new (&ctx);
+  if (err)
+    return err;
+
+  for (i = 0; names[i]; i++)
+    {
+      gpgme_set_protocol (ctx, GPGME_PROTOCOL_OpenPGP);
+      err = gpgme_get_key (ctx, names[i], &key, secret);
+      if (gpg_err_code (err) == GPG_ERR_EOF && cms_hack)
+        {
+          gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
+          err = gpgme_get_key (ctx, names[i], &key, secret);
+        }
+      if (gpg_err_code (err) == GPG_ERR_EOF)
+        err = gpg_error (secret? GPG_ERR_NO_SECKEY : GPG_ERR_NO_PUBKEY);
+      if (err)
+        {
+          g_printerr ("gpa: %s: %s\n", names[i], gpg_strerror (err));
+          break;
+        }
+      *r_keys = g_list_append (*r_keys, key);
+    }
+
+  gpgme_release (ctx);
+  return err;
+}
+
+
+static void
+release_keys (GList *keys)
+{
+  g_list_free_full (keys, (GDestroyNotify) gpgme_key_unref);
+}
+
+
+/* Run the batch mode.  ARGV[0] is the "--batch" option.  Returns the
+   exit status.  */
+int
+gpa_batch_main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GpaFileOperation *op;
+  GList *files = NULL;
+  gchar *configname;
+  int i;
+
+  context = g_option_context_new (N_("COMMAND FILE..."));
+  g_option_context_set_summary
+    (context, N_("Process files without a display.  COMMAND is one of"
+                 " encrypt, sign, decrypt and verify."));
+  g_option_context_set_translation_domain (context, PACKAGE);
+  g_option_context_add_main_entries (context, batch_option_entries, PACKAGE);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("gpa: %s\n", error->message);
+      g_error_free (error);
+      g_option_context_free (context);
+      return 2;
+    }
+  g_option_context_free (context);
+
+  for (i = 0; argc > 1 && command_names[i]; i++)
+    if (!strcmp (argv[1], command_names[i]))
+      break;
+  if (argc < 3 || !command_names[i])
+    {
+      g_printerr ("usage: gpa --batch %s\n", "COMMAND [OPTIONS] FILE...");
+      return 2;
+    }
+  batch.command = i;
+
+  if (batch.command == BATCH_ENCRYPT && !opt_recipients)
+    {
+      g_printerr ("gpa: %s\n", _("No recipients given"));
+      return 2;
+    }
+  if (batch.command == BATCH_SIGN && !opt_signers)
+    {
+      g_printerr ("gpa: %s\n", _("No signing key given"));
+      return 2;
+    }
+  if (lookup_keys (opt_recipients, 0, &batch.recipients)
+      || lookup_keys (opt_signers, 1, &batch.signers))
+    {
+      release_keys (batch.recipients);
+      release_keys (batch.signers);
+      return 2;
+    }
+
+  /* Without --workers, the operations take the number of files
+     processed at the same time from the settings.  */
+  gnupg_homedir = default_homedir ();
+  configname = g_build_filename (gnupg_homedir, "gpa.conf", NULL);
+  gpa_options_set_file (gpa_options_get_instance (), configname);
+  g_free (configname);
+
+  /* The operation takes ownership of the list.  */
+  for (i = 2; i < argc; i++)
+    {
+      gpa_file_item_t file_item = g_malloc0 (sizeof (*file_item));
+
+      file_item->filename_in = g_strdup (argv[i]);
+      files = g_list_append (files, file_item);
+    }
+  batch.n_files = argc - 2;
+
+  switch (batch.command)
+    {
+    case BATCH_ENCRYPT:
+      op = GPA_FILE_OPERATION (gpa_file_encrypt_operation_new (NULL, files,
+                                                               FALSE));
+      break;
+    case BATCH_SIGN:
+      op = GPA_FILE_OPERATION (gpa_file_sign_operation_new (NULL, files,
+                                                            FALSE));
+      break;
+    case BATCH_DECRYPT:
+      op = GPA_FILE_OPERATION (gpa_file_decrypt_verify_operation_new (NULL,
+                                                                      files));
+      break;
+    default:
+      op = GPA_FILE_OPERATION (gpa_file_verify_operation_new (NULL, files));
+      break;
+    }
+  /* Each file gets a result line, thus do not stop at the first
+     error as the setting may say.  */
+  g_object_set (op, "keep-going", TRUE, NULL);
+  g_signal_connect (G_OBJECT (op), "file_done",
+                    G_CALLBACK (file_done_cb), NULL);
+  g_signal_connect (G_OBJECT (op), "completed",
+                    G_CALLBACK (completed_cb), NULL);
+  if (batch.command == BATCH_ENCRYPT || batch.command == BATCH_SIGN)
+    g_idle_add (start_cb, op);
+
+  batch.loop = g_main_loop_new (NULL, FALSE);
+  g_main_loop_run (batch.loop);
+  g_main_loop_unref (batch.loop);
+  g_object_unref (op);
+
+  printf ("SUMMARY %u %u %u\n",
+          batch.n_files, batch.n_ok, batch.n_files - batch.n_ok);
+  fflush (stdout);
+
+  release_keys (batch.recipients);
+  release_keys (batch.signers);
+  return batch.n_ok == batch.n_files? 0 : 1;
+}
@@ -382,7 +382,8 @@ file_open (GSimpleAction *simple, GVariant *parameter, gpointer param)
   struct stat buf;
   int res;
   gboolean suc;
-  gchar *contents;
+  GMappedFile *map = NULL;
+  gchar *contents = NULL;
   gsize length;
   GError *err = NULL;
   const gchar *end;
@@ -454,7 +455,21 @@ file_open (GSimpleAction *simple, GVariant *parameter, gpointer param)
 	}
     }
 
-  suc = g_file_get_contents (filename, &contents, &length, &err);
+  /* Map regular files instead of copying them into memory.  */
+  if (S_ISREG (buf.st_mode))
+    {
+      map = g_mapped_file_new (filename, FALSE, &err);
+      suc = !!map;
+      if (map)
+        {
+          contents = g_mapped_file_get_contents (map);
+          length = g_mapped_file_get_length (map);
+          if (! contents)
+            contents = (gchar *) "";
+        }
+    }
+  else
+    suc = g_file_get_contents (filename, &contents, &length, &err);
   if (! suc)
     {
       gchar *str;
@@ -476,13 +491,19 @@ file_open (GSimpleAction *simple, GVariant *parameter, gpointer param)
 			     filename, ((int) (end - contents)));
       gpa_window_error (str, GTK_WIDGET (clipboard));
       g_free (str);
-      g_free (contents);
+      if (map)
+        g_mapped_file_unref (map);
+      else
+        g_free (contents);
       g_free (filename);
       return;
     }
 
   gtk_text_buffer_set_text (clipboard->text_buffer, contents, length);
-  g_free (contents);
+  if (map)
+    g_mapped_file_unref (map);
+  else
+    g_free (contents);
 }
 
 
@@ -405,6 +405,14 @@ reload_more_data_idle_cb (void *user_data)
 }
 
 
+/* Reload more data once the secret keys are available.  */
+static void
+secret_keys_ready_cb (GpaKeyTable *keytable, void *user_data)
+{
+  g_idle_add (reload_more_data_idle_cb, user_data);
+}
+
+
 struct scd_getattr_parm
 {
   GpaCMPiv *card;  /* The object.  */
@@ -508,8 +516,8 @@ reload_data (GpaCMPiv *card)
       /* We need to ensure that secret keys are loaded because
        * eventually gpa_key_details_update will be called which
        * requires that.  */
-      gpa_keytable_ensure (gpa_keytable_get_secret_instance());
-      g_idle_add (reload_more_data_idle_cb, card);
+      gpa_keytable_when_ready (gpa_keytable_get_secret_instance (),
+                               secret_keys_ready_cb, card);
     }
   card->reloading--;
   g_debug ("downed reloading counter (count=%d)", card->reloading);
@@ -47,6 +47,7 @@
 #include "gpafileencryptop.h"
 #include "gpafilesignop.h"
 #include "gpafileverifyop.h"
+#include "gpafilechecksumop.h"
 
 
 #if ! GTK_CHECK_VERSION (2, 10, 0)
@@ -61,6 +62,9 @@ struct _GpaFileManager
 
   GtkWidget *window;
   GtkWidget *list_files;
+  /* Maps the UTF-8 names of the files in the list to their rows
+     (GtkTreeIters, which persist in a GtkListStore).  */
+  GHashTable *file_rows;
   GList *selection_sensitive_actions;
 };
 
@@ -86,6 +90,7 @@ typedef gboolean (*sensitivity_func_t)(gpointer);
 enum
 {
   FILE_NAME_COLUMN,
+  FILE_STATUS_COLUMN,
   FILE_N_COLUMNS
 };
 
@@ -115,6 +120,9 @@ static GObject *gpa_file_manager_constructor
 static void
 gpa_file_manager_finalize (GObject *object)
 {
+  GpaFileManager *fileman = GPA_FILE_MANAGER (object);
+
+  g_hash_table_destroy (fileman->file_rows);
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -123,6 +131,8 @@ static void
 gpa_file_manager_init (GpaFileManager *fileman)
 {
   fileman->selection_sensitive_actions = NULL;
+  fileman->file_rows = g_hash_table_new_full
+    (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
 }
 
 static void
@@ -180,23 +190,24 @@ get_selected_files (GtkWidget *list)
   GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (list));
   GtkTreeSelection *sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
   GList *selection = gtk_tree_selection_get_selected_rows (sel, &model);
+  GList *cur;
   GList *files = NULL;
 
-  while (selection)
+  for (cur = selection; cur; cur = g_list_next (cur))
     {
       gpa_file_item_t file_item;
       gchar *filename;
       GtkTreeIter iter;
 
-      gtk_tree_model_get_iter (model, &iter, (GtkTreePath*) selection->data);
+      gtk_tree_model_get_iter (model, &iter, (GtkTreePath*) cur->data);
       gtk_tree_model_get (model, &iter, FILE_NAME_COLUMN, &filename, -1);
 
       file_item = g_malloc0 (sizeof (*file_item));
       file_item->filename_in = filename;
 
-      files = g_list_append (files, file_item);
-      selection = g_list_next (selection);
+      files = g_list_prepend (files, file_item);
     }
+  files = g_list_reverse (files);
 
   /* Free the selection */
   g_list_foreach (selection, (GFunc) gtk_tree_path_free, NULL);
@@ -206,13 +217,29 @@ get_selected_files (GtkWidget *list)
 }
 
 
+/* Find the row of the UTF-8 encoded FILENAME_UTF8 in the file list
+   of FILEMAN.  Returns true and sets ITER if it was found.  */
+static gboolean
+find_file (GpaFileManager *fileman, const gchar *filename_utf8,
+           GtkTreeIter *iter)
+{
+  GtkTreeIter *row;
+
+  row = g_hash_table_lookup (fileman->file_rows, filename_utf8);
+  if (!row)
+    return FALSE;
+
+  *iter = *row;
+  return TRUE;
+}
+
+
 /* Add file FILENAME to the file list of FILEMAN and select it */
 static gboolean
 add_file (GpaFileManager *fileman, const gchar *filename)
 {
   GtkListStore *store;
   GtkTreeIter iter;
-  GtkTreePath *path;
   GtkTreeSelection *sel;
   gchar *filename_utf8;
 
@@ -238,32 +265,19 @@ add_file (GpaFileManager *fileman, const gchar *filename)
                           (GTK_TREE_VIEW (fileman->list_files)));
 
   /* Check for duplicates. */
-  path = gtk_tree_path_new_first ();
-  if (gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, path))
-    do
-      {
-	gchar *tmp;
-	gboolean exists;
-
-	gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, FILE_NAME_COLUMN,
-			    &tmp, -1);
-	exists = g_str_equal (filename_utf8, tmp);
-	g_free (tmp);
-	if (exists)
-	  {
-	    g_free (filename_utf8);
-	    gtk_tree_path_free (path);
-	    return FALSE; /* This file is already in our list.  */
-	  }
-      }
-    while (gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter));
-  gtk_tree_path_free (path);
+  if (find_file (fileman, filename_utf8, &iter))
+    {
+      g_free (filename_utf8);
+      return FALSE; /* This file is already in our list.  */
+    }
 
   /* Append it to our list.  */
   gtk_list_store_append (store, &iter);
 
-  /* FIXME: Add the file status when/if gpgme supports it */
-  gtk_list_store_set (store, &iter, FILE_NAME_COLUMN, filename_utf8, -1);
+  gtk_list_store_set (store, &iter, FILE_NAME_COLUMN, filename_utf8,
+                      FILE_STATUS_COLUMN, NULL, -1);
+  g_hash_table_insert (fileman->file_rows, filename_utf8,
+                       gtk_tree_iter_copy (&iter));
 
   /* Select the row */
   sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (fileman->list_files));
@@ -283,12 +297,36 @@ file_created_cb (GpaFileOperation *op, gpa_file_item_t item, gpointer data)
 }
 
 
+/* Show the result of an operation for one file in the list.  */
+static void
+file_done_cb (GpaFileOperation *op, gpa_file_item_t item, guint err,
+              gpointer data)
+{
+  GpaFileManager *fileman = data;
+  GtkListStore *store;
+  GtkTreeIter iter;
+
+  /* The names of the input files are taken from the list and thus
+     are already in UTF-8.  */
+  if (item->direct_in || !item->filename_in
+      || !find_file (fileman, item->filename_in, &iter))
+    return;
+
+  store = GTK_LIST_STORE (gtk_tree_view_get_model
+                          (GTK_TREE_VIEW (fileman->list_files)));
+  gtk_list_store_set (store, &iter, FILE_STATUS_COLUMN,
+                      err ? gpg_strerror (err) : _("OK"), -1);
+}
+
+
 /* Do whatever is required with a file operation, to ensure proper clean up */
 static void
 register_operation (GpaFileManager *fileman, GpaFileOperation *op)
 {
   g_signal_connect (G_OBJECT (op), "created_file",
 		    G_CALLBACK (file_created_cb), fileman);
+  g_signal_connect (G_OBJECT (op), "file_done",
+		    G_CALLBACK (file_done_cb), fileman);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), NULL);
 }
@@ -418,6 +456,7 @@ file_clear (GSimpleAction *simple, GVariant *parameter, gpointer param)
                                         (GTK_TREE_VIEW (fileman->list_files)));
 
   gtk_list_store_clear (store);
+  g_hash_table_remove_all (fileman->file_rows);
 }
 
 
@@ -439,6 +478,44 @@ file_verify (GSimpleAction *simple, GVariant *parameter, gpointer param)
 }
 
 
+/* Handle menu item "File/Create Checksums".  */
+static void
+file_checksum_create (GSimpleAction *simple, GVariant *parameter,
+                      gpointer param)
+{
+  GpaFileManager *fileman = param;
+  GList *files;
+  GpaFileChecksumOperation *op;
+
+  files = get_selected_files (fileman->list_files);
+  if (!files)
+    return;
+
+  op = gpa_file_checksum_operation_new (GTK_WIDGET (fileman), files, FALSE);
+
+  register_operation (fileman, GPA_FILE_OPERATION (op));
+}
+
+
+/* Handle menu item "File/Verify Checksums".  */
+static void
+file_checksum_verify (GSimpleAction *simple, GVariant *parameter,
+                      gpointer param)
+{
+  GpaFileManager *fileman = param;
+  GList *files;
+  GpaFileChecksumOperation *op;
+
+  files = get_selected_files (fileman->list_files);
+  if (!files)
+    return;
+
+  op = gpa_file_checksum_operation_new (GTK_WIDGET (fileman), files, TRUE);
+
+  register_operation (fileman, GPA_FILE_OPERATION (op));
+}
+
+
 /* Handle menu item "File/Sign".  */
 static void
 file_sign (GSimpleAction *simple, GVariant *parameter, gpointer param)
@@ -539,6 +616,8 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
     { "file_verify", file_verify },
     { "file_encrypt", file_encrypt },
     { "file_decrypt", file_decrypt },
+    { "file_checksum_create", file_checksum_create },
+    { "file_checksum_verify", file_checksum_verify },
     { "file_close", file_close },
     { "file_quit", file_quit },
 
@@ -669,6 +748,16 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
               "<attribute name='action'>app.file_decrypt</attribute>"
             "</item>"
           "</section>"
+          "<section>"
+            "<item>"
+              "<attribute name='label' translatable='yes'>Create Checksums</attribute>"
+              "<attribute name='action'>app.file_checksum_create</attribute>"
+            "</item>"
+            "<item>"
+              "<attribute name='label' translatable='yes'>Verify Checksums</attribute>"
+              "<attribute name='action'>app.file_checksum_verify</attribute>"
+            "</item>"
+          "</section>"
           "<section>"
             "<item>"
               "<attribute name='label' translatable='yes'>Close</attribute>"
@@ -1054,6 +1143,12 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
 
   action = (GSimpleAction*)g_action_map_lookup_action (G_ACTION_MAP (gpa_app), "file_decrypt");
   add_selection_sensitive_action (fileman, action, has_selection);
+
+  action = (GSimpleAction*)g_action_map_lookup_action (G_ACTION_MAP (gpa_app), "file_checksum_create");
+  add_selection_sensitive_action (fileman, action, has_selection);
+
+  action = (GSimpleAction*)g_action_map_lookup_action (G_ACTION_MAP (gpa_app), "file_checksum_verify");
+  add_selection_sensitive_action (fileman, action, has_selection);
 }
 
 
@@ -1147,7 +1242,8 @@ file_list_new (GpaFileManager * fileman)
   GtkCellRenderer *renderer;
   GtkTreeViewColumn *column;
   GtkTreeSelection *sel;
-  GtkListStore *store = gtk_list_store_new (1, G_TYPE_STRING);
+  GtkListStore *store = gtk_list_store_new (FILE_N_COLUMNS,
+                                            G_TYPE_STRING, G_TYPE_STRING);
   GtkWidget *list = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
 
   renderer = gtk_cell_renderer_text_new ();
@@ -1155,6 +1251,14 @@ file_list_new (GpaFileManager * fileman)
 						     "text",
 						     FILE_NAME_COLUMN,
 						     NULL);
+  gtk_tree_view_column_set_expand (column, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (list), column);
+
+  renderer = gtk_cell_renderer_text_new ();
+  column = gtk_tree_view_column_new_with_attributes (_("Status"), renderer,
+						     "text",
+						     FILE_STATUS_COLUMN,
+						     NULL);
   gtk_tree_view_append_column (GTK_TREE_VIEW (list), column);
 
   sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
@@ -266,3 +266,33 @@ gpa_add_filewatch (const char *filename, const char *maskstring,
   return NULL;
 #endif /*!HAVE_INOTIFY_INIT*/  
 }
+
+
+/* Remove the file watch HANDLE as returned by gpa_add_filewatch.
+   Passing NULL is allowed.  If called from a watch callback, the
+   watch is only disabled and its memory is not released.  */
+void
+gpa_remove_filewatch (gpa_filewatch_id_t handle)
+{
+#ifdef HAVE_INOTIFY_INIT
+  gpa_filewatch_id_t *prev;
+
+  if (!handle)
+    return;
+
+  /* Note that the watch might already be gone if the file has been
+     deleted; thus we ignore errors.  */
+  inotify_rm_watch (queue_fd, handle->wd);
+  handle->callback = NULL;
+  if (walking_watch_list_p)
+    return;
+
+  for (prev = &watch_list; *prev; prev = &(*prev)->next)
+    if (*prev == handle)
+      {
+        *prev = handle->next;
+        xfree (handle);
+        break;
+      }
+#endif /*HAVE_INOTIFY_INIT*/
+}
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 
 #include <glib/gstdio.h>
@@ -63,6 +64,23 @@ gboolean debug_edit_fsm;
 /* True if verbose messages are requested.  */
 gboolean verbose;
 
+/* The backlog of the UI server's socket and the maximum number of
+   connections it serves at a time.  Zero selects the default.  */
+int server_backlog;
+int server_max_connections;
+
+/* The maximum number of files processed at the same time.  Zero
+   selects a default based on the number of processors.  */
+int file_workers;
+
+/* True in the batch mode, which shows no windows.  Messages are
+   written to stderr instead.  */
+gboolean batch_mode;
+
+/* True if existing files may be overwritten without asking.  Only
+   used in the batch mode.  */
+gboolean batch_overwrite;
+
 /* Local variables.  */
 typedef struct
 {
@@ -76,6 +94,7 @@ typedef struct
   gboolean disable_x509;
   gboolean no_remote;
   gboolean enable_logging;
+  gboolean batch;
   gchar *options_filename;
 } gpa_args_t;
 
@@ -126,6 +145,11 @@ static GOptionEntry option_entries[] =
       N_("Read options from file"), "FILE" },
     { "no-remote", 0, 0, G_OPTION_ARG_NONE, &args.no_remote,
       N_("Do not connect to a running instance"), NULL },
+    { "batch", 0, 0, G_OPTION_ARG_NONE, &args.batch,
+      N_("Process files without a display; must be the first option"
+         " (see --batch --help)"), NULL },
+    { "workers", 0, 0, G_OPTION_ARG_INT, &file_workers,
+      N_("Process up to N files at the same time"), "N" },
     { "stop-server", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE,
       &args.stop_running_server, NULL, NULL },
     /* Note:  the cms option will eventually be removed.  */
@@ -139,6 +163,10 @@ static GOptionEntry option_entries[] =
       &debug_edit_fsm, NULL, NULL },
     { "enable-logging", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE,
       &args.enable_logging, NULL, NULL },
+    { "server-backlog", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT,
+      &server_backlog, NULL, NULL },
+    { "max-connections", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT,
+      &server_max_connections, NULL, NULL },
     { "gpg-binary", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME,
       &dummy_arg, NULL, NULL },
     { "gpgsm-binary", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME,
@@ -492,6 +520,18 @@ main (int argc, char *argv[])
   /* Set locale before option parsing for UTF-8 conversion.  */
   i18n_init ();
 
+  /* The batch mode has its own options and does not use GTK.  */
+  if (argc > 1 && !strcmp (argv[1], "--batch"))
+    {
+      gpgme_check_version (NULL);
+#ifndef G_OS_WIN32
+      signal (SIGPIPE, SIG_IGN);
+#endif
+      cms_hack = TRUE;
+      batch_mode = TRUE;
+      return gpa_batch_main (argc - 1, argv + 1);
+    }
+
   /* Parse command line options.  */
   context = g_option_context_new (N_("[FILE...]"));
 #if GLIB_CHECK_VERSION (2, 12, 0)
@@ -508,6 +548,12 @@ main (int argc, char *argv[])
       g_print ("option parsing failed: %s\n", err->message);
       exit (1);
     }
+  if (args.batch)
+    {
+      g_print ("option parsing failed: %s\n",
+               "--batch must be the first option");
+      exit (1);
+    }
 
   if (!args.enable_logging)
     {
@@ -63,6 +63,11 @@ extern gboolean cms_hack;
 extern gboolean disable_ticker;
 extern gboolean debug_edit_fsm;
 extern gboolean verbose;
+extern int server_backlog;
+extern int server_max_connections;
+extern int file_workers;
+extern gboolean batch_mode;
+extern gboolean batch_overwrite;
 
 /* Show the keyring editor dialog.  */
 void gpa_open_key_manager (GSimpleAction *simple, GVariant *parameter, gpointer user_data);
@@ -111,6 +116,9 @@ void gpa_stop_server (void);
 int  gpa_check_server (void);
 gpg_error_t gpa_send_to_server (const char *cmd);
 
+/* Run the batch mode.  */
+int gpa_batch_main (int argc, char **argv);
+
 
 typedef struct gpa_filewatch_id_s *gpa_filewatch_id_t;
 typedef void (*gpa_filewatch_cb_t)
@@ -120,6 +128,7 @@ gpa_filewatch_id_t gpa_add_filewatch (const char *filename,
                                       const char *maskstring,
                                       gpa_filewatch_cb_t cb,
                                       void *cb_data);
+void gpa_remove_filewatch (gpa_filewatch_id_t handle);
 
 GtkApplication *get_gpa_application();
 
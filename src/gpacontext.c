@@ -295,6 +295,142 @@ gpa_context_get_diag (GpaContext *context)
 }
 
 
+
+/*
+ * Running operations in worker threads
+ */
+
+/* The maximum number of worker threads.  */
+#define MAX_WORKER_THREADS 8
+
+/* A job for a worker thread.  */
+struct thread_job_s
+{
+  GpaContext *context;
+  GpaContextThreadFunc func;
+  void *opaque;
+  gpg_error_t err;
+};
+
+/* A progress report from a worker thread.  */
+struct thread_progress_s
+{
+  GpaContext *context;
+  int current;
+  int total;
+};
+
+static GThreadPool *thread_pool;
+
+
+/* Emit the progress signal in the main loop.  */
+static gboolean
+thread_progress_idle_cb (gpointer data)
+{
+  struct thread_progress_s *progress = data;
+
+  g_signal_emit (progress->context, signals[PROGRESS], 0,
+                 progress->current, progress->total);
+  g_object_unref (progress->context);
+  g_free (progress);
+  return FALSE;
+}
+
+
+/* The progress callback used in worker threads.  */
+static void
+thread_progress_cb (void *opaque, const char *what,
+                    int type, int current, int total)
+{
+  struct thread_progress_s *progress;
+
+  progress = g_malloc (sizeof *progress);
+  progress->context = g_object_ref (opaque);
+  progress->current = current;
+  progress->total = total;
+  g_idle_add (thread_progress_idle_cb, progress);
+}
+
+
+/* Finish a job in the main loop.  */
+static gboolean
+thread_done_idle_cb (gpointer data)
+{
+  struct thread_job_s *job = data;
+  GpaContext *context = job->context;
+
+  /* Restore the callbacks of gpa_context_init.  */
+  if (!cms_hack)
+    gpgme_set_passphrase_cb (context->ctx, gpa_context_passphrase_cb, context);
+  gpgme_set_progress_cb (context->ctx, gpa_context_progress_cb, context);
+  g_signal_emit (context, signals[DONE], 0, job->err);
+  g_object_unref (context);
+  g_free (job);
+  return FALSE;
+}
+
+
+static void
+thread_func (gpointer data, gpointer user_data)
+{
+  struct thread_job_s *job = data;
+
+  job->err = job->func (job->context->ctx, job->opaque);
+  g_idle_add (thread_done_idle_cb, job);
+}
+
+
+/* Run FUNC with OPAQUE in a worker thread.  FUNC gets the gpgme
+   context of CONTEXT which must not be used otherwise until the
+   "done" signal is emitted from the main loop with the error
+   returned by FUNC.  Progress is reported by the "progress" signal.
+   There is no passphrase callback; gpg-agent asks for passphrases.  */
+void
+gpa_context_run_in_thread (GpaContext *context,
+                           GpaContextThreadFunc func, void *opaque)
+{
+  struct thread_job_s *job;
+
+  g_return_if_fail (GPA_IS_CONTEXT (context));
+  g_return_if_fail (func);
+
+  if (!thread_pool)
+    {
+      GError *error = NULL;
+
+      thread_pool = g_thread_pool_new (thread_func, NULL,
+                                       CLAMP (g_get_num_processors (),
+                                              2, MAX_WORKER_THREADS),
+                                       FALSE, &error);
+      if (!thread_pool)
+        {
+          g_debug ("error creating the thread pool: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
+  job = g_malloc0 (sizeof *job);
+  job->context = g_object_ref (context);
+  job->func = func;
+  job->opaque = opaque;
+
+  /* A synchronous operation uses the private event loop of gpgme and
+     not our I/O callbacks; thus gpgme sends no START event and we
+     emit it here, from the main thread, so that listeners see the
+     same sequence of signals as for an asynchronous operation.  The
+     callbacks of gpa_context_init must not be called from another
+     thread.  */
+  g_signal_emit (context, signals[START], 0);
+  gpgme_set_passphrase_cb (context->ctx, NULL, NULL);
+  gpgme_set_progress_cb (context->ctx, thread_progress_cb, context);
+
+  if (thread_pool)
+    g_thread_pool_push (thread_pool, job, NULL);
+  else
+    thread_func (job, NULL);
+}
+
+
 
 /*
  * The GPGME I/O callbacks
@@ -81,4 +81,16 @@ gboolean gpa_context_busy (GpaContext *context);
 /* Return a string with the diagnostics from gpgme.  */
 char *gpa_context_get_diag (GpaContext *context);
 
+/* A function run by gpa_context_run_in_thread.  It shall run a
+   synchronous gpgme operation on CTX and return its error code.  */
+typedef gpg_error_t (*GpaContextThreadFunc) (gpgme_ctx_t ctx, void *opaque);
+
+/* Run FUNC with OPAQUE in a worker thread.  FUNC gets the gpgme
+   context of CONTEXT which must not be used otherwise until the
+   "done" signal is emitted from the main loop with the error
+   returned by FUNC.  Progress is reported by the "progress" signal.
+   There is no passphrase callback; gpg-agent asks for passphrases.  */
+void gpa_context_run_in_thread (GpaContext *context,
+                                GpaContextThreadFunc func, void *opaque);
+
 #endif /*GPA_CONTEXT_H*/
@@ -42,6 +42,10 @@ gpa_export_clipboard_operation_complete_export (GpaExportOperation *operation);
 static void
 gpa_export_clipboard_operation_finalize (GObject *object)
 {
+  GpaExportClipboardOperation *op = GPA_EXPORT_CLIPBOARD_OPERATION (object);
+
+  g_free (get_membuf (&op->buffer, NULL));
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -116,9 +120,12 @@ gpa_export_clipboard_operation_get_destination (GpaExportOperation *operation,
 						gpgme_data_t *dest,
 						gboolean *armor)
 {
+  GpaExportClipboardOperation *op = GPA_EXPORT_CLIPBOARD_OPERATION (operation);
   gpg_error_t err;
   *armor = TRUE;
-  err = gpgme_data_new (dest);
+  /* Let gpgme write directly into our buffer.  */
+  init_membuf (&op->buffer, 4096);
+  err = membuf_data_new (dest, &op->buffer);
   if (err)
     {
       gpa_gpgme_warning (err);
@@ -137,16 +144,25 @@ gpa_export_clipboard_operation_complete_export (GpaExportOperation *operation)
   gboolean is_secret;
   GList *keys;
   unsigned int nkeys;
+  char *text;
+  size_t len;
 
   g_object_get (op, "secret", &is_secret, "keys", &keys, NULL);
   nkeys = g_list_length (keys);
-  if (!dump_data_to_clipboard (operation->dest, gtk_clipboard_get
-                               (GDK_SELECTION_CLIPBOARD)))
-    gpa_show_info
-      (GPA_OPERATION (op)->window,
-       is_secret? _("The private key has been copied to the clipboard.") :
-       nkeys==1 ? _("The key has been copied to the clipboard.") :
-       /* */      _("The keys have been copied to the clipboard."));
+  text = get_membuf (&op->buffer, &len);
+  if (!text)
+    {
+      gpa_window_error (strerror (errno), NULL);
+      return;
+    }
+  gtk_clipboard_set_text (gtk_clipboard_get (GDK_SELECTION_CLIPBOARD),
+                          text, (int) len);
+  g_free (text);
+  gpa_show_info
+    (GPA_OPERATION (op)->window,
+     is_secret? _("The private key has been copied to the clipboard.") :
+     nkeys==1 ? _("The key has been copied to the clipboard.") :
+     /* */      _("The keys have been copied to the clipboard."));
 }
 
 /* API */
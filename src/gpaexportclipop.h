@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "gpaexportop.h"
+#include "membuf.h"
 
 /* GObject stuff */
 #define GPA_EXPORT_CLIPBOARD_OPERATION_TYPE	  (gpa_export_clipboard_operation_get_type ())
@@ -40,6 +41,8 @@ typedef struct _GpaExportClipboardOperationClass GpaExportClipboardOperationClas
 struct _GpaExportClipboardOperation {
   GpaExportOperation parent;
 
+  /* The buffer the keys are exported into.  */
+  membuf_t buffer;
 };
 
 struct _GpaExportClipboardOperationClass {
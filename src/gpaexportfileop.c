@@ -44,11 +44,7 @@ gpa_export_file_operation_finalize (GObject *object)
 {
   GpaExportFileOperation *op = GPA_EXPORT_FILE_OPERATION (object);
 
-  /* Cleanup */
-  if (op->fd != -1)
-    {
-      close (op->fd);
-    }
+  /* Cleanup.  The file is closed by the data object.  */
   if (op->file)
     {
       g_free (op->file);
@@ -177,8 +173,18 @@ static void
 gpa_export_file_operation_complete_export (GpaExportOperation *operation)
 {
   GpaExportFileOperation *op = GPA_EXPORT_FILE_OPERATION (operation);
-  gchar *message = g_strdup_printf (_("The keys have been exported to %s."),
-				    op->file);
+  gpg_error_t err;
+  gchar *message;
+
+  err = gpa_output_commit (operation->dest);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      return;
+    }
+
+  message = g_strdup_printf (_("The keys have been exported to %s."),
+			     op->file);
   gpa_window_message (message, GPA_OPERATION (op)->window);
   g_free (message);
 }
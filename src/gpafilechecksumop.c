@@ -0,0 +1,969 @@
+/* gpafilechecksumop.c - Create and verify checksum files.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The checksum files use the format of sha256sum and sha512sum.  The
+   files are hashed by a pool of worker threads, one file per job; a
+   job maps the file into memory if possible and hands the digest back
+   to the main loop.  When all jobs are done the checksum files are
+   written or the digests are compared.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gpa.h"
+#include "gtktools.h"
+#include "gpafilechecksumop.h"
+
+
+/* The maximum number of hashing threads.  */
+#define MAX_WORKER_THREADS 8
+
+/* The size of the buffer used for files which can't be mapped.  */
+#define READ_BUFFER_SIZE (1024 * 1024)
+
+/* Properties */
+enum
+{
+  PROP_0,
+  PROP_VERIFY
+};
+
+/* The names of checksum files in the order they are looked for.  New
+   checksum files get the first name.  */
+static const char *manifest_names[] =
+  {
+    "sha256sum.txt",
+    "sha512sum.txt",
+    "SHA256SUMS",
+    "SHA512SUMS",
+    NULL
+  };
+
+/* A checksum file.  */
+struct manifest_s
+{
+  GpaFileChecksumOperation *op;
+  char *filename;
+  /* The directory the names in the file are relative to.  */
+  char *dirname;
+  /* The algorithm for new entries.  */
+  GChecksumType algo;
+  /* The struct entry_s of the file and the same indexed by name.  */
+  GPtrArray *entries;
+  GHashTable *names;
+  /* True if all files are covered, otherwise ONLY has the names of
+     the files given by the user.  */
+  gboolean all;
+  GHashTable *only;
+};
+
+/* A line of a checksum file.  */
+struct entry_s
+{
+  struct manifest_s *manifest;
+  char *name;
+  GChecksumType algo;
+  /* The digest from the checksum file or NULL.  */
+  char *expected;
+  /* The computed digest or NULL.  */
+  char *digest;
+  /* The errno value if the file could not be read.  */
+  int error;
+};
+
+static GThreadPool *hash_pool;
+
+
+/* Internal functions */
+static gboolean gpa_file_checksum_operation_idle_cb (gpointer data);
+static void free_manifest (struct manifest_s *manifest);
+
+/* GObject */
+
+static GObjectClass *parent_class = NULL;
+
+
+static void
+gpa_file_checksum_operation_get_property (GObject *object, guint prop_id,
+                                          GValue *value, GParamSpec *pspec)
+{
+  GpaFileChecksumOperation *op = GPA_FILE_CHECKSUM_OPERATION (object);
+
+  switch (prop_id)
+    {
+    case PROP_VERIFY:
+      g_value_set_boolean (value, op->verify);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+
+static void
+gpa_file_checksum_operation_set_property (GObject *object, guint prop_id,
+                                          const GValue *value,
+                                          GParamSpec *pspec)
+{
+  GpaFileChecksumOperation *op = GPA_FILE_CHECKSUM_OPERATION (object);
+
+  switch (prop_id)
+    {
+    case PROP_VERIFY:
+      op->verify = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+
+static void
+gpa_file_checksum_operation_finalize (GObject *object)
+{
+  GpaFileChecksumOperation *op = GPA_FILE_CHECKSUM_OPERATION (object);
+
+  g_ptr_array_free (op->manifests, TRUE);
+  g_string_free (op->report, TRUE);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static void
+gpa_file_checksum_operation_init (GpaFileChecksumOperation *op)
+{
+  op->verify = FALSE;
+  op->manifests = g_ptr_array_new_with_free_func
+    ((GDestroyNotify) free_manifest);
+  op->total = 0;
+  op->pending = 0;
+  op->failed = 0;
+  op->report = g_string_new (NULL);
+}
+
+
+static GObject*
+gpa_file_checksum_operation_constructor
+	(GType type,
+	 guint n_construct_properties,
+	 GObjectConstructParam *construct_properties)
+{
+  GObject *object;
+  GpaFileChecksumOperation *op;
+
+  /* Invoke parent's constructor */
+  object = parent_class->constructor (type,
+				      n_construct_properties,
+				      construct_properties);
+  op = GPA_FILE_CHECKSUM_OPERATION (object);
+  /* Initialize */
+  /* Start with the files after going back into the main loop */
+  g_idle_add (gpa_file_checksum_operation_idle_cb, op);
+  /* Give a title to the progress dialog */
+  gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
+			op->verify ? _("Verifying Checksums...")
+                        : _("Creating Checksums..."));
+
+  return object;
+}
+
+
+static void
+gpa_file_checksum_operation_class_init (GpaFileChecksumOperationClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  object_class->constructor = gpa_file_checksum_operation_constructor;
+  object_class->finalize = gpa_file_checksum_operation_finalize;
+  object_class->set_property = gpa_file_checksum_operation_set_property;
+  object_class->get_property = gpa_file_checksum_operation_get_property;
+
+  /* Properties */
+  g_object_class_install_property (object_class,
+				   PROP_VERIFY,
+				   g_param_spec_boolean
+				   ("verify", "Verify",
+				    "Verify the checksums",
+				    FALSE,
+				    G_PARAM_WRITABLE|G_PARAM_CONSTRUCT_ONLY));
+}
+
+
+GType
+gpa_file_checksum_operation_get_type (void)
+{
+  static GType file_checksum_operation_type = 0;
+
+  if (!file_checksum_operation_type)
+    {
+      static const GTypeInfo file_checksum_operation_info =
+      {
+        sizeof (GpaFileChecksumOperationClass),
+        (GBaseInitFunc) NULL,
+        (GBaseFinalizeFunc) NULL,
+        (GClassInitFunc) gpa_file_checksum_operation_class_init,
+        NULL,           /* class_finalize */
+        NULL,           /* class_data */
+        sizeof (GpaFileChecksumOperation),
+        0,              /* n_preallocs */
+        (GInstanceInitFunc) gpa_file_checksum_operation_init
+      };
+
+      file_checksum_operation_type = g_type_register_static
+	(GPA_FILE_OPERATION_TYPE, "GpaFileChecksumOperation",
+	 &file_checksum_operation_info, 0);
+    }
+
+  return file_checksum_operation_type;
+}
+
+
+/* API */
+
+
+GpaFileChecksumOperation*
+gpa_file_checksum_operation_new (GtkWidget *window, GList *files,
+                                 gboolean verify)
+{
+  GpaFileChecksumOperation *op;
+
+  op = g_object_new (GPA_FILE_CHECKSUM_OPERATION_TYPE,
+		     "window", window,
+		     "input_files", files,
+		     "verify", verify,
+		     NULL);
+
+  return op;
+}
+
+
+/* Internal */
+
+
+static void
+free_entry (struct entry_s *entry)
+{
+  g_free (entry->name);
+  g_free (entry->expected);
+  g_free (entry->digest);
+  g_free (entry);
+}
+
+
+static void
+free_manifest (struct manifest_s *manifest)
+{
+  g_ptr_array_free (manifest->entries, TRUE);
+  g_hash_table_destroy (manifest->names);
+  g_hash_table_destroy (manifest->only);
+  g_free (manifest->filename);
+  g_free (manifest->dirname);
+  g_free (manifest);
+}
+
+
+/* Return true if NAME is the name of a checksum file.  */
+static gboolean
+is_manifest_name (const char *name)
+{
+  int i;
+
+  for (i = 0; manifest_names[i]; i++)
+    if (!strcmp (name, manifest_names[i]))
+      return TRUE;
+  return (g_str_has_suffix (name, ".sha256")
+          || g_str_has_suffix (name, ".sha512"));
+}
+
+
+/* Return the algorithm used by the checksum file FILENAME.  */
+static GChecksumType
+manifest_algo (const char *filename)
+{
+  char *name = g_path_get_basename (filename);
+  GChecksumType algo;
+
+  algo = strstr (name, "512") ? G_CHECKSUM_SHA512 : G_CHECKSUM_SHA256;
+  g_free (name);
+  return algo;
+}
+
+
+/* Return the name of the checksum file in DIRNAME or NULL if there is
+   none.  */
+static char *
+find_manifest (const char *dirname)
+{
+  int i;
+
+  for (i = 0; manifest_names[i]; i++)
+    {
+      char *filename = g_build_filename (dirname, manifest_names[i], NULL);
+
+      if (g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+        return filename;
+      g_free (filename);
+    }
+  return NULL;
+}
+
+
+/* Return the manifest for FILENAME from TABLE and create it if
+   needed.  Takes ownership of FILENAME.  */
+static struct manifest_s *
+get_manifest (GpaFileChecksumOperation *op, GHashTable *table,
+              char *filename)
+{
+  struct manifest_s *manifest;
+
+  manifest = g_hash_table_lookup (table, filename);
+  if (manifest)
+    {
+      g_free (filename);
+      return manifest;
+    }
+
+  manifest = g_malloc0 (sizeof *manifest);
+  manifest->op = op;
+  manifest->filename = filename;
+  manifest->dirname = g_path_get_dirname (filename);
+  manifest->algo = manifest_algo (filename);
+  manifest->entries = g_ptr_array_new_with_free_func
+    ((GDestroyNotify) free_entry);
+  manifest->names = g_hash_table_new (g_str_hash, g_str_equal);
+  manifest->only = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+  g_hash_table_insert (table, manifest->filename, manifest);
+  g_ptr_array_add (op->manifests, manifest);
+  return manifest;
+}
+
+
+/* Add an entry for NAME to MANIFEST unless there is already one.
+   EXPECTED is the hex digest from the checksum file or NULL.  */
+static struct entry_s *
+add_entry (struct manifest_s *manifest, const char *name,
+           const char *expected)
+{
+  struct entry_s *entry;
+
+  if (g_hash_table_contains (manifest->names, name))
+    return NULL;
+
+  entry = g_malloc0 (sizeof *entry);
+  entry->manifest = manifest;
+  entry->name = g_strdup (name);
+  if (expected)
+    {
+      entry->expected = g_ascii_strdown (expected, -1);
+      entry->algo = (strlen (expected) == 128
+                     ? G_CHECKSUM_SHA512 : G_CHECKSUM_SHA256);
+    }
+  else
+    entry->algo = manifest->algo;
+  g_ptr_array_add (manifest->entries, entry);
+  g_hash_table_add (manifest->names, entry->name);
+  return entry;
+}
+
+
+/* Return the file name of ENTRY.  */
+static char *
+entry_filename (struct entry_s *entry)
+{
+  if (g_path_is_absolute (entry->name))
+    return g_strdup (entry->name);
+  return g_build_filename (entry->manifest->dirname, entry->name, NULL);
+}
+
+
+/* Add all regular files below the directory DIRNAME to MANIFEST.
+   PREFIX is the name of DIRNAME relative to the manifest or NULL for
+   the directory of the manifest.  */
+static void
+add_directory (struct manifest_s *manifest, const char *dirname,
+               const char *prefix)
+{
+  GError *error = NULL;
+  GDir *dir;
+  const char *name;
+
+  dir = g_dir_open (dirname, 0, &error);
+  if (!dir)
+    {
+      g_string_append_printf (manifest->op->report, "%s\n", error->message);
+      g_error_free (error);
+      manifest->op->failed++;
+      return;
+    }
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      char *filename = g_build_filename (dirname, name, NULL);
+      char *relname = (prefix ? g_strconcat (prefix, "/", name, NULL)
+                       : g_strdup (name));
+
+      if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+        {
+          /* Links to directories are not followed to avoid loops.  */
+          if (!g_file_test (filename, G_FILE_TEST_IS_SYMLINK))
+            add_directory (manifest, filename, relname);
+        }
+      else if (g_file_test (filename, G_FILE_TEST_IS_REGULAR)
+               && !(!prefix && is_manifest_name (name)))
+        add_entry (manifest, relname, NULL);
+
+      g_free (relname);
+      g_free (filename);
+    }
+  g_dir_close (dir);
+}
+
+
+/* Undo the escaping of file names done by sha256sum in place.  */
+static void
+unescape_name (char *name)
+{
+  char *p, *d;
+
+  for (p = d = name; *p; p++)
+    {
+      if (*p == '\\' && p[1])
+        {
+          p++;
+          if (*p == 'n')
+            *d++ = '\n';
+          else if (*p == 'r')
+            *d++ = '\r';
+          else
+            *d++ = *p;
+        }
+      else
+        *d++ = *p;
+    }
+  *d = 0;
+}
+
+
+/* Read the checksum file of MANIFEST.  When verifying, entries are
+   added for the requested files; when creating, the entries for the
+   other files are kept.  Returns false if the file could not be
+   read.  */
+static gboolean
+load_manifest (struct manifest_s *manifest)
+{
+  GpaFileChecksumOperation *op = manifest->op;
+  GError *error = NULL;
+  char *contents;
+  char **lines;
+  guint malformed = 0;
+  int i;
+
+  if (!g_file_get_contents (manifest->filename, &contents, NULL, &error))
+    {
+      g_string_append_printf (op->report, "%s\n", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  for (i = 0; lines[i]; i++)
+    {
+      char *line = lines[i];
+      gboolean escaped = FALSE;
+      size_t len;
+      char *name;
+
+      len = strlen (line);
+      if (len && line[len - 1] == '\r')
+        line[--len] = 0;
+      if (!*line || *line == '#')
+        continue;
+      if (*line == '\\')
+        {
+          escaped = TRUE;
+          line++;
+        }
+
+      for (len = 0; g_ascii_isxdigit (line[len]); len++)
+        ;
+      if ((len != 64 && len != 128) || line[len] != ' '
+          || (line[len + 1] != ' ' && line[len + 1] != '*')
+          || !line[len + 2])
+        {
+          malformed++;
+          continue;
+        }
+      line[len] = 0;
+      name = line + len + 2;
+      if (escaped)
+        unescape_name (name);
+      if (name[0] == '.' && name[1] == '/' && name[2])
+        name += 2;
+
+      if (op->verify)
+        {
+          if (manifest->all || g_hash_table_contains (manifest->only, name))
+            add_entry (manifest, name, line);
+        }
+      else if (!g_hash_table_contains (manifest->names, name)
+               && (len == 128) == (manifest->algo == G_CHECKSUM_SHA512))
+        {
+          struct entry_s *entry = add_entry (manifest, name, line);
+
+          entry->digest = g_strdup (entry->expected);
+        }
+    }
+  g_strfreev (lines);
+
+  if (malformed)
+    g_string_append_printf (op->report,
+                            _("%s: %u lines are improperly formatted\n"),
+                            manifest->filename, malformed);
+  return TRUE;
+}
+
+
+/* Return the hex digest of the file FILENAME using ALGO.  On error
+   NULL is returned and an errno value stored at R_ERROR.  This runs
+   in a worker thread.  */
+static char *
+hash_file (const char *filename, GChecksumType algo, int *r_error)
+{
+  GChecksum *checksum;
+  GMappedFile *mapped;
+  char *digest;
+
+  checksum = g_checksum_new (algo);
+
+  mapped = g_mapped_file_new (filename, FALSE, NULL);
+  if (mapped)
+    {
+      g_checksum_update (checksum,
+                         (const guchar *) g_mapped_file_get_contents (mapped),
+                         g_mapped_file_get_length (mapped));
+      g_mapped_file_unref (mapped);
+    }
+  else
+    {
+      /* Not all files can be mapped; read them instead.  */
+      FILE *fp;
+      guchar *buffer;
+      size_t nread;
+      int error = 0;
+
+      fp = g_fopen (filename, "rb");
+      if (!fp)
+        {
+          *r_error = errno;
+          g_checksum_free (checksum);
+          return NULL;
+        }
+      buffer = g_malloc (READ_BUFFER_SIZE);
+      while ((nread = fread (buffer, 1, READ_BUFFER_SIZE, fp)) > 0)
+        g_checksum_update (checksum, buffer, nread);
+      if (ferror (fp))
+        error = errno ? errno : EIO;
+      g_free (buffer);
+      fclose (fp);
+      if (error)
+        {
+          *r_error = error;
+          g_checksum_free (checksum);
+          return NULL;
+        }
+    }
+
+  digest = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+  return digest;
+}
+
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b)
+{
+  const struct entry_s *entry_a = *(struct entry_s * const *) a;
+  const struct entry_s *entry_b = *(struct entry_s * const *) b;
+
+  return strcmp (entry_a->name, entry_b->name);
+}
+
+
+/* Write the checksum file of MANIFEST.  Entries which could not be
+   hashed are left out.  */
+static gboolean
+write_manifest (struct manifest_s *manifest, GError **r_error)
+{
+  GString *text = g_string_new (NULL);
+  gboolean ok;
+  guint idx;
+
+  g_ptr_array_sort (manifest->entries, compare_entries);
+  for (idx = 0; idx < manifest->entries->len; idx++)
+    {
+      struct entry_s *entry = g_ptr_array_index (manifest->entries, idx);
+      const char *p;
+
+      if (!entry->digest)
+        continue;
+      if (!strpbrk (entry->name, "\\\n\r"))
+        {
+          g_string_append_printf (text, "%s  %s\n",
+                                  entry->digest, entry->name);
+          continue;
+        }
+
+      /* Escape the name like sha256sum does.  */
+      g_string_append_printf (text, "\\%s  ", entry->digest);
+      for (p = entry->name; *p; p++)
+        {
+          if (*p == '\\')
+            g_string_append (text, "\\\\");
+          else if (*p == '\n')
+            g_string_append (text, "\\n");
+          else if (*p == '\r')
+            g_string_append (text, "\\r");
+          else
+            g_string_append_c (text, *p);
+        }
+      g_string_append_c (text, '\n');
+    }
+
+  ok = g_file_set_contents (manifest->filename, text->str, text->len,
+                            r_error);
+  g_string_free (text, TRUE);
+  return ok;
+}
+
+
+/* Write or check the checksum files and report the result.  */
+static void
+gpa_file_checksum_operation_finish (GpaFileChecksumOperation *op)
+{
+  GtkWidget *window = GPA_OPERATION (op)->window;
+  gpg_error_t err = 0;
+  guint i, idx;
+
+  gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+
+  for (i = 0; i < op->manifests->len; i++)
+    {
+      struct manifest_s *manifest = g_ptr_array_index (op->manifests, i);
+      guint hashed = 0;
+
+      for (idx = 0; idx < manifest->entries->len; idx++)
+        {
+          struct entry_s *entry = g_ptr_array_index (manifest->entries, idx);
+          char *filename;
+
+          if (entry->digest
+              && (!op->verify || !strcmp (entry->digest, entry->expected)))
+            {
+              hashed++;
+              continue;
+            }
+
+          op->failed++;
+          filename = entry_filename (entry);
+          if (!entry->digest)
+            {
+              g_string_append_printf (op->report, "%s: %s\n", filename,
+                                      g_strerror (entry->error));
+              if (!err)
+                err = gpg_error (GPG_ERR_GENERAL);
+            }
+          else
+            {
+              g_string_append_printf (op->report,
+                                      _("%s: checksum mismatch\n"),
+                                      filename);
+              err = gpg_error (GPG_ERR_CHECKSUM);
+            }
+          g_free (filename);
+        }
+
+      if (!op->verify && hashed)
+        {
+          GError *error = NULL;
+
+          if (write_manifest (manifest, &error))
+            {
+              struct gpa_file_item_s file_item;
+
+              memset (&file_item, 0, sizeof file_item);
+              file_item.filename_out = manifest->filename;
+              g_signal_emit_by_name (GPA_OPERATION (op), "created_file",
+                                     &file_item);
+            }
+          else
+            {
+              g_string_append_printf (op->report, "%s\n", error->message);
+              g_error_free (error);
+              if (!err)
+                err = gpg_error (GPG_ERR_GENERAL);
+            }
+        }
+    }
+
+  if (!err && op->failed)
+    err = gpg_error (GPG_ERR_GENERAL);
+
+  if (op->report->len)
+    gpa_show_warn (window, GPA_OPERATION (op)->context,
+                   op->verify
+                   ? _("Problems verifying the checksums:\n\n%s")
+                   : _("Problems creating the checksums:\n\n%s"),
+                   op->report->str);
+  else if (!op->total)
+    gpa_show_info (window, _("There are no files to process."));
+  else if (op->verify)
+    gpa_show_info (window, _("The checksums of all %u files are correct."),
+                   op->total);
+  else
+    gpa_show_info (window, _("The checksums of %u files have been written."),
+                   op->total);
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
+/* A file has been hashed.  */
+static gboolean
+hash_done_idle_cb (gpointer data)
+{
+  struct entry_s *entry = data;
+  GpaFileChecksumOperation *op = entry->manifest->op;
+  GpaProgressDialog *dialog;
+
+  dialog = GPA_PROGRESS_DIALOG (GPA_FILE_OPERATION (op)->progress_dialog);
+  gpa_progress_dialog_set_label (dialog, entry->name);
+  op->pending--;
+  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (dialog->pbar),
+                                 (gdouble) (op->total - op->pending)
+                                 / op->total);
+  if (!op->pending)
+    {
+      gpa_file_checksum_operation_finish (op);
+      g_object_unref (op);
+    }
+  return FALSE;
+}
+
+
+static void
+hash_job (gpointer data, gpointer user_data)
+{
+  struct entry_s *entry = data;
+  char *filename = entry_filename (entry);
+
+  entry->digest = hash_file (filename, entry->algo, &entry->error);
+  g_free (filename);
+  g_idle_add (hash_done_idle_cb, entry);
+}
+
+
+/* Set up the checksum files for the input files.  */
+static void
+collect_manifests (GpaFileChecksumOperation *op)
+{
+  GHashTable *table;
+  GList *cur;
+
+  table = g_hash_table_new (g_str_hash, g_str_equal);
+  for (cur = GPA_FILE_OPERATION (op)->input_files; cur;
+       cur = g_list_next (cur))
+    {
+      gpa_file_item_t file_item = cur->data;
+      const char *filename = file_item->filename_in;
+      struct manifest_s *manifest;
+      char *mfile, *dirname, *basename;
+
+      /* There are no checksums for direct input.  */
+      if (!filename)
+        continue;
+
+      if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+        {
+          mfile = find_manifest (filename);
+          if (!mfile && op->verify)
+            {
+              g_string_append_printf (op->report,
+                                      _("%s: no checksum file found\n"),
+                                      filename);
+              op->failed++;
+              continue;
+            }
+          if (!mfile)
+            mfile = g_build_filename (filename, manifest_names[0], NULL);
+          get_manifest (op, table, mfile)->all = TRUE;
+          continue;
+        }
+
+      basename = g_path_get_basename (filename);
+      if (is_manifest_name (basename))
+        {
+          /* A checksum file is verified as a whole and does not list
+             itself.  */
+          if (op->verify)
+            get_manifest (op, table, g_strdup (filename))->all = TRUE;
+          g_free (basename);
+          continue;
+        }
+
+      dirname = g_path_get_dirname (filename);
+      mfile = find_manifest (dirname);
+      if (!mfile && op->verify)
+        {
+          g_string_append_printf (op->report,
+                                  _("%s: no checksum file found\n"),
+                                  filename);
+          op->failed++;
+          op->total++;
+          g_free (basename);
+        }
+      else
+        {
+          if (!mfile)
+            mfile = g_build_filename (dirname, manifest_names[0], NULL);
+          manifest = get_manifest (op, table, mfile);
+          g_hash_table_add (manifest->only, basename);
+        }
+      g_free (dirname);
+    }
+  g_hash_table_destroy (table);
+}
+
+
+/* Fill the checksum files with entries.  */
+static void
+collect_entries (GpaFileChecksumOperation *op, struct manifest_s *manifest)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  if (op->verify)
+    {
+      if (!load_manifest (manifest))
+        {
+          op->failed++;
+          return;
+        }
+      if (manifest->all)
+        return;
+      g_hash_table_iter_init (&iter, manifest->only);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        if (!g_hash_table_contains (manifest->names, key))
+          {
+            g_string_append_printf (op->report, _("%s: not listed in %s\n"),
+                                    (char *) key, manifest->filename);
+            op->failed++;
+            op->total++;
+          }
+    }
+  else if (manifest->all)
+    add_directory (manifest, manifest->dirname, NULL);
+  else
+    {
+      g_hash_table_iter_init (&iter, manifest->only);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        add_entry (manifest, key, NULL);
+      /* Keep the checksums of the other files.  */
+      if (g_file_test (manifest->filename, G_FILE_TEST_EXISTS))
+        load_manifest (manifest);
+    }
+}
+
+
+static gboolean
+gpa_file_checksum_operation_idle_cb (gpointer data)
+{
+  GpaFileChecksumOperation *op = data;
+  GPtrArray *jobs;
+  guint i, idx;
+
+  collect_manifests (op);
+
+  jobs = g_ptr_array_new ();
+  for (i = 0; i < op->manifests->len; i++)
+    {
+      struct manifest_s *manifest = g_ptr_array_index (op->manifests, i);
+
+      collect_entries (op, manifest);
+      for (idx = 0; idx < manifest->entries->len; idx++)
+        {
+          struct entry_s *entry = g_ptr_array_index (manifest->entries, idx);
+
+          /* Kept entries already have a digest.  */
+          if (!entry->digest)
+            g_ptr_array_add (jobs, entry);
+        }
+    }
+  op->total += jobs->len;
+
+  if (!jobs->len)
+    {
+      g_ptr_array_free (jobs, TRUE);
+      gpa_file_checksum_operation_finish (op);
+      return FALSE;
+    }
+
+  if (!hash_pool)
+    {
+      GError *error = NULL;
+
+      hash_pool = g_thread_pool_new (hash_job, NULL,
+                                     CLAMP (g_get_num_processors (),
+                                            2, MAX_WORKER_THREADS),
+                                     FALSE, &error);
+      if (!hash_pool)
+        {
+          g_debug ("error creating the thread pool: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
+  /* The operation is kept alive until the last file is done.  */
+  g_object_ref (op);
+  op->pending = jobs->len;
+  gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
+  for (idx = 0; idx < jobs->len; idx++)
+    {
+      if (hash_pool)
+        g_thread_pool_push (hash_pool, g_ptr_array_index (jobs, idx), NULL);
+      else
+        hash_job (g_ptr_array_index (jobs, idx), NULL);
+    }
+  g_ptr_array_free (jobs, TRUE);
+
+  return FALSE;
+}
@@ -0,0 +1,93 @@
+/* gpafilechecksumop.h - The GpaFileChecksumOperation object.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GPA_FILE_CHECKSUM_OP_H
+#define GPA_FILE_CHECKSUM_OP_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include "gpafileop.h"
+
+
+/* GObject stuff */
+#define GPA_FILE_CHECKSUM_OPERATION_TYPE (gpa_file_checksum_operation_get_type ())
+
+#define GPA_FILE_CHECKSUM_OPERATION(obj)                                \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_FILE_CHECKSUM_OPERATION_TYPE, \
+                               GpaFileChecksumOperation))
+
+#define GPA_FILE_CHECKSUM_OPERATION_CLASS(klass)                        \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_FILE_CHECKSUM_OPERATION_TYPE,  \
+                            GpaFileChecksumOperationClass))
+
+#define GPA_IS_FILE_CHECKSUM_OPERATION(obj)                             \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_FILE_CHECKSUM_OPERATION_TYPE))
+
+#define GPA_IS_FILE_CHECKSUM_OPERATION_CLASS(klass)                     \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_FILE_CHECKSUM_OPERATION_TYPE))
+
+#define GPA_FILE_CHECKSUM_OPERATION_GET_CLASS(obj)                      \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_FILE_CHECKSUM_OPERATION_TYPE,  \
+                              GpaFileChecksumOperationClass))
+
+typedef struct _GpaFileChecksumOperation      GpaFileChecksumOperation;
+typedef struct _GpaFileChecksumOperationClass GpaFileChecksumOperationClass;
+
+struct _GpaFileChecksumOperation
+{
+  GpaFileOperation parent;
+
+  /* True to verify the checksums instead of creating them.  */
+  gboolean verify;
+
+  /* The checksum files to create or verify.  */
+  GPtrArray *manifests;
+
+  /* The number of files and the number of files still being hashed.  */
+  guint total;
+  guint pending;
+
+  /* The number of files which could not be hashed or did not match.  */
+  guint failed;
+
+  /* The problems to show when done.  */
+  GString *report;
+};
+
+
+struct _GpaFileChecksumOperationClass
+{
+  GpaFileOperationClass parent_class;
+};
+
+
+GType gpa_file_checksum_operation_get_type (void) G_GNUC_CONST;
+
+/* API */
+
+/* Create a new checksum operation for FILES.  If VERIFY is false,
+   checksum files in the format of sha256sum are written: one for the
+   plain files of each directory and one for all files below each
+   given directory.  If VERIFY is true, the files are checked against
+   the checksum files found for them.  */
+GpaFileChecksumOperation *
+gpa_file_checksum_operation_new (GtkWidget *window, GList *files,
+                                 gboolean verify);
+
+#endif /*GPA_FILE_CHECKSUM_OP_H*/
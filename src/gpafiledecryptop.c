@@ -47,6 +47,15 @@ static void gpa_file_decrypt_operation_done_cb (GpaContext *context,
 static void gpa_file_decrypt_operation_done_error_cb (GpaContext *context,
 						      gpg_error_t err,
 						      GpaFileDecryptOperation *op);
+static gpg_error_t gpa_file_decrypt_operation_start_file
+	(GpaFileOperation *fileop, gpa_file_worker_t worker);
+static gpg_error_t gpa_file_decrypt_operation_finish_file
+	(GpaFileOperation *fileop, gpa_file_worker_t worker, gpg_error_t err);
+static void gpa_file_decrypt_operation_add_result (GpaFileOperation *fileop,
+						   gpa_file_item_t file_item,
+						   gpointer result);
+static void gpa_file_decrypt_operation_files_done (GpaFileOperation *fileop,
+						   gpg_error_t err);
 
 /* GObject */
 
@@ -101,6 +110,8 @@ gpa_file_decrypt_operation_finalize (GObject *object)
 {
   GpaFileDecryptOperation *op = GPA_FILE_DECRYPT_OPERATION (object);
 
+  g_free (get_membuf (&op->plain_buf, NULL));
+
   if (op->dialog)
     gtk_widget_destroy (op->dialog);
 
@@ -150,6 +161,9 @@ gpa_file_decrypt_operation_constructor
 		    G_CALLBACK (gpa_file_decrypt_operation_done_error_cb), op);
   g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
 		    G_CALLBACK (gpa_file_decrypt_operation_done_cb), op);
+  if (batch_mode)
+    return object;
+
   /* Give a title to the progress dialog */
   gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
 			_("Decrypting..."));
@@ -170,6 +184,7 @@ static void
 gpa_file_decrypt_operation_class_init (GpaFileDecryptOperationClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GpaFileOperationClass *file_op_class = GPA_FILE_OPERATION_CLASS (klass);
 
   parent_class = g_type_class_peek_parent (klass);
 
@@ -178,6 +193,11 @@ gpa_file_decrypt_operation_class_init (GpaFileDecryptOperationClass *klass)
   object_class->set_property = gpa_file_decrypt_operation_set_property;
   object_class->get_property = gpa_file_decrypt_operation_get_property;
 
+  file_op_class->start_file = gpa_file_decrypt_operation_start_file;
+  file_op_class->finish_file = gpa_file_decrypt_operation_finish_file;
+  file_op_class->add_result = gpa_file_decrypt_operation_add_result;
+  file_op_class->files_done = gpa_file_decrypt_operation_files_done;
+
   /* Properties */
   g_object_class_install_property (object_class,
 				   PROP_VERIFY,
@@ -290,7 +310,8 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
 	  return err;
 	}
 
-      err = gpgme_data_new (&op->plain);
+      init_membuf (&op->plain_buf, file_item->direct_in_len + 1024);
+      err = membuf_data_new (&op->plain, &op->plain_buf);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -331,6 +352,7 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
 
       xfree (file_item->filename_out);
       file_item->filename_out = filename_used;
+      gpa_output_reserve (op->plain, op->cipher_fd);
 
       gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
                           is_cms_file (cipher_filename) ?
@@ -346,7 +368,6 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
 
       gpgme_data_release (op->plain);
       op->plain = NULL;
-      close (op->plain_fd);
       op->plain_fd = -1;
       gpgme_data_release (op->cipher);
       op->cipher = NULL;
@@ -410,44 +431,39 @@ gpa_file_decrypt_operation_done_cb (GpaContext *context,
   if (file_item->direct_in)
     {
       size_t len;
-      char *plain_gpgme = gpgme_data_release_and_get_mem (op->plain, &len);
+
+      /* gpgme wrote the output directly into the buffer; take it
+	 over as a string.  */
+      gpgme_data_release (op->plain);
       op->plain = NULL;
-      /* Do the memory allocation dance.  */
+      file_item->direct_out = get_membuf_string (&op->plain_buf, &len);
+      file_item->direct_out_len = file_item->direct_out ? len : 0;
+    }
 
-      if (plain_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, plain_gpgme, len);
-	  gpgme_free (plain_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
+  if (! err && ! file_item->direct_in)
+    {
+      /* Give the output file its name.  */
+      err = gpa_output_commit (op->plain);
+      if (err)
+        gpa_gpgme_warning (err);
     }
 
   /* Do clean up on the operation */
   gpgme_data_release (op->plain);
   op->plain = NULL;
-  close (op->plain_fd);
   op->plain_fd = -1;
   gpgme_data_release (op->cipher);
   op->cipher = NULL;
   close (op->cipher_fd);
   op->cipher_fd = -1;
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+  gpa_file_operation_file_done (GPA_FILE_OPERATION (op), file_item, err);
   if (err)
     {
       if (! file_item->direct_in)
 	{
-	  /* If an error happened, (or the user canceled) delete the
-	     created file and abort further decryptions.  */
-	  g_unlink (file_item->filename_out);
+	  /* If an error happened, (or the user canceled) the created
+	     file has been removed.  Abort further decryptions.  */
 	  g_free (file_item->filename_out);
 	  file_item->filename_out = NULL;
 	}
@@ -486,12 +502,144 @@ gpa_file_decrypt_operation_done_cb (GpaContext *context,
 }
 
 
+/* Start decrypting the file of WORKER.  This is used instead of
+   gpa_file_decrypt_operation_start if several files are decrypted at
+   the same time.  */
+static gpg_error_t
+gpa_file_decrypt_operation_start_file (GpaFileOperation *fileop,
+                                       gpa_file_worker_t worker)
+{
+  GpaFileDecryptOperation *op = GPA_FILE_DECRYPT_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+  gpgme_ctx_t ctx = worker->context->ctx;
+  char *filename_used;
+  gpg_error_t err;
+
+  file_item->filename_out = destination_filename (file_item->filename_in);
+
+  worker->in_fd = gpa_open_input (file_item->filename_in, &worker->in,
+                                  GPA_OPERATION (op)->window);
+  if (worker->in_fd == -1)
+    return gpg_error (GPG_ERR_GENERAL);
+
+  worker->out_fd = gpa_open_output (file_item->filename_out, &worker->out,
+                                    GPA_OPERATION (op)->window,
+                                    &filename_used);
+  if (worker->out_fd == -1)
+    {
+      xfree (filename_used);
+      return gpg_error (GPG_ERR_GENERAL);
+    }
+  xfree (file_item->filename_out);
+  file_item->filename_out = filename_used;
+  gpa_output_reserve (worker->out, worker->in_fd);
+
+  gpgme_set_protocol (ctx, is_cms_file (file_item->filename_in)
+                      ? GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+  err = gpgme_op_decrypt_verify_start (ctx, worker->in, worker->out);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      g_free (file_item->filename_out);
+      file_item->filename_out = NULL;
+    }
+  return err;
+}
+
+
+/* Decrypting the file of WORKER has finished.  If there are
+   signatures to show, the verification result is kept as the result
+   of the file.  */
+static gpg_error_t
+gpa_file_decrypt_operation_finish_file (GpaFileOperation *fileop,
+                                        gpa_file_worker_t worker,
+                                        gpg_error_t err)
+{
+  GpaFileDecryptOperation *op = GPA_FILE_DECRYPT_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+
+  /* The error callback reports the current file.  */
+  fileop->current = worker->item;
+  gpa_file_decrypt_operation_done_error_cb (worker->context, err, op);
+  if (err)
+    {
+      g_free (file_item->filename_out);
+      file_item->filename_out = NULL;
+      return err;
+    }
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "created_file", file_item);
+  if (op->verify)
+    {
+      gpgme_verify_result_t result;
+
+      result = gpgme_op_verify_result (worker->context->ctx);
+      if (result && result->signatures)
+        {
+          /* The result is released by the next operation of the
+             context, thus take a reference for the worker and one
+             for FILE_ITEM.  */
+          gpgme_result_ref (result);
+          gpgme_result_ref (result);
+          worker->result = result;
+          file_item->verify_result = result;
+        }
+    }
+
+  return 0;
+}
+
+
+/* Add the verification RESULT of FILE_ITEM to the result dialog.  */
+static void
+gpa_file_decrypt_operation_add_result (GpaFileOperation *fileop,
+                                       gpa_file_item_t file_item,
+                                       gpointer result)
+{
+  GpaFileDecryptOperation *op = GPA_FILE_DECRYPT_OPERATION (fileop);
+  gpgme_verify_result_t verify_result = result;
+
+  if (!verify_result)
+    return;
+
+  if (op->dialog)
+    {
+      gpa_file_verify_dialog_add_file (GPA_FILE_VERIFY_DIALOG (op->dialog),
+                                       file_item->filename_in, NULL, NULL,
+                                       verify_result->signatures);
+      op->signed_files++;
+    }
+  gpgme_result_unref (verify_result);
+}
+
+
+/* All files have been decrypted by the workers.  */
+static void
+gpa_file_decrypt_operation_files_done (GpaFileOperation *fileop,
+                                       gpg_error_t err)
+{
+  GpaFileDecryptOperation *op = GPA_FILE_DECRYPT_OPERATION (fileop);
+
+  if (op->dialog && op->signed_files)
+    {
+      /* Show the results dialog.  */
+      op->err = err;
+      gtk_widget_show_all (op->dialog);
+    }
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
 static gboolean
 gpa_file_decrypt_operation_idle_cb (gpointer data)
 {
   GpaFileDecryptOperation *op = data;
 
-  gpa_file_decrypt_operation_next (op);
+  if (gpa_file_operation_use_workers (GPA_FILE_OPERATION (op)))
+    gpa_file_operation_run_workers (GPA_FILE_OPERATION (op));
+  else
+    gpa_file_decrypt_operation_next (op);
 
   return FALSE;
 }
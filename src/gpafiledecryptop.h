@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "gpafileop.h"
+#include "membuf.h"
 
 /* GObject stuff */
 #define GPA_FILE_DECRYPT_OPERATION_TYPE	  (gpa_file_decrypt_operation_get_type ())
@@ -42,6 +43,8 @@ struct _GpaFileDecryptOperation {
 
   int cipher_fd, plain_fd;
   gpgme_data_t cipher, plain;
+  /* The output for direct input.  */
+  membuf_t plain_buf;
  
   gboolean verify;
   gpg_error_t err;
@@ -50,6 +50,10 @@ static void gpa_file_encrypt_operation_done_cb (GpaContext *context,
 static void gpa_file_encrypt_operation_response_cb (GtkDialog *dialog,
 						    gint response,
 						    gpointer user_data);
+static gpg_error_t gpa_file_encrypt_operation_start_file
+	(GpaFileOperation *fileop, gpa_file_worker_t worker);
+static gpg_error_t gpa_file_encrypt_operation_finish_file
+	(GpaFileOperation *fileop, gpa_file_worker_t worker, gpg_error_t err);
 
 /* GObject */
 
@@ -103,6 +107,8 @@ gpa_file_encrypt_operation_finalize (GObject *object)
 {
   GpaFileEncryptOperation *op = GPA_FILE_ENCRYPT_OPERATION (object);
 
+  g_free (get_membuf (&op->cipher_buf, NULL));
+
   /* FIXME: The use of RSET is messed up.  There is no clear concept
      on who owns the key.  This should be fixed by refing the keys
      object.  I doubt that the keys are at all released. */
@@ -123,6 +129,7 @@ gpa_file_encrypt_operation_init (GpaFileEncryptOperation *op)
   op->plain = NULL;
   op->encrypt_dialog = NULL;
   op->force_armor = FALSE;
+  op->sign = FALSE;
 }
 
 static GObject*
@@ -140,16 +147,21 @@ gpa_file_encrypt_operation_constructor
 				      construct_properties);
   op = GPA_FILE_ENCRYPT_OPERATION (object);
   /* Initialize */
-  /* Create the "Encrypt" dialog */
-  op->encrypt_dialog = gpa_file_encrypt_dialog_new
-    (GPA_OPERATION (op)->window, op->force_armor);
-  g_signal_connect (G_OBJECT (op->encrypt_dialog), "response",
-		    G_CALLBACK (gpa_file_encrypt_operation_response_cb), op);
   /* Connect to the "done" signal */
   g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
 		    G_CALLBACK (gpa_file_encrypt_operation_done_error_cb), op);
   g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
 		    G_CALLBACK (gpa_file_encrypt_operation_done_cb), op);
+  /* The batch mode starts the operation with
+     gpa_file_encrypt_operation_run.  */
+  if (batch_mode)
+    return object;
+
+  /* Create the "Encrypt" dialog */
+  op->encrypt_dialog = gpa_file_encrypt_dialog_new
+    (GPA_OPERATION (op)->window, op->force_armor);
+  g_signal_connect (G_OBJECT (op->encrypt_dialog), "response",
+		    G_CALLBACK (gpa_file_encrypt_operation_response_cb), op);
   /* Give a title to the progress dialog */
   gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
 			_("Encrypting..."));
@@ -163,6 +175,7 @@ static void
 gpa_file_encrypt_operation_class_init (GpaFileEncryptOperationClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GpaFileOperationClass *file_op_class = GPA_FILE_OPERATION_CLASS (klass);
 
   parent_class = g_type_class_peek_parent (klass);
 
@@ -171,6 +184,9 @@ gpa_file_encrypt_operation_class_init (GpaFileEncryptOperationClass *klass)
   object_class->set_property = gpa_file_encrypt_operation_set_property;
   object_class->get_property = gpa_file_encrypt_operation_get_property;
 
+  file_op_class->start_file = gpa_file_encrypt_operation_start_file;
+  file_op_class->finish_file = gpa_file_encrypt_operation_finish_file;
+
   g_object_class_install_property (object_class,
 				   PROP_FORCE_ARMOR,
 				   g_param_spec_boolean
@@ -298,7 +314,8 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
 	  return err;
 	}
 
-      err = gpgme_data_new (&op->cipher);
+      init_membuf (&op->cipher_buf, file_item->direct_in_len + 1024);
+      err = membuf_data_new (&op->cipher, &op->cipher_buf);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -336,13 +353,13 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
 
       xfree (file_item->filename_out);
       file_item->filename_out = filename_used;
+      gpa_output_reserve (op->cipher, op->plain_fd);
     }
 
   /* Start the operation.  */
   /* Always trust keys, because any untrusted keys were already
      confirmed by the user.  */
-  if (gpa_file_encrypt_dialog_get_sign
-      (GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog)))
+  if (op->sign)
     err = gpgme_op_encrypt_sign_start (GPA_OPERATION (op)->context->ctx,
 				       op->rset, GPGME_ENCRYPT_ALWAYS_TRUST,
 				       op->plain, op->cipher);
@@ -361,7 +378,6 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
       op->plain_fd = -1;
       gpgme_data_release (op->cipher);
       op->cipher = NULL;
-      close (op->cipher_fd);
       op->cipher_fd = -1;
 
       return err;
@@ -384,14 +400,20 @@ gpa_file_encrypt_operation_next (GpaFileEncryptOperation *op)
 
   if (! GPA_FILE_OPERATION (op)->current)
     {
-      g_signal_emit_by_name (GPA_OPERATION (op), "completed", 0);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                             GPA_FILE_OPERATION (op)->first_err);
       return;
     }
 
   err = gpa_file_encrypt_operation_start
     (op, GPA_FILE_OPERATION (op)->current->data);
   if (err)
-    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    {
+      gpa_file_operation_file_done (GPA_FILE_OPERATION (op),
+                                    GPA_FILE_OPERATION (op)->current->data,
+                                    err);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    }
 }
 
 
@@ -405,26 +427,21 @@ gpa_file_encrypt_operation_done_cb (GpaContext *context,
   if (file_item->direct_in)
     {
       size_t len;
-      char *cipher_gpgme = gpgme_data_release_and_get_mem (op->cipher,
-							   &len);
+
+      /* gpgme wrote the output directly into the buffer; take it
+	 over as a string.  */
+      gpgme_data_release (op->cipher);
       op->cipher = NULL;
-      /* Do the memory allocation dance.  */
+      file_item->direct_out = get_membuf_string (&op->cipher_buf, &len);
+      file_item->direct_out_len = file_item->direct_out ? len : 0;
+    }
 
-      if (cipher_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, cipher_gpgme, len);
-	  gpgme_free (cipher_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
+  if (! err && ! file_item->direct_in)
+    {
+      /* Give the output file its name.  */
+      err = gpa_output_commit (op->cipher);
+      if (err)
+        gpa_gpgme_warning (err);
     }
 
   /* Do clean up on the operation */
@@ -434,21 +451,31 @@ gpa_file_encrypt_operation_done_cb (GpaContext *context,
   op->plain_fd = -1;
   gpgme_data_release (op->cipher);
   op->cipher = NULL;
-  close (op->cipher_fd);
   op->cipher_fd = -1;
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
 
+  gpa_file_operation_file_done (GPA_FILE_OPERATION (op), file_item, err);
   if (err)
     {
       if (! file_item->direct_in)
 	{
-	  /* If an error happened, (or the user canceled) delete the
-	    created file and abort further encryptions.  */
-	  g_unlink (file_item->filename_out);
+	  /* If an error happened, (or the user canceled) the created
+	     file has been removed.  */
 	  g_free (file_item->filename_out);
 	  file_item->filename_out = NULL;
 	}
-      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+      if (GPA_FILE_OPERATION (op)->keep_going && ! file_item->direct_in
+          && gpg_err_code (err) != GPG_ERR_CANCELED)
+        {
+          /* Remember the error and continue with the next file.  */
+          if (! GPA_FILE_OPERATION (op)->first_err)
+            GPA_FILE_OPERATION (op)->first_err = err;
+          GPA_FILE_OPERATION (op)->current = g_list_next
+            (GPA_FILE_OPERATION (op)->current);
+          gpa_file_encrypt_operation_next (op);
+        }
+      else
+        g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
     }
   else
     {
@@ -462,6 +489,79 @@ gpa_file_encrypt_operation_done_cb (GpaContext *context,
     }
 }
 
+/* Start encrypting the file of WORKER.  This is used instead of
+   gpa_file_encrypt_operation_start if several files are encrypted at
+   the same time.  All workers share the recipient set of OP.  */
+static gpg_error_t
+gpa_file_encrypt_operation_start_file (GpaFileOperation *fileop,
+                                       gpa_file_worker_t worker)
+{
+  GpaFileEncryptOperation *op = GPA_FILE_ENCRYPT_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+  gpgme_ctx_t ctx = worker->context->ctx;
+  char *filename_used;
+  gpg_error_t err;
+
+  file_item->filename_out = destination_filename
+    (file_item->filename_in, gpgme_get_armor (ctx));
+
+  worker->in_fd = gpa_open_input (file_item->filename_in, &worker->in,
+                                  GPA_OPERATION (op)->window);
+  if (worker->in_fd == -1)
+    return gpg_error (GPG_ERR_GENERAL);
+
+  worker->out_fd = gpa_open_output (file_item->filename_out, &worker->out,
+                                    GPA_OPERATION (op)->window,
+                                    &filename_used);
+  if (worker->out_fd == -1)
+    {
+      xfree (filename_used);
+      return gpg_error (GPG_ERR_GENERAL);
+    }
+  xfree (file_item->filename_out);
+  file_item->filename_out = filename_used;
+  gpa_output_reserve (worker->out, worker->in_fd);
+
+  /* Always trust keys, because any untrusted keys were already
+     confirmed by the user.  */
+  if (op->sign)
+    err = gpgme_op_encrypt_sign_start (ctx, op->rset,
+                                       GPGME_ENCRYPT_ALWAYS_TRUST,
+                                       worker->in, worker->out);
+  else
+    err = gpgme_op_encrypt_start (ctx, op->rset, GPGME_ENCRYPT_ALWAYS_TRUST,
+                                  worker->in, worker->out);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      g_free (file_item->filename_out);
+      file_item->filename_out = NULL;
+    }
+  return err;
+}
+
+
+/* Encrypting the file of WORKER has finished.  */
+static gpg_error_t
+gpa_file_encrypt_operation_finish_file (GpaFileOperation *fileop,
+                                        gpa_file_worker_t worker,
+                                        gpg_error_t err)
+{
+  GpaFileEncryptOperation *op = GPA_FILE_ENCRYPT_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+
+  gpa_file_encrypt_operation_done_error_cb (worker->context, err, op);
+  if (err)
+    {
+      g_free (file_item->filename_out);
+      file_item->filename_out = NULL;
+    }
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "created_file", file_item);
+
+  return err;
+}
+
 /*
  * Setting the recipients for the context.
  */
@@ -478,6 +578,10 @@ ignore_key_trust (gpgme_key_t key, GtkWidget *parent)
   GtkResponseType response;
   GtkWidget *box;
 
+  /* In the batch mode the key was named on the command line.  */
+  if (batch_mode)
+    return GTK_RESPONSE_YES;
+
   dialog = gtk_dialog_new_with_buttons (_("Unknown Key"), GTK_WINDOW(parent),
 					GTK_DIALOG_MODAL,
 					_("_Yes"), GTK_RESPONSE_YES,
@@ -531,6 +635,14 @@ revoked_key (gpgme_key_t key, GtkWidget *parent)
   GtkWidget *image;
   GtkWidget *box;
 
+  if (batch_mode)
+    {
+      gpa_show_warn (parent, NULL, "%s %s",
+                     _("The following key has been revoked by its owner:"),
+                     key->subkeys->fpr);
+      return;
+    }
+
   dialog = gtk_dialog_new_with_buttons (_("Revoked Key"), GTK_WINDOW(parent),
 					GTK_DIALOG_MODAL,
 					_("_Close"), GTK_RESPONSE_CLOSE,
@@ -574,6 +686,18 @@ expired_key (gpgme_key_t key, GtkWidget *parent)
   GtkWidget *box;
   gchar *message;
 
+  if (batch_mode)
+    {
+      gchar *date = gpa_expiry_date_string (key->subkeys->expires);
+
+      message = g_strdup_printf (_("The following key expired on %s:"),
+                                 date);
+      gpa_show_warn (parent, NULL, "%s %s", message, key->subkeys->fpr);
+      g_free (message);
+      g_free (date);
+      return;
+    }
+
   dialog = gtk_dialog_new_with_buttons (_("Revoked Key"), GTK_WINDOW(parent),
 					GTK_DIALOG_MODAL,
 					_("_Close"), GTK_RESPONSE_CLOSE,
@@ -720,6 +844,38 @@ set_signers (GpaFileEncryptOperation *op, GList *signers)
   return TRUE;
 }
 
+/* Encrypt the files of OP for RECIPIENTS.  If SIGN is set, they are
+   also signed by SIGNERS.  */
+void
+gpa_file_encrypt_operation_run (GpaFileEncryptOperation *op,
+                                GList *recipients, gboolean sign,
+                                GList *signers, gboolean armor)
+{
+  gboolean success = TRUE;
+
+  g_return_if_fail (GPA_IS_FILE_ENCRYPT_OPERATION (op));
+
+  op->sign = sign;
+  /* Set the armor value */
+  gpgme_set_armor (GPA_OPERATION (op)->context->ctx, armor);
+  /* Set the signers for the context.  */
+  if (sign)
+    success = set_signers (op, signers);
+
+  /* Set the recipients for the context.  */
+  if (success)
+    success = set_recipients (op, recipients);
+
+  /* Actually run the operation or abort.  */
+  if (success && gpa_file_operation_use_workers (GPA_FILE_OPERATION (op)))
+    gpa_file_operation_run_workers (GPA_FILE_OPERATION (op));
+  else if (success)
+    gpa_file_encrypt_operation_next (op);
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                           gpg_error (GPG_ERR_GENERAL));
+}
+
 /*
  * The key selection dialog has returned.
  */
@@ -733,31 +889,14 @@ static void gpa_file_encrypt_operation_response_cb (GtkDialog *dialog,
 
   if (response == GTK_RESPONSE_OK)
     {
-      gboolean success = TRUE;
-      gboolean armor = gpa_file_encrypt_dialog_get_armor
-	(GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog));
-      GList *signers = gpa_file_encrypt_dialog_signers
-	(GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog));
-      GList *recipients = gpa_file_encrypt_dialog_recipients
-	(GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog));
-
-      /* Set the armor value */
-      gpgme_set_armor (GPA_OPERATION (op)->context->ctx, armor);
-      /* Set the signers for the context.  */
-      if (gpa_file_encrypt_dialog_get_sign
-	  (GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog)))
-	success = set_signers (op, signers);
-
-      /* Set the recipients for the context.  */
-      if (success)
-	success = set_recipients (op, recipients);
-
-      /* Actually run the operation or abort.  */
-      if (success)
-	gpa_file_encrypt_operation_next (op);
-      else
-	g_signal_emit_by_name (GPA_OPERATION (op), "completed",
-				 gpg_error (GPG_ERR_GENERAL));
+      GpaFileEncryptDialog *encrypt_dialog
+	= GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog);
+      GList *signers = gpa_file_encrypt_dialog_signers (encrypt_dialog);
+      GList *recipients = gpa_file_encrypt_dialog_recipients (encrypt_dialog);
+
+      gpa_file_encrypt_operation_run
+	(op, recipients, gpa_file_encrypt_dialog_get_sign (encrypt_dialog),
+	 signers, gpa_file_encrypt_dialog_get_armor (encrypt_dialog));
 
       g_list_free (signers);
       g_list_free (recipients);
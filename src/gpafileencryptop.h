@@ -24,6 +24,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "gpafileop.h"
+#include "membuf.h"
 
 /* GObject stuff */
 #define GPA_FILE_ENCRYPT_OPERATION_TYPE	\
@@ -59,8 +60,13 @@ struct _GpaFileEncryptOperation
   gpgme_key_t *rset;
   int cipher_fd, plain_fd;
   gpgme_data_t cipher, plain;
+  /* The output for direct input.  */
+  membuf_t cipher_buf;
 
   gboolean force_armor;
+
+  /* True if the files are also signed.  */
+  gboolean sign;
 };
 
 
@@ -86,4 +92,10 @@ GpaFileEncryptOperation *gpa_file_encrypt_sign_operation_new
 GpaFileEncryptOperation*
 gpa_file_encrypt_operation_new_for_server (GList *files, void *server_ctx);
 
+/* Start the operation OP with the keys and options chosen in the
+   dialog or, in the batch mode, given on the command line.  */
+void gpa_file_encrypt_operation_run (GpaFileEncryptOperation *op,
+                                     GList *recipients, gboolean sign,
+                                     GList *signers, gboolean armor);
+
 #endif
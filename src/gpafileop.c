@@ -21,14 +21,28 @@
 
 #include <config.h>
 
+#include <glib.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
 #include "i18n.h"
 #include "gtktools.h"
 #include "gpafileop.h"
+#include "gpa-marshal.h"
+#include "options.h"
+
+/* The maximum number of files processed at the same time by
+   default.  */
+#define MAX_DEFAULT_WORKERS 8
 
 /* Signals */
 enum
 {
   CREATED_FILE,
+  FILE_DONE,
   LAST_SIGNAL
 };
 
@@ -36,7 +50,9 @@ enum
 enum
 {
   PROP_0,
-  PROP_INPUT_FILES
+  PROP_INPUT_FILES,
+  PROP_WORKERS,
+  PROP_KEEP_GOING
 };
 
 static GObjectClass *parent_class = NULL;
@@ -55,6 +71,12 @@ gpa_file_operation_get_property (GObject     *object,
     case PROP_INPUT_FILES:
       g_value_set_pointer (value, op->input_files);
       break;
+    case PROP_WORKERS:
+      g_value_set_uint (value, op->max_workers);
+      break;
+    case PROP_KEEP_GOING:
+      g_value_set_boolean (value, op->keep_going);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -75,6 +97,12 @@ gpa_file_operation_set_property (GObject     *object,
       op->input_files = (GList*) g_value_get_pointer (value);
       op->current = op->input_files;
       break;
+    case PROP_WORKERS:
+      op->max_workers = g_value_get_uint (value);
+      break;
+    case PROP_KEEP_GOING:
+      op->keep_going = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -95,6 +123,20 @@ free_file_item (gpa_file_item_t item)
     g_free (item->direct_in);
   if (item->direct_out)
     g_free (item->direct_out);
+  if (item->verify_result)
+    gpgme_result_unref (item->verify_result);
+}
+
+
+static void
+release_worker (gpa_file_worker_t worker)
+{
+  if (worker->context)
+    {
+      g_signal_handler_disconnect (worker->context, worker->done_id);
+      g_object_unref (worker->context);
+    }
+  g_free (worker);
 }
 
 
@@ -103,9 +145,17 @@ gpa_file_operation_finalize (GObject *object)
 {
   GpaFileOperation *op = GPA_FILE_OPERATION (object);
 
+  if (op->workers)
+    {
+      g_ptr_array_foreach (op->workers, (GFunc) release_worker, NULL);
+      g_ptr_array_free (op->workers, TRUE);
+    }
+  if (op->results)
+    g_ptr_array_free (op->results, TRUE);
   g_list_foreach (op->input_files, (GFunc) free_file_item, NULL);
   g_list_free (op->input_files);
-  gtk_widget_destroy (op->progress_dialog);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
   
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -116,6 +166,18 @@ gpa_file_operation_init (GpaFileOperation *op)
   op->input_files = NULL;
   op->current = NULL;
   op->progress_dialog = NULL;
+  op->max_workers = 0;
+  op->keep_going = gpa_options_get_keep_going (gpa_options_get_instance ());
+  op->workers = NULL;
+  op->next_item = NULL;
+  op->next_index = 0;
+  op->results = NULL;
+  op->next_result = 0;
+  op->result_item = NULL;
+  op->n_files = 0;
+  op->n_finished = 0;
+  op->n_failed = 0;
+  op->first_err = 0;
 }
 
 static GObject*
@@ -132,8 +194,17 @@ gpa_file_operation_constructor (GType type,
 				      construct_properties);
   op = GPA_FILE_OPERATION (object);
   /* Initialize */
-  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION(op)->window,
-						 GPA_OPERATION(op)->context);
+  if (!batch_mode)
+    op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION(op)->window,
+						   GPA_OPERATION(op)->context);
+  if (!op->max_workers && file_workers > 0)
+    op->max_workers = file_workers;
+  if (!op->max_workers)
+    op->max_workers = gpa_options_get_file_workers
+      (gpa_options_get_instance ());
+  if (!op->max_workers)
+    op->max_workers = CLAMP (g_get_num_processors (),
+                             1, MAX_DEFAULT_WORKERS);
 
   return object;
 }
@@ -151,6 +222,11 @@ gpa_file_operation_class_init (GpaFileOperationClass *klass)
   object_class->get_property = gpa_file_operation_get_property;
 
   klass->created_file = NULL;
+  klass->file_done = NULL;
+  klass->start_file = NULL;
+  klass->finish_file = NULL;
+  klass->add_result = NULL;
+  klass->files_done = NULL;
 
   /* Signals */
   signals[CREATED_FILE] =
@@ -162,6 +238,15 @@ gpa_file_operation_class_init (GpaFileOperationClass *klass)
 		  g_cclosure_marshal_VOID__POINTER,
 		  G_TYPE_NONE, 1,
 		  G_TYPE_POINTER);
+  signals[FILE_DONE] =
+    g_signal_new ("file_done",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_FIRST,
+		  G_STRUCT_OFFSET (GpaFileOperationClass, file_done),
+		  NULL, NULL,
+		  gpa_marshal_VOID__POINTER_UINT,
+		  G_TYPE_NONE, 2,
+		  G_TYPE_POINTER, G_TYPE_UINT);
   /* Properties */
   g_object_class_install_property (object_class,
 				   PROP_INPUT_FILES,
@@ -169,6 +254,21 @@ gpa_file_operation_class_init (GpaFileOperationClass *klass)
 				   ("input_files", "Files",
 				    "Files",
 				    G_PARAM_WRITABLE|G_PARAM_CONSTRUCT_ONLY));
+  g_object_class_install_property (object_class,
+				   PROP_WORKERS,
+				   g_param_spec_uint
+				   ("workers", "Workers",
+				    "Maximum number of files processed at once",
+				    0, G_MAXUINT, 0,
+				    G_PARAM_READWRITE|G_PARAM_CONSTRUCT_ONLY));
+  /* Not G_PARAM_CONSTRUCT so that the default is taken from the
+     options.  */
+  g_object_class_install_property (object_class,
+				   PROP_KEEP_GOING,
+				   g_param_spec_boolean
+				   ("keep-going", "Keep going",
+				    "Continue with the next file after an error",
+				    FALSE, G_PARAM_READWRITE));
 }
 
 GType
@@ -230,3 +330,269 @@ gpa_file_operation_current_file (GpaFileOperation *op)
   else
     return NULL;
 }
+
+
+/* Emit the "file_done" signal for ITEM.  */
+void
+gpa_file_operation_file_done (GpaFileOperation *op, gpa_file_item_t item,
+                              gpg_error_t err)
+{
+  g_return_if_fail (GPA_IS_FILE_OPERATION (op));
+
+  g_signal_emit (op, signals[FILE_DONE], 0, item, err);
+}
+
+
+/* Returns true if the files of OP shall be processed concurrently
+   using gpa_file_operation_run_workers.  */
+gboolean
+gpa_file_operation_use_workers (GpaFileOperation *op)
+{
+  GList *cur;
+
+  g_return_val_if_fail (GPA_IS_FILE_OPERATION (op), FALSE);
+
+  if (!GPA_FILE_OPERATION_GET_CLASS (op)->start_file || !op->input_files)
+    return FALSE;
+  /* The batch mode has no dialogs and thus always uses the workers,
+     even for a single file.  */
+  if (!batch_mode && (op->max_workers < 2 || !op->input_files->next))
+    return FALSE;
+
+  /* Texts from the clipboard are not worth it.  */
+  for (cur = op->input_files; cur; cur = g_list_next (cur))
+    if (((gpa_file_item_t) cur->data)->direct_in)
+      return FALSE;
+
+  return TRUE;
+}
+
+
+/* Show the number of files finished in the progress dialog.  */
+static void
+update_progress (GpaFileOperation *op, gpa_file_item_t file_item)
+{
+  GpaProgressDialog *dialog;
+  gchar *text;
+
+  if (!op->progress_dialog)
+    return;
+
+  dialog = GPA_PROGRESS_DIALOG (op->progress_dialog);
+  if (file_item)
+    {
+      text = g_strdup_printf (_("%s (%u of %u files done)"),
+                              file_item->filename_in,
+                              op->n_finished, op->n_files);
+      gpa_progress_dialog_set_label (dialog, text);
+      g_free (text);
+    }
+  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (dialog->pbar),
+                                 (gdouble) op->n_finished / op->n_files);
+}
+
+
+/* Release the data objects and close the files of WORKER.  */
+static void
+clear_worker_data (gpa_file_worker_t worker)
+{
+  gpgme_data_release (worker->in);
+  worker->in = NULL;
+  gpgme_data_release (worker->out);
+  worker->out = NULL;
+  gpgme_data_release (worker->extra);
+  worker->extra = NULL;
+  if (worker->in_fd != -1)
+    {
+      close (worker->in_fd);
+      worker->in_fd = -1;
+    }
+  /* The output file is closed by its data object.  */
+  worker->out_fd = -1;
+  if (worker->extra_fd != -1)
+    {
+      close (worker->extra_fd);
+      worker->extra_fd = -1;
+    }
+}
+
+
+/* Marks a finished file without a result in OP->results.  */
+static char no_result;
+
+/* Store the result of the file of WORKER and pass all results which
+   are now complete in input order to the add_result method.  */
+static void
+add_worker_result (GpaFileOperation *op, gpa_file_worker_t worker)
+{
+  GpaFileOperationClass *klass = GPA_FILE_OPERATION_GET_CLASS (op);
+  gpointer result;
+
+  if (!klass->add_result)
+    return;
+
+  g_ptr_array_index (op->results, worker->index)
+    = worker->result ? worker->result : &no_result;
+  worker->result = NULL;
+
+  while (op->next_result < op->results->len
+         && (result = g_ptr_array_index (op->results, op->next_result)))
+    {
+      g_ptr_array_index (op->results, op->next_result) = NULL;
+      klass->add_result (op, op->result_item->data,
+                         result == &no_result ? NULL : result);
+      op->next_result++;
+      op->result_item = g_list_next (op->result_item);
+    }
+}
+
+
+/* Account for the file of WORKER which finished with ERR.  */
+static void
+count_finished_file (GpaFileOperation *op, gpa_file_worker_t worker,
+                     gpg_error_t err)
+{
+  gpa_file_operation_file_done (op, worker->item->data, err);
+  add_worker_result (op, worker);
+  op->n_finished++;
+  if (err)
+    {
+      op->n_failed++;
+      if (!op->first_err)
+        op->first_err = err;
+      /* Canceling stops the operation even if we keep going.  */
+      if (gpg_err_code (err) == GPG_ERR_CANCELED)
+        op->keep_going = FALSE;
+    }
+}
+
+
+/* Start the next file in WORKER.  Returns false if there is no file
+   left to start or if an error occurred.  */
+static gboolean
+start_next_file (GpaFileOperation *op, gpa_file_worker_t worker)
+{
+  GpaFileOperationClass *klass = GPA_FILE_OPERATION_GET_CLASS (op);
+  gpg_error_t err;
+
+  while (op->next_item && (op->keep_going || !op->first_err))
+    {
+      worker->item = op->next_item;
+      worker->index = op->next_index++;
+      op->next_item = g_list_next (op->next_item);
+      op->current = worker->item;
+
+      err = klass->start_file (op, worker);
+      if (!err)
+        {
+          update_progress (op, worker->item->data);
+          return TRUE;
+        }
+      clear_worker_data (worker);
+      count_finished_file (op, worker, err);
+    }
+  worker->item = NULL;
+  return FALSE;
+}
+
+
+/* Emit "completed" if no worker is busy anymore.  */
+static void
+check_completed (GpaFileOperation *op)
+{
+  guint i;
+
+  for (i = 0; i < op->workers->len; i++)
+    if (((gpa_file_worker_t) g_ptr_array_index (op->workers, i))->item)
+      return;
+
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+  op->current = NULL;
+  if (GPA_FILE_OPERATION_GET_CLASS (op)->files_done)
+    GPA_FILE_OPERATION_GET_CLASS (op)->files_done (op, op->first_err);
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->first_err);
+}
+
+
+static void
+worker_done_cb (GpaContext *context, gpg_error_t err,
+                gpa_file_worker_t worker)
+{
+  GpaFileOperation *op = worker->op;
+
+  if (!err && worker->out)
+    {
+      /* Give the output file its name.  */
+      err = gpa_output_commit (worker->out);
+      if (err)
+        gpa_gpgme_warning (err);
+    }
+  clear_worker_data (worker);
+  err = GPA_FILE_OPERATION_GET_CLASS (op)->finish_file (op, worker, err);
+  count_finished_file (op, worker, err);
+  update_progress (op, NULL);
+  if (!start_next_file (op, worker))
+    check_completed (op);
+}
+
+
+/* Process all files of OP with up to OP->max_workers files at the
+   same time.  The operation emits "completed" with the first error
+   when all files are done.  Unless OP->keep_going is set, no further
+   files are started after an error.  */
+void
+gpa_file_operation_run_workers (GpaFileOperation *op)
+{
+  gpgme_ctx_t ctx = GPA_OPERATION (op)->context->ctx;
+  gpgme_key_t key;
+  guint i, j, n;
+
+  g_return_if_fail (gpa_file_operation_use_workers (op));
+  g_return_if_fail (!op->workers);
+
+  op->n_files = g_list_length (op->input_files);
+  op->next_item = op->input_files;
+  op->next_index = 0;
+  op->results = g_ptr_array_sized_new (op->n_files);
+  g_ptr_array_set_size (op->results, op->n_files);
+  op->next_result = 0;
+  op->result_item = op->input_files;
+
+  n = MIN (op->max_workers, op->n_files);
+  op->workers = g_ptr_array_sized_new (n);
+  for (i = 0; i < n; i++)
+    {
+      gpa_file_worker_t worker = g_malloc0 (sizeof *worker);
+
+      worker->op = op;
+      worker->in_fd = -1;
+      worker->out_fd = -1;
+      worker->extra_fd = -1;
+      worker->context = gpa_context_new ();
+      worker->done_id = g_signal_connect (worker->context, "done",
+                                          G_CALLBACK (worker_done_cb),
+                                          worker);
+
+      /* Take over the settings made for the operation.  */
+      gpgme_set_protocol (worker->context->ctx, gpgme_get_protocol (ctx));
+      gpgme_set_armor (worker->context->ctx, gpgme_get_armor (ctx));
+      gpgme_set_textmode (worker->context->ctx, gpgme_get_textmode (ctx));
+      for (j = 0; (key = gpgme_signers_enum (ctx, j)); j++)
+        {
+          gpgme_signers_add (worker->context->ctx, key);
+          gpgme_key_unref (key);
+        }
+
+      g_ptr_array_add (op->workers, worker);
+    }
+
+  if (op->progress_dialog)
+    gtk_widget_show_all (op->progress_dialog);
+  update_progress (op, op->input_files->data);
+  for (i = 0; i < op->workers->len; i++)
+    if (!start_next_file (op, g_ptr_array_index (op->workers, i)))
+      break;
+  check_completed (op);
+}
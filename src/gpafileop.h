@@ -53,16 +53,79 @@ struct gpa_file_item_s
   /* The filename to operate on (if DIRECT_IN is NULL).  */
   gchar *filename_in;
   gchar *filename_out;
+
+  /* The result of verifying the signatures of the file or NULL.  Set
+     by the workers of the verify and decrypt operations before
+     "file_done" is emitted.  */
+  gpgme_verify_result_t verify_result;
 };
 typedef struct gpa_file_item_s *gpa_file_item_t; 
 
 
+/* The state of a file being processed concurrently with others.  */
+struct gpa_file_worker_s
+{
+  GpaFileOperation *op;
+
+  /* The context used for the file.  It has the settings of the
+     context of the operation.  */
+  GpaContext *context;
+  gulong done_id;
+
+  /* The element of INPUT_FILES being processed and its index.  */
+  GList *item;
+  guint index;
+
+  /* The data objects and file descriptors of the file, for use by
+     the subclass.  They are released before finish_file is called
+     and if start_file fails.  OUT is committed with gpa_output_commit
+     if the operation succeeded.  */
+  gpgme_data_t in, out;
+  int in_fd, out_fd;
+
+  /* A second input, for example the signed text of a detached
+     signature.  Released like IN.  */
+  gpgme_data_t extra;
+  int extra_fd;
+
+  /* The result of the file for the add_result method.  May be set by
+     start_file and finish_file.  */
+  gpointer result;
+};
+typedef struct gpa_file_worker_s *gpa_file_worker_t;
+
+
 struct _GpaFileOperation {
   GpaOperation parent;
 
   GList *input_files;
   GList *current;
   GtkWidget *progress_dialog;
+
+  /* The maximum number of files processed at the same time.  */
+  guint max_workers;
+
+  /* If true, continue with the remaining files after an error.  */
+  gboolean keep_going;
+
+  /* The workers if the files are processed concurrently, the next
+     file to start with and its index.  */
+  GPtrArray *workers;
+  GList *next_item;
+  guint next_index;
+
+  /* The results of the finished files by index, and the next result
+     and file to pass to the add_result method.  */
+  GPtrArray *results;
+  guint next_result;
+  GList *result_item;
+
+  /* The number of files, the number of files finished and how many
+     of them failed, and the first error.  */
+  guint n_files;
+  guint n_finished;
+  guint n_failed;
+  gpg_error_t first_err;
 };
 
 struct _GpaFileOperationClass {
@@ -72,6 +135,32 @@ struct _GpaFileOperationClass {
   /* Called every time a new file is created by the operation,
    * *after* the operations is done with it. */
   void (*created_file) (GpaContext *context, const gchar *file);
+
+  /* Called every time the operation is done with a file, with the
+     error code of the file.  */
+  void (*file_done) (GpaFileOperation *op, gpa_file_item_t item,
+                     gpg_error_t err);
+
+  /* If set, the operation supports concurrent processing.  Start the
+     operation on the file of WORKER in WORKER->context.  */
+  gpg_error_t (*start_file) (GpaFileOperation *op, gpa_file_worker_t worker);
+
+  /* Finish the operation on the file of WORKER which returned ERR.
+     Returns the error to account for the file.  */
+  gpg_error_t (*finish_file) (GpaFileOperation *op, gpa_file_worker_t worker,
+                              gpg_error_t err);
+
+  /* If set, this is called with the result of each finished file in
+     the order of the input files, regardless of the order in which
+     they finished.  It takes ownership of RESULT, which is NULL if
+     the worker did not set one.  */
+  void (*add_result) (GpaFileOperation *op, gpa_file_item_t item,
+                      gpointer result);
+
+  /* If set, this is called instead of emitting "completed" when all
+     files have been processed by the workers.  ERR is the first
+     error.  */
+  void (*files_done) (GpaFileOperation *op, gpg_error_t err);
 };
 
 GType gpa_file_operation_get_type (void) G_GNUC_CONST;
@@ -88,4 +177,21 @@ gpa_file_operation_input_files (GpaFileOperation *op);
 const gchar *
 gpa_file_operation_current_file (GpaFileOperation *op);
 
+/* Emit the "file_done" signal for ITEM.  */
+void
+gpa_file_operation_file_done (GpaFileOperation *op, gpa_file_item_t item,
+                              gpg_error_t err);
+
+/* Returns true if the files of OP shall be processed concurrently
+   using gpa_file_operation_run_workers.  */
+gboolean
+gpa_file_operation_use_workers (GpaFileOperation *op);
+
+/* Process all files of OP with up to OP->max_workers files at the
+   same time.  The operation emits "completed" with the first error
+   when all files are done.  Unless OP->keep_going is set, no further
+   files are started after an error.  */
+void
+gpa_file_operation_run_workers (GpaFileOperation *op);
+
 #endif
@@ -49,6 +49,10 @@ static void gpa_file_sign_operation_done_cb (GpaContext *context,
 static void gpa_file_sign_operation_response_cb (GtkDialog *dialog,
 						    gint response,
 						    gpointer user_data);
+static gpg_error_t gpa_file_sign_operation_start_file
+     (GpaFileOperation *fileop, gpa_file_worker_t worker);
+static gpg_error_t gpa_file_sign_operation_finish_file
+     (GpaFileOperation *fileop, gpa_file_worker_t worker, gpg_error_t err);
 
 /* GObject */
 
@@ -100,6 +104,10 @@ gpa_file_sign_operation_set_property (GObject *object, guint prop_id,
 static void
 gpa_file_sign_operation_finalize (GObject *object)
 {
+  GpaFileSignOperation *op = GPA_FILE_SIGN_OPERATION (object);
+
+  g_free (get_membuf (&op->sig_buf, NULL));
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -132,6 +140,16 @@ gpa_file_sign_operation_constructor (GType type,
 				      construct_properties);
   op = GPA_FILE_SIGN_OPERATION (object);
   /* Initialize */
+  /* Connect to the "done" signal */
+  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
+		    G_CALLBACK (gpa_file_sign_operation_done_error_cb), op);
+  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
+		    G_CALLBACK (gpa_file_sign_operation_done_cb), op);
+  /* The batch mode starts the operation with
+     gpa_file_sign_operation_run.  */
+  if (batch_mode)
+    return object;
+
   /* Create the "Sign" dialog */
   op->sign_dialog = gpa_file_sign_dialog_new (GPA_OPERATION (op)->window);
   if (op->force_armor)
@@ -146,11 +164,6 @@ gpa_file_sign_operation_constructor (GType type,
 
   g_signal_connect (G_OBJECT (op->sign_dialog), "response",
 		    G_CALLBACK (gpa_file_sign_operation_response_cb), op);
-  /* Connect to the "done" signal */
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_file_sign_operation_done_error_cb), op);
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_file_sign_operation_done_cb), op);
   /* Give a title to the progress dialog */
   gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
 			_("Signing..."));
@@ -165,9 +178,13 @@ static void
 gpa_file_sign_operation_class_init (GpaFileSignOperationClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GpaFileOperationClass *file_op_class = GPA_FILE_OPERATION_CLASS (klass);
 
   parent_class = g_type_class_peek_parent (klass);
 
+  file_op_class->start_file = gpa_file_sign_operation_start_file;
+  file_op_class->finish_file = gpa_file_sign_operation_finish_file;
+
   object_class->constructor = gpa_file_sign_operation_constructor;
   object_class->finalize = gpa_file_sign_operation_finalize;
   object_class->set_property = gpa_file_sign_operation_set_property;
@@ -273,7 +290,8 @@ gpa_file_sign_operation_start (GpaFileSignOperation *op,
 	  return err;
 	}
 
-      err = gpgme_data_new (&op->sig);
+      init_membuf (&op->sig_buf, file_item->direct_in_len + 1024);
+      err = membuf_data_new (&op->sig, &op->sig_buf);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -312,6 +330,8 @@ gpa_file_sign_operation_start (GpaFileSignOperation *op,
 
       xfree (file_item->filename_out);
       file_item->filename_out = filename_used;
+      if (op->sign_type != GPGME_SIG_MODE_DETACH)
+        gpa_output_reserve (op->sig, op->plain_fd);
     }
 
   /* Start the operation */
@@ -348,7 +368,12 @@ gpa_file_sign_operation_next (GpaFileSignOperation *op)
   err = gpa_file_sign_operation_start (op,
 				       GPA_FILE_OPERATION (op)->current->data);
   if (err)
-    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    {
+      gpa_file_operation_file_done (GPA_FILE_OPERATION (op),
+                                    GPA_FILE_OPERATION (op)->current->data,
+                                    err);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    }
 }
 
 
@@ -362,25 +387,21 @@ gpa_file_sign_operation_done_cb (GpaContext *context,
   if (file_item->direct_in)
     {
       size_t len;
-      char *sig_gpgme = gpgme_data_release_and_get_mem (op->sig, &len);
+
+      /* gpgme wrote the output directly into the buffer; take it
+	 over as a string.  */
+      gpgme_data_release (op->sig);
       op->sig = NULL;
-      /* Do the memory allocation dance.  */
+      file_item->direct_out = get_membuf_string (&op->sig_buf, &len);
+      file_item->direct_out_len = file_item->direct_out ? len : 0;
+    }
 
-      if (sig_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, sig_gpgme, len);
-	  gpgme_free (sig_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
+  if (! err && ! file_item->direct_in)
+    {
+      /* Give the output file its name.  */
+      err = gpa_output_commit (op->sig);
+      if (err)
+        gpa_gpgme_warning (err);
     }
 
   /* Do clean up on the operation */
@@ -390,18 +411,18 @@ gpa_file_sign_operation_done_cb (GpaContext *context,
   op->plain_fd = -1;
   gpgme_data_release (op->sig);
   op->sig = NULL;
-  close (op->sig_fd);
   op->sig_fd = -1;
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
 
+  gpa_file_operation_file_done (GPA_FILE_OPERATION (op), file_item, err);
   if (err)
     {
       if (! file_item->direct_in)
 	{
-	  /* If an error happened, (or the user canceled) delete the
-	     created file and abort further signions.  */
-	  g_unlink (op->sig_filename);
-	  g_free (op->sig_filename);
+	  /* If an error happened, (or the user canceled) the created
+	     file has been removed.  Abort further signings.  */
+	  g_free (file_item->filename_out);
+	  file_item->filename_out = NULL;
 	}
       g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
     }
@@ -418,6 +439,65 @@ gpa_file_sign_operation_done_cb (GpaContext *context,
 }
 
 
+/* Start signing the file of WORKER.  This is used instead of
+   gpa_file_sign_operation_start if several files are signed at the
+   same time.  */
+static gpg_error_t
+gpa_file_sign_operation_start_file (GpaFileOperation *fileop,
+                                    gpa_file_worker_t worker)
+{
+  GpaFileSignOperation *op = GPA_FILE_SIGN_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+  gpgme_ctx_t ctx = worker->context->ctx;
+  char *filename_used;
+  gpg_error_t err;
+
+  file_item->filename_out = destination_filename
+    (file_item->filename_in, gpgme_get_armor (ctx),
+     gpgme_get_protocol (ctx), op->sign_type);
+
+  worker->in_fd = gpa_open_input (file_item->filename_in, &worker->in,
+                                  GPA_OPERATION (op)->window);
+  if (worker->in_fd == -1)
+    return gpg_error (GPG_ERR_GENERAL);
+
+  worker->out_fd = gpa_open_output (file_item->filename_out, &worker->out,
+                                    GPA_OPERATION (op)->window,
+                                    &filename_used);
+  if (worker->out_fd == -1)
+    {
+      xfree (filename_used);
+      return gpg_error (GPG_ERR_GENERAL);
+    }
+  xfree (file_item->filename_out);
+  file_item->filename_out = filename_used;
+  if (op->sign_type != GPGME_SIG_MODE_DETACH)
+    gpa_output_reserve (worker->out, worker->in_fd);
+
+  err = gpgme_op_sign_start (ctx, worker->in, worker->out, op->sign_type);
+  if (err)
+    gpa_gpgme_warning (err);
+  return err;
+}
+
+
+/* Signing the file of WORKER has finished.  */
+static gpg_error_t
+gpa_file_sign_operation_finish_file (GpaFileOperation *fileop,
+                                     gpa_file_worker_t worker,
+                                     gpg_error_t err)
+{
+  GpaFileSignOperation *op = GPA_FILE_SIGN_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+
+  gpa_file_sign_operation_done_error_cb (worker->context, err, op);
+  if (!err)
+    g_signal_emit_by_name (GPA_OPERATION (op), "created_file", file_item);
+
+  return err;
+}
+
+
 /*
  * Setting the signers and the protocol for the context. The protocol
  * to use is derived from the keys.  An errro will be displayed if the
@@ -471,6 +551,31 @@ set_signers (GpaFileSignOperation *op, GList *signers)
 }
 
 
+/* Sign the files of OP with SIGNERS using SIG_MODE.  */
+void
+gpa_file_sign_operation_run (GpaFileSignOperation *op, GList *signers,
+                             gboolean armor, gpgme_sig_mode_t sig_mode)
+{
+  gboolean success;
+
+  g_return_if_fail (GPA_IS_FILE_SIGN_OPERATION (op));
+
+  op->sign_type = sig_mode;
+  /* Set the armor value */
+  gpgme_set_armor (GPA_OPERATION (op)->context->ctx, armor);
+  /* Set the signers for the context */
+  success = set_signers (op, signers);
+  /* Actually run the operation or abort.  */
+  if (success && gpa_file_operation_use_workers (GPA_FILE_OPERATION (op)))
+    gpa_file_operation_run_workers (GPA_FILE_OPERATION (op));
+  else if (success)
+    gpa_file_sign_operation_next (op);
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                           gpg_error (GPG_ERR_GENERAL));
+}
+
+
 /*
  * The key selection dialog has returned.
  */
@@ -485,24 +590,12 @@ gpa_file_sign_operation_response_cb (GtkDialog *dialog,
 
   if (response == GTK_RESPONSE_OK)
     {
-      gboolean success = TRUE;
-      gboolean armor = gpa_file_sign_dialog_get_armor
-	(GPA_FILE_SIGN_DIALOG (op->sign_dialog));
-      GList *signers = gpa_file_sign_dialog_signers
-	(GPA_FILE_SIGN_DIALOG (op->sign_dialog));
-      op->sign_type = gpa_file_sign_dialog_get_sig_mode
-	(GPA_FILE_SIGN_DIALOG (op->sign_dialog));
-
-      /* Set the armor value */
-      gpgme_set_armor (GPA_OPERATION (op)->context->ctx, armor);
-      /* Set the signers for the context */
-      success = set_signers (op, signers);
-      /* Actually run the operation or abort.  */
-      if (success)
-	gpa_file_sign_operation_next (op);
-      else
-	g_signal_emit_by_name (GPA_OPERATION (op), "completed",
-			       gpg_error (GPG_ERR_GENERAL));
+      GpaFileSignDialog *sign_dialog = GPA_FILE_SIGN_DIALOG (op->sign_dialog);
+      GList *signers = gpa_file_sign_dialog_signers (sign_dialog);
+
+      gpa_file_sign_operation_run
+	(op, signers, gpa_file_sign_dialog_get_armor (sign_dialog),
+	 gpa_file_sign_dialog_get_sig_mode (sign_dialog));
 
       g_list_free (signers);
     }
@@ -24,6 +24,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "gpafileop.h"
+#include "membuf.h"
 
 /* GObject stuff */
 #define GPA_FILE_SIGN_OPERATION_TYPE	  (gpa_file_sign_operation_get_type ())
@@ -43,6 +44,8 @@ struct _GpaFileSignOperation {
   GtkWidget *sign_dialog;
   int sig_fd, plain_fd;
   gpgme_data_t sig, plain;
+  /* The output for direct input.  */
+  membuf_t sig_buf;
   gchar *sig_filename;
   gboolean force_armor;
 };
@@ -61,4 +64,9 @@ GpaFileSignOperation*
 gpa_file_sign_operation_new (GtkWidget *window,
 			     GList *files, gboolean force_armor);
 
+/* Start the operation OP with the keys and options chosen in the
+   dialog or, in the batch mode, given on the command line.  */
+void gpa_file_sign_operation_run (GpaFileSignOperation *op, GList *signers,
+                                  gboolean armor, gpgme_sig_mode_t sig_mode);
+
 #endif
@@ -50,6 +50,26 @@ static void gpa_file_verify_operation_done_cb (GpaContext *context,
 static void gpa_file_verify_operation_response_cb (GtkDialog *dialog,
 						   gint response,
 						   gpointer user_data);
+static gpg_error_t gpa_file_verify_operation_start_file
+	(GpaFileOperation *fileop, gpa_file_worker_t worker);
+static gpg_error_t gpa_file_verify_operation_finish_file
+	(GpaFileOperation *fileop, gpa_file_worker_t worker, gpg_error_t err);
+static void gpa_file_verify_operation_add_result (GpaFileOperation *fileop,
+						  gpa_file_item_t file_item,
+						  gpointer result);
+static void gpa_file_verify_operation_files_done (GpaFileOperation *fileop,
+						  gpg_error_t err);
+
+/* The result of a file verified by a worker.  */
+struct verify_result_s
+{
+  /* The files of a detached signature or NULL.  */
+  gchar *signed_file;
+  gchar *signature_file;
+
+  /* The verification result or NULL if it failed.  */
+  gpgme_verify_result_t result;
+};
 
 /* GObject */
 
@@ -60,7 +80,9 @@ gpa_file_verify_operation_finalize (GObject *object)
 {
   GpaFileVerifyOperation *op = GPA_FILE_VERIFY_OPERATION (object);
 
-  gtk_widget_destroy (op->dialog);
+  if (op->dialog)
+    gtk_widget_destroy (op->dialog);
+  g_free (get_membuf (&op->plain_buf, NULL));
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -99,6 +121,9 @@ gpa_file_verify_operation_constructor
 		    G_CALLBACK (gpa_file_verify_operation_done_error_cb), op);
   g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
 		    G_CALLBACK (gpa_file_verify_operation_done_cb), op);
+  if (batch_mode)
+    return object;
+
   /* Give a title to the progress dialog */
   gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
 			_("Verifying..."));
@@ -116,11 +141,17 @@ static void
 gpa_file_verify_operation_class_init (GpaFileVerifyOperationClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GpaFileOperationClass *file_op_class = GPA_FILE_OPERATION_CLASS (klass);
 
   parent_class = g_type_class_peek_parent (klass);
 
   object_class->constructor = gpa_file_verify_operation_constructor;
   object_class->finalize = gpa_file_verify_operation_finalize;
+
+  file_op_class->start_file = gpa_file_verify_operation_start_file;
+  file_op_class->finish_file = gpa_file_verify_operation_finish_file;
+  file_op_class->add_result = gpa_file_verify_operation_add_result;
+  file_op_class->files_done = gpa_file_verify_operation_files_done;
 }
 
 GType
@@ -227,8 +258,9 @@ is_detached_sig (const gchar *filename, gchar **signature_file,
     {
       gchar *sig = g_strconcat (filename, sig_extension[i], NULL);
 
+      /* In the batch mode the signature is used without asking.  */
       if (g_file_test (sig, G_FILE_TEST_EXISTS)
-          && ask_use_detached_sig (filename, sig, window))
+          && (batch_mode || ask_use_detached_sig (filename, sig, window)))
         {
           *signed_file = g_strdup (filename);
           *signature_file = sig;
@@ -259,7 +291,8 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
 	  return FALSE;
 	}
 
-      err = gpgme_data_new (&op->plain);
+      init_membuf (&op->plain_buf, file_item->direct_in_len + 1024);
+      err = membuf_data_new (&op->plain, &op->plain_buf);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -366,26 +399,13 @@ gpa_file_verify_operation_done_cb (GpaContext *context,
   if (file_item->direct_in)
     {
       size_t len;
-      char *plain_gpgme = gpgme_data_release_and_get_mem (op->plain,
-							   &len);
-      op->plain = NULL;
-      /* Do the memory allocation dance.  */
 
-      if (plain_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, plain_gpgme, len);
-	  gpgme_free (plain_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
+      /* gpgme wrote the output directly into the buffer; take it
+	 over as a string.  */
+      gpgme_data_release (op->plain);
+      op->plain = NULL;
+      file_item->direct_out = get_membuf_string (&op->plain_buf, &len);
+      file_item->direct_out_len = file_item->direct_out ? len : 0;
     }
 
   /* Do clean up on the operation */
@@ -401,6 +421,7 @@ gpa_file_verify_operation_done_cb (GpaContext *context,
   op->sig_fd = -1;
 
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+  gpa_file_operation_file_done (GPA_FILE_OPERATION (op), file_item, err);
   /* Check for error */
   if (err)
     {
@@ -442,12 +463,137 @@ gpa_file_verify_operation_done_cb (GpaContext *context,
     }
 }
 
+/* Start verifying the file of WORKER.  This is used instead of
+   gpa_file_verify_operation_start if several files are verified at
+   the same time.  */
+static gpg_error_t
+gpa_file_verify_operation_start_file (GpaFileOperation *fileop,
+                                      gpa_file_worker_t worker)
+{
+  GpaFileVerifyOperation *op = GPA_FILE_VERIFY_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+  gpgme_ctx_t ctx = worker->context->ctx;
+  struct verify_result_s *vres;
+  gpg_error_t err;
+
+  vres = g_malloc0 (sizeof *vres);
+  worker->result = vres;
+
+  if (is_detached_sig (file_item->filename_in, &vres->signature_file,
+                       &vres->signed_file, GPA_OPERATION (op)->window))
+    {
+      worker->in_fd = gpa_open_input (vres->signature_file, &worker->in,
+                                      GPA_OPERATION (op)->window);
+      if (worker->in_fd == -1)
+        return gpg_error (GPG_ERR_GENERAL);
+      worker->extra_fd = gpa_open_input (vres->signed_file, &worker->extra,
+                                         GPA_OPERATION (op)->window);
+      if (worker->extra_fd == -1)
+        return gpg_error (GPG_ERR_GENERAL);
+    }
+  else
+    {
+      worker->in_fd = gpa_open_input (file_item->filename_in, &worker->in,
+                                      GPA_OPERATION (op)->window);
+      if (worker->in_fd == -1)
+        return gpg_error (GPG_ERR_GENERAL);
+      err = gpgme_data_new (&worker->out);
+      if (err)
+        return err;
+    }
+
+  gpgme_set_protocol (ctx, is_cms_file (file_item->filename_in)
+                      ? GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+  err = gpgme_op_verify_start (ctx, worker->in, worker->extra, worker->out);
+  if (err)
+    gpa_gpgme_warning (err);
+  return err;
+}
+
+
+/* Verifying the file of WORKER has finished.  */
+static gpg_error_t
+gpa_file_verify_operation_finish_file (GpaFileOperation *fileop,
+                                       gpa_file_worker_t worker,
+                                       gpg_error_t err)
+{
+  GpaFileVerifyOperation *op = GPA_FILE_VERIFY_OPERATION (fileop);
+  gpa_file_item_t file_item = worker->item->data;
+  struct verify_result_s *vres = worker->result;
+
+  /* The error callback reports the current file.  */
+  fileop->current = worker->item;
+  gpa_file_verify_operation_done_error_cb (worker->context, err, op);
+  if (!err)
+    {
+      /* The result is released by the next operation of the context,
+         thus take a reference for VRES and one for FILE_ITEM.  */
+      vres->result = gpgme_op_verify_result (worker->context->ctx);
+      if (vres->result)
+        {
+          gpgme_result_ref (vres->result);
+          gpgme_result_ref (vres->result);
+          file_item->verify_result = vres->result;
+        }
+    }
+
+  return err;
+}
+
+
+/* Add the RESULT of FILE_ITEM to the result dialog.  */
+static void
+gpa_file_verify_operation_add_result (GpaFileOperation *fileop,
+                                      gpa_file_item_t file_item,
+                                      gpointer result)
+{
+  GpaFileVerifyOperation *op = GPA_FILE_VERIFY_OPERATION (fileop);
+  struct verify_result_s *vres = result;
+
+  if (!vres)
+    return;
+
+  if (vres->result)
+    {
+      if (op->dialog)
+        gpa_file_verify_dialog_add_file (GPA_FILE_VERIFY_DIALOG (op->dialog),
+                                         file_item->filename_in,
+                                         vres->signed_file,
+                                         vres->signature_file,
+                                         vres->result->signatures);
+      gpgme_result_unref (vres->result);
+    }
+  g_free (vres->signed_file);
+  g_free (vres->signature_file);
+  g_free (vres);
+}
+
+
+/* All files have been verified by the workers.  */
+static void
+gpa_file_verify_operation_files_done (GpaFileOperation *fileop,
+                                      gpg_error_t err)
+{
+  GpaFileVerifyOperation *op = GPA_FILE_VERIFY_OPERATION (fileop);
+
+  /* Show the results dialog.  Without it, there is nothing to wait
+     for.  */
+  if (op->dialog)
+    gtk_widget_show_all (op->dialog);
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
 static gboolean
 gpa_file_verify_operation_idle_cb (gpointer data)
 {
   GpaFileVerifyOperation *op = data;
 
-  gpa_file_verify_operation_next (op);
+  if (gpa_file_operation_use_workers (GPA_FILE_OPERATION (op)))
+    gpa_file_operation_run_workers (GPA_FILE_OPERATION (op));
+  else
+    gpa_file_verify_operation_next (op);
 
   return FALSE;
 }
@@ -24,6 +24,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "gpafileop.h"
+#include "membuf.h"
 
 /* GObject stuff */
 #define GPA_FILE_VERIFY_OPERATION_TYPE	  (gpa_file_verify_operation_get_type ())
@@ -41,6 +42,8 @@ struct _GpaFileVerifyOperation {
 
   int sig_fd, signed_text_fd;
   gpgme_data_t sig, signed_text, plain;
+  /* The output for direct input.  */
+  membuf_t plain_buf;
   gchar *signed_file, *signature_file;
   GtkWidget *dialog;
 };
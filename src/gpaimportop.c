@@ -64,6 +64,11 @@ gpa_import_operation_finalize (GObject *object)
       g_free (op->source2);
       op->source2 = NULL;
     }
+  if (op->fprs)
+    {
+      g_ptr_array_free (op->fprs, TRUE);
+      op->fprs = NULL;
+    }
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -73,6 +78,7 @@ gpa_import_operation_init (GpaImportOperation *op)
 {
   op->source = NULL;
   op->source2 = NULL;
+  op->fprs = NULL;
 }
 
 static GObject*
@@ -216,12 +222,21 @@ gpa_import_operation_done_cb (GpaContext *context, gpg_error_t err,
     {
       struct gpa_import_result_s result;
       gpgme_import_result_t res;
+      gpgme_import_status_t imp;
 
       memset (&result, 0, sizeof result);
 
       GPA_IMPORT_OPERATION_GET_CLASS (op)->complete_import (op);
 
       res = gpgme_op_import_result (GPA_OPERATION (op)->context->ctx);
+
+      /* Remember the keys which actually changed so that the key
+         list does not need to reload the entire keyring.  */
+      if (!op->fprs)
+        op->fprs = g_ptr_array_new_with_free_func (g_free);
+      for (imp = res->imports; imp; imp = imp->next)
+        if (imp->fpr && !imp->result && imp->status)
+          g_ptr_array_add (op->fprs, g_strdup (imp->fpr));
       if (res->imported > 0 && res->secret_imported )
 	{
 	  g_signal_emit_by_name (GPA_OPERATION (op), "imported_secret_keys");
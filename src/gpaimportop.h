@@ -43,6 +43,11 @@ struct _GpaImportOperation {
 
   gpgme_data_t source;    /* Either a data object with the full key  */
   gpgme_key_t *source2;   /* or an array of key descriptions.  */
+
+  /* The fingerprints of the keys changed by the import.  This is
+     only valid while the "imported_keys" or "imported_secret_keys"
+     signals are emitted.  */
+  GPtrArray *fprs;
 };
 
 struct _GpaImportOperationClass {
@@ -30,7 +30,7 @@
 #define GPA_KEY_TRUST_OPERATION_TYPE	  (gpa_key_trust_operation_get_type ())
 #define GPA_KEY_TRUST_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_KEY_TRUST_OPERATION_TYPE, GpaKeyTrustOperation))
 #define GPA_KEY_TRUST_OPERATION_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_KEY_TRUST_OPERATION_TYPE, GpaKeyTrustOperationClass))
-#define GPA_IS_KEY_TRUST_ENCRYPT_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEY_TRUST_OPERATION_TYPE))
+#define GPA_IS_KEY_TRUST_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEY_TRUST_OPERATION_TYPE))
 #define GPA_IS_KEY_TRUST_OPERATION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_KEY_TRUST_OPERATION_TYPE))
 #define GPA_KEY_TRUST_OPERATION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_KEY_TRUST_OPERATION_TYPE, GpaKeyTrustOperationClass))
 
@@ -353,27 +353,30 @@ done_cb (GpaContext *context, gpg_error_t err, GpaStreamDecryptOperation *op)
 }
 
 
+/* Run the decryption in a worker thread.  */
+static gpg_error_t
+decrypt_thread (gpgme_ctx_t ctx, void *opaque)
+{
+  GpaStreamDecryptOperation *op = opaque;
+  GpaStreamOperation *sop = GPA_STREAM_OPERATION (op);
+
+  if (op->no_verify)
+    return gpgme_op_decrypt (ctx, sop->input_stream, sop->output_stream);
+  else
+    return gpgme_op_decrypt_verify (ctx, sop->input_stream,
+                                    sop->output_stream);
+}
+
+
 static gboolean
 idle_cb (gpointer data)
 {
   GpaStreamDecryptOperation *op = data;
-  GpaStreamOperation *sop = GPA_STREAM_OPERATION (op);
-  gpgme_error_t err;
 
   gpgme_set_protocol (GPA_OPERATION (op)->context->ctx, op->selected_protocol);
 
-  if (op->no_verify)
-    err = gpgme_op_decrypt_start (GPA_OPERATION (op)->context->ctx,
-				  sop->input_stream, sop->output_stream);
-  else
-    err = gpgme_op_decrypt_verify_start (GPA_OPERATION (op)->context->ctx,
-					 sop->input_stream, sop->output_stream);
-
-  if (err)
-    {
-      gpa_gpgme_warning (err);
-      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
-    }
+  gpa_context_run_in_thread (GPA_OPERATION (op)->context,
+                             decrypt_thread, op);
 
   gtk_widget_show_all (GPA_STREAM_OPERATION (op)->progress_dialog);
 
@@ -316,6 +316,20 @@ keys_match_protocol_p (gpgme_key_t *keys, gpgme_protocol_t protocol)
 }
 
 
+/* Run the encryption in a worker thread.  */
+static gpg_error_t
+encrypt_thread (gpgme_ctx_t ctx, void *opaque)
+{
+  GpaStreamEncryptOperation *op = opaque;
+
+  /* We always trust the keys because the recipient selection
+     dialog has already sorted unusable out.  */
+  return gpgme_op_encrypt (ctx, op->keys, GPGME_ENCRYPT_ALWAYS_TRUST,
+                           GPA_STREAM_OPERATION (op)->input_stream,
+                           GPA_STREAM_OPERATION (op)->output_stream);
+}
+
+
 /*
  * Fire up the encryption.
  */
@@ -366,17 +380,8 @@ start_encryption (GpaStreamEncryptOperation *op)
       gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
                           op->selected_protocol);
 
-      /* We always trust the keys because the recipient selection
-         dialog has already sorted unusable out.  */
-      err = gpgme_op_encrypt_start (GPA_OPERATION (op)->context->ctx,
-                                    op->keys, GPGME_ENCRYPT_ALWAYS_TRUST,
-                                    GPA_STREAM_OPERATION (op)->input_stream,
-                                    GPA_STREAM_OPERATION (op)->output_stream);
-      if (err)
-        {
-          gpa_gpgme_warning (err);
-          goto leave;
-        }
+      gpa_context_run_in_thread (GPA_OPERATION (op)->context,
+                                 encrypt_thread, op);
 
       /* Show and update the progress dialog.  */
       gtk_widget_show_all (GPA_STREAM_OPERATION (op)->progress_dialog);
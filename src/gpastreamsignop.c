@@ -300,6 +300,20 @@ set_signers (GpaStreamSignOperation *op, GList *signers)
 
 
 
+/* Run the signing in a worker thread.  */
+static gpg_error_t
+sign_thread (gpgme_ctx_t ctx, void *opaque)
+{
+  GpaStreamSignOperation *op = opaque;
+
+  return gpgme_op_sign (ctx,
+                        GPA_STREAM_OPERATION (op)->input_stream,
+                        GPA_STREAM_OPERATION (op)->output_stream,
+                        (op->detached? GPGME_SIG_MODE_DETACH
+                         /* */       : GPGME_SIG_MODE_NORMAL));
+}
+
+
 /*
  * Fire up the signing
  */
@@ -345,16 +359,8 @@ start_signing (GpaStreamSignOperation *op)
       else
         gpgme_set_armor (GPA_OPERATION (op)->context->ctx, 1);
 
-      err = gpgme_op_sign_start (GPA_OPERATION (op)->context->ctx,
-                                 GPA_STREAM_OPERATION (op)->input_stream,
-                                 GPA_STREAM_OPERATION (op)->output_stream,
-                                 (op->detached? GPGME_SIG_MODE_DETACH
-                                  /* */       : GPGME_SIG_MODE_NORMAL));
-      if (err)
-        {
-          gpa_gpgme_warning (err);
-          goto leave;
-        }
+      gpa_context_run_in_thread (GPA_OPERATION (op)->context,
+                                 sign_thread, op);
 
       /* Show and update the progress dialog.  */
       gtk_widget_show_all (GPA_STREAM_OPERATION (op)->progress_dialog);
@@ -361,27 +361,28 @@ done_cb (GpaContext *context, gpg_error_t err, GpaStreamVerifyOperation *op)
 }
 
 
+/* Run the verification in a worker thread.  */
+static gpg_error_t
+verify_thread (gpgme_ctx_t ctx, void *opaque)
+{
+  GpaStreamOperation *sop = opaque;
+
+  return gpgme_op_verify (ctx, sop->input_stream, sop->message_stream,
+                          sop->output_stream);
+}
+
+
 static gboolean
 idle_cb (gpointer data)
 {
   GpaStreamVerifyOperation *op = data;
-  GpaStreamOperation *sop = GPA_STREAM_OPERATION (op);
-  gpgme_error_t err;
 
   gpgme_set_protocol (GPA_OPERATION (op)->context->ctx, op->selected_protocol);
 
-  err = gpgme_op_verify_start (GPA_OPERATION (op)->context->ctx,
-			       sop->input_stream, sop->message_stream,
-			       sop->output_stream);
-  if (err)
-    {
-      gpa_gpgme_warning (err);
-      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
-    }
-  else if (! op->silent)
-    {
-      gtk_widget_show_all (GPA_STREAM_OPERATION (op)->progress_dialog);
-    }
+  gpa_context_run_in_thread (GPA_OPERATION (op)->context,
+                             verify_thread, GPA_STREAM_OPERATION (op));
+  if (! op->silent)
+    gtk_widget_show_all (GPA_STREAM_OPERATION (op)->progress_dialog);
 
   return FALSE;
 }
@@ -37,6 +37,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #else
 #include <io.h>
 #endif
@@ -165,6 +166,24 @@ check_overwriting (const char *filename, GtkWidget *parent)
   GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_SAVE;
   char *filename_used = xstrdup (filename);
 
+  if (batch_mode)
+    {
+      /* There is no one to ask.  The file is only replaced once the
+         output is complete; see gpa_output_commit.  */
+      if (!batch_overwrite && g_file_test (filename_used, G_FILE_TEST_EXISTS))
+        {
+          gchar *message;
+
+          message = g_strdup_printf ("%s: %s", filename_used,
+                                     strerror (EEXIST));
+          gpa_window_error (message, parent);
+          g_free (message);
+          xfree (filename_used);
+          return NULL;
+        }
+      return filename_used;
+    }
+
   while (1)
     {
       /* If the file exists, ask before overwriting.  */
@@ -234,33 +253,234 @@ gpa_fopen (const char *filename, GtkWidget *parent, char **filename_used)
 }
 
 
+/* The size of the buffer of an output file.  gpgme writes in small
+   chunks, which is slow on network file systems.  */
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+/* The state of a gpgme data object writing to an output file.  The
+   data is written to a temporary file, which gets its final name by
+   gpa_output_commit.  */
+struct output_sink_s
+{
+  gpgme_data_t data;
+  int fd;
+  gchar *filename;
+  gchar *tmpname;
+
+  char *buffer;
+  gsize used;
+
+  /* The number of bytes written to FD and the number of bytes
+     reserved with fallocate.  */
+  guint64 written;
+  guint64 reserved;
+
+  /* The errno of a failed write.  */
+  int error;
+};
+
+/* The output sinks by their data object.  */
+static GHashTable *output_sinks;
+
+
+/* Write the buffer of SINK to the file.  Returns false on error.  */
+static gboolean
+output_sink_flush (struct output_sink_s *sink)
+{
+  gsize done = 0;
+
+  while (!sink->error && done < sink->used)
+    {
+      gssize n = write (sink->fd, sink->buffer + done, sink->used - done);
+
+      if (n >= 0)
+        done += n;
+      else if (errno != EINTR)
+        sink->error = errno;
+    }
+  sink->written += done;
+  sink->used = 0;
+
+  return !sink->error;
+}
+
+
+static gpgme_ssize_t
+output_sink_write (void *handle, const void *buffer, size_t size)
+{
+  struct output_sink_s *sink = handle;
+
+  if (sink->fd == -1)
+    {
+      errno = EBADF;
+      return -1;
+    }
+  if (sink->used + size > OUTPUT_BUFFER_SIZE && !output_sink_flush (sink))
+    {
+      errno = sink->error;
+      return -1;
+    }
+  if (size > OUTPUT_BUFFER_SIZE - sink->used)
+    size = OUTPUT_BUFFER_SIZE - sink->used;
+  memcpy (sink->buffer + sink->used, buffer, size);
+  sink->used += size;
+
+  return size;
+}
+
+
+/* Release SINK.  If it has not been committed, the temporary file is
+   removed.  */
+static void
+output_sink_release (void *handle)
+{
+  struct output_sink_s *sink = handle;
+
+  if (sink->fd != -1)
+    {
+      close (sink->fd);
+      g_unlink (sink->tmpname);
+    }
+  g_hash_table_remove (output_sinks, sink->data);
+  g_free (sink->buffer);
+  g_free (sink->filename);
+  g_free (sink->tmpname);
+  g_free (sink);
+}
+
+
+static struct gpgme_data_cbs output_sink_cbs =
+  {
+    NULL,
+    output_sink_write,
+    NULL,
+    output_sink_release
+  };
+
+
 int
 gpa_open_output_direct (const char *filename, gpgme_data_t *data,
 			GtkWidget *parent)
 {
+  struct output_sink_s *sink;
   int target = -1;
   gpg_error_t err;
 
-  target = g_open (filename,
-		   O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+  /* Create the file under a temporary name in the same directory so
+     that it can be renamed.  */
+  sink = g_malloc0 (sizeof *sink);
+  sink->filename = g_strdup (filename);
+  sink->tmpname = g_strconcat (filename, ".XXXXXX", NULL);
+  target = g_mkstemp_full (sink->tmpname, O_WRONLY | O_BINARY, 0666);
   if (target == -1)
     {
       gchar *message;
       message = g_strdup_printf ("%s: %s", filename, strerror(errno));
       gpa_window_error (message, parent);
       g_free (message);
+      g_free (sink->filename);
+      g_free (sink->tmpname);
+      g_free (sink);
+      return -1;
     }
-  err = gpgme_data_new_from_fd (data, target);
+  sink->fd = target;
+  sink->buffer = g_malloc (OUTPUT_BUFFER_SIZE);
+
+  err = gpgme_data_new_from_cbs (data, &output_sink_cbs, sink);
   if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
     {
       close (target);
-      target = -1;
+      g_unlink (sink->tmpname);
+      g_free (sink->buffer);
+      g_free (sink->filename);
+      g_free (sink->tmpname);
+      g_free (sink);
+      return -1;
     }
+  sink->data = *data;
+  if (!output_sinks)
+    output_sinks = g_hash_table_new (NULL, NULL);
+  g_hash_table_insert (output_sinks, sink->data, sink);
 
   return target;
 }
 
 
+/* Reserve space for the output file DATA for the input file IN_FD,
+   if that is a regular file.  This is only done where the file system
+   can allocate the blocks without writing them; posix_fallocate would
+   fill the file with zeros elsewhere, which costs as much as the
+   output itself.  */
+void
+gpa_output_reserve (gpgme_data_t data, int in_fd)
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+  struct output_sink_s *sink;
+  struct stat st;
+
+  sink = output_sinks ? g_hash_table_lookup (output_sinks, data) : NULL;
+  if (!sink || sink->fd == -1
+      || fstat (in_fd, &st) || !S_ISREG (st.st_mode) || st.st_size <= 0)
+    return;
+
+  /* The size of the file is not changed, so nothing needs to be
+     undone if the file system does not support this (EOPNOTSUPP).  */
+  if (!fallocate (sink->fd, FALLOC_FL_KEEP_SIZE, 0, st.st_size))
+    sink->reserved = st.st_size;
+#else
+  (void)data;
+  (void)in_fd;
+#endif
+}
+
+
+/* Complete the output file DATA.  The remaining data is written and
+   the file is renamed to its final name.  If this is not called, the
+   file is removed when DATA is released.  Does nothing if DATA has
+   not been created by gpa_open_output.  Note that an existing file
+   is replaced and not rewritten: it does not keep its mode or owner,
+   and a symbolic link is replaced instead of followed.  */
+gpg_error_t
+gpa_output_commit (gpgme_data_t data)
+{
+  struct output_sink_s *sink;
+  int fd;
+
+  sink = output_sinks ? g_hash_table_lookup (output_sinks, data) : NULL;
+  if (!sink || sink->fd == -1)
+    return 0;
+
+  output_sink_flush (sink);
+  /* Release the blocks reserved beyond the end of the data.  */
+  if (!sink->error && sink->reserved > sink->written
+      && ftruncate (sink->fd, sink->written))
+    sink->error = errno;
+#ifdef G_OS_UNIX
+  if (!sink->error && fsync (sink->fd))
+    sink->error = errno;
+#endif
+
+  fd = sink->fd;
+  sink->fd = -1;
+  if (close (fd) && !sink->error)
+    sink->error = errno;
+#ifdef G_OS_WIN32
+  /* Windows does not replace existing files.  */
+  if (!sink->error)
+    g_unlink (sink->filename);
+#endif
+  if (!sink->error && g_rename (sink->tmpname, sink->filename))
+    sink->error = errno;
+
+  if (sink->error)
+    {
+      g_unlink (sink->tmpname);
+      return gpg_error_from_errno (sink->error);
+    }
+  return 0;
+}
+
+
 int
 gpa_open_output (const char *filename, gpgme_data_t *data, GtkWidget *parent,
                  char **filename_used)
@@ -276,6 +496,114 @@ gpa_open_output (const char *filename, gpgme_data_t *data, GtkWidget *parent,
 }
 
 
+/* The state of a gpgme data object reading from a mapped file.  */
+struct mapped_data_s
+{
+  GMappedFile *map;
+  const char *buffer;
+  gsize length;
+  gsize pos;
+};
+
+
+static gpgme_ssize_t
+mapped_data_read (void *handle, void *buffer, size_t size)
+{
+  struct mapped_data_s *mdata = handle;
+
+  if (size > mdata->length - mdata->pos)
+    size = mdata->length - mdata->pos;
+  memcpy (buffer, mdata->buffer + mdata->pos, size);
+  mdata->pos += size;
+
+  return size;
+}
+
+
+static off_t
+mapped_data_seek (void *handle, off_t offset, int whence)
+{
+  struct mapped_data_s *mdata = handle;
+
+  switch (whence)
+    {
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      offset += mdata->pos;
+      break;
+    case SEEK_END:
+      offset += mdata->length;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+    }
+  if (offset < 0 || (gsize) offset > mdata->length)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  mdata->pos = offset;
+
+  return offset;
+}
+
+
+static void
+mapped_data_release (void *handle)
+{
+  struct mapped_data_s *mdata = handle;
+
+  g_mapped_file_unref (mdata->map);
+  g_free (mdata);
+}
+
+
+static struct gpgme_data_cbs mapped_data_cbs =
+  {
+    mapped_data_read,
+    NULL,
+    mapped_data_seek,
+    mapped_data_release
+  };
+
+
+/* Create a new gpgme_data_t in DATA reading from the memory mapped
+   file FD.  Returns an error if the file can't be mapped; for example
+   because it is not a regular file or empty.  */
+static gpg_error_t
+data_new_from_mapped_fd (gpgme_data_t *data, int fd)
+{
+  gpg_error_t err;
+  struct stat st;
+  GMappedFile *map;
+  struct mapped_data_s *mdata;
+
+  if (fstat (fd, &st) || !S_ISREG (st.st_mode) || st.st_size <= 0)
+    return gpg_error (GPG_ERR_NOT_SUPPORTED);
+
+  map = g_mapped_file_new_from_fd (fd, FALSE, NULL);
+  if (!map)
+    return gpg_error (GPG_ERR_NOT_SUPPORTED);
+
+  mdata = g_malloc0 (sizeof *mdata);
+  mdata->map = map;
+  mdata->buffer = g_mapped_file_get_contents (map);
+  mdata->length = g_mapped_file_get_length (map);
+#if defined(HAVE_MADVISE) && defined(MADV_SEQUENTIAL)
+  /* The data is read once from start to end.  */
+  madvise ((void *) mdata->buffer, mdata->length, MADV_SEQUENTIAL);
+#endif
+
+  err = gpgme_data_new_from_cbs (data, &mapped_data_cbs, mdata);
+  if (err)
+    mapped_data_release (mdata);
+
+  return err;
+}
+
+
 int
 gpa_open_input (const char *filename, gpgme_data_t *data, GtkWidget *parent)
 {
@@ -290,7 +618,12 @@ gpa_open_input (const char *filename, gpgme_data_t *data, GtkWidget *parent)
       gpa_window_error (message, parent);
       g_free (message);
     }
-  err = gpgme_data_new_from_fd (data, target);
+  /* Regular files are mapped into memory.  Pipes and special files
+     are read from the file descriptor.  */
+  if (target == -1 || data_new_from_mapped_fd (data, target))
+    err = gpgme_data_new_from_fd (data, target);
+  else
+    err = 0;
   if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
     {
       close (target);
@@ -321,40 +654,6 @@ gpa_gpgme_data_new_from_file (gpgme_data_t *data,
 }
 
 
-/* Write the contents of the gpgme_data_t into the clipboard.  Assumes
-   that the data is ASCII.  Return 0 on success.  */
-int
-dump_data_to_clipboard (gpgme_data_t data, GtkClipboard *clipboard)
-{
-  char buffer[512];
-  int nread;
-  gchar *text = NULL;
-  size_t len = 0;
-
-  nread = gpgme_data_seek (data, 0, SEEK_SET);
-  if (nread == -1)
-    {
-      gpa_window_error (strerror (errno), NULL);
-      return -1;
-    }
-  while ((nread = gpgme_data_read (data, buffer, sizeof (buffer))) > 0)
-    {
-      text = g_realloc (text, len + nread + 1);
-      strncpy (text + len, buffer, nread);
-      len += nread;
-    }
-  if (nread == -1)
-    {
-      gpa_window_error (strerror (errno), NULL);
-      return -1;
-    }
-
-  gtk_clipboard_set_text (clipboard, text, (int)len);
-  g_free (text);
-  return 0;
-}
-
-
 /* Assemble the parameter string for gpgme_op_genkey for GnuPG.  We
    don't need worry about the user ID being UTF-8 as long as we are
    using GTK+2, because all user input is UTF-8 in it.  */
@@ -139,20 +139,28 @@ gpg_error_t gpa_gpgme_data_new_from_file (gpgme_data_t *data,
    filename of the file that is actually open (if FILENAME already
    exists, then the user can choose a different file) is saved in
    *FILENAME_USED.  It must be xfreed.  This is set even if this
-   function returns NULL!  */
+   function returns NULL!  The data is written through a large buffer
+   to a temporary file, which is owned by DATA and must not be closed
+   by the caller.  The file only appears under its name after
+   gpa_output_commit; it is removed if DATA is released before.  */
 int gpa_open_output_direct (const char *filename, gpgme_data_t *data,
 			    GtkWidget *parent);
 int gpa_open_output (const char *filename, gpgme_data_t *data,
 		     GtkWidget *parent, char **filename_used);
 
+/* Reserve space for the output DATA for the input file IN_FD.  */
+void gpa_output_reserve (gpgme_data_t data, int in_fd);
+
+/* Complete the output DATA.  */
+gpg_error_t gpa_output_commit (gpgme_data_t data);
+
 /* Create a new gpgme_data_t from a file for reading, and return the
-   file descriptor for the file.  Always reports all errors to the user.  */
+   file descriptor for the file.  Regular files are read from a memory
+   mapping, which stays valid after the file descriptor is closed.
+   Always reports all errors to the user.  */
 int gpa_open_input (const char *filename, gpgme_data_t *data,
 		    GtkWidget *parent);
 
-/* Write the contents of the gpgme_data_t into the clipboard.  */
-int dump_data_to_clipboard (gpgme_data_t data, GtkClipboard *clipboard);
-
 /* Begin generation of a key with the given parameters.  It prepares
    the parameters required by Gpgme and returns whatever
    gpgme_op_genkey_start returns.  */
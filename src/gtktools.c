@@ -103,6 +103,13 @@ show_gtk_message (GtkWidget *parent, GtkMessageType mtype, GpaContext *ctx,
   char *buffer;
 
   buffer = g_strdup_vprintf (format, arg_ptr);
+  if (batch_mode)
+    {
+      /* There is no display to show the message on.  */
+      g_printerr ("gpa: %s\n", buffer);
+      g_free (buffer);
+      return;
+    }
   dialog = gtk_message_dialog_new (parent? GTK_WINDOW (parent):NULL,
                                    GTK_DIALOG_MODAL,
                                    mtype,
@@ -29,7 +29,9 @@
 #include "gtktools.h"
 #include "keytable.h"
 #include "icons.h"
-#include "format-dn.h"
+#include "keysnapshot.h"
+#include "keylistmodel.h"
+#include "keysearch.h"
 
 
 /* Properties */
@@ -45,37 +47,45 @@ enum
   PROP_ONLY_USABLE_KEYS
 };
 
+/* Signals */
+enum
+{
+  LISTING_DONE,
+  LAST_SIGNAL
+};
+
 /* GObject */
 static GObjectClass *parent_class = NULL;
+static guint signals [LAST_SIGNAL] = { 0 };
 
 
-/* Symbols to access the columns.  */
-typedef enum
+/* The keys matching a search text.  */
+struct keylist_match_s
 {
-  /* These are the displayed columns */
-  GPA_KEYLIST_COLUMN_IMAGE,
-  GPA_KEYLIST_COLUMN_KEYTYPE,
-  GPA_KEYLIST_COLUMN_CREATED,
-  GPA_KEYLIST_COLUMN_EXPIRY,
-  GPA_KEYLIST_COLUMN_OWNERTRUST,
-  GPA_KEYLIST_COLUMN_VALIDITY,
-  GPA_KEYLIST_COLUMN_USERID,
-  /* This column contains the gpgme_key_t */
-  GPA_KEYLIST_COLUMN_KEY,
-  /* These columns are used only internally for sorting */
-  GPA_KEYLIST_COLUMN_HAS_SECRET,
-  GPA_KEYLIST_COLUMN_CREATED_TS,
-  GPA_KEYLIST_COLUMN_EXPIRY_TS,
-  GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
-  GPA_KEYLIST_COLUMN_VALIDITY_VALUE,
-  GPA_KEYLIST_N_COLUMNS
-} GpaKeyListColumn;
-
+  char *text;
+  /* The matching keys of the public keytable or NULL if the keytable
+     is not yet available.  */
+  GHashTable *keys;
+  /* The generation of the keytable the result is based on.  */
+  guint generation;
+};
 
 
 static void add_trustdb_dialog (GpaKeyList * keylist);
+static gboolean load_snapshot (GpaKeyList *keylist);
+static void drop_snapshot_rows (GpaKeyList *keylist);
 static void gpa_keylist_next (gpgme_key_t key, gpointer data);
 static void gpa_keylist_end (gpointer data);
+static void ingest_discard (GpaKeyList *keylist);
+static void release_match (struct keylist_match_s *match);
+static void ingest_flush (GpaKeyList *keylist);
+static gboolean ingest_idle (gpointer data);
+static void add_key_row (GpaKeyList *keylist, gpgme_key_t key);
+static void listing_finished (GpaKeyList *keylist);
+static void start_refresh (GpaKeyList *keylist, char **fprs);
+
+/* The number of keys inserted into the model per idle call.  */
+#define INGEST_CHUNK 500
 
 
 
@@ -164,6 +174,7 @@ gpa_keylist_dispose (GObject *object)
   GpaKeyList *list = GPA_KEYLIST (object);
 
   list->disposed = 1;
+  ingest_discard (list);
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -174,53 +185,66 @@ gpa_keylist_finalize (GObject *object)
 {
   GpaKeyList *list = GPA_KEYLIST (object);
 
-  /* Dereference all keys in the list */
-  g_list_foreach (list->keys, (GFunc) gpgme_key_unref, NULL);
-  g_list_free (list->keys);
-  list->keys = NULL;
   gpa_gpgme_release_keyarray (list->initial_keys);
+  g_strfreev (list->refresh_fprs);
+  list->refresh_fprs = NULL;
+  g_strfreev (list->refresh_queued);
+  list->refresh_queued = NULL;
+  if (list->snapshot_rows)
+    g_hash_table_destroy (list->snapshot_rows);
+  list->snapshot_rows = NULL;
+  g_free (list->filter);
+  list->filter = NULL;
+  release_match (list->filter_match);
+  list->filter_match = NULL;
+  release_match (list->search_match);
+  list->search_match = NULL;
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 
+/* Start listing the public keys once the secret keys are known.  */
+static void
+secret_keys_ready (GpaKeyTable *keytable, gpointer data)
+{
+  GpaKeyList *list = data;
+
+  if (!list->disposed)
+    {
+      list->snapshot_due = TRUE;
+      gpa_keytable_list_keys (gpa_keytable_get_public_instance (),
+                              gpa_keylist_next, gpa_keylist_end, list);
+    }
+  g_object_unref (list);
+}
+
+
 static void
 gpa_keylist_init (GTypeInstance *instance, void *class_ptr)
 {
   GpaKeyList *list = GPA_KEYLIST (instance);
-  GtkListStore *store;
+  GpaKeyListModel *model;
   GtkTreeSelection *selection;
 
   /* Setup the model.  */
-  store = gtk_list_store_new (GPA_KEYLIST_N_COLUMNS,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_POINTER,
-			      G_TYPE_INT,
-			      G_TYPE_ULONG,
-			      G_TYPE_ULONG,
-			      G_TYPE_ULONG,
-			      G_TYPE_LONG);
+  model = gpa_keylist_model_new ();
 
   /* Setup the view.  */
-  gtk_tree_view_set_model (GTK_TREE_VIEW (list), GTK_TREE_MODEL (store));
+  gtk_tree_view_set_model (GTK_TREE_VIEW (list), GTK_TREE_MODEL (model));
+  g_object_unref (model);
   gpa_keylist_set_brief (list);
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
   gtk_tree_selection_set_mode (selection, GTK_SELECTION_MULTIPLE);
 
   /* Load the keyring.  */
-  add_trustdb_dialog (list);
   if (list->initial_keys)
     {
       /* Initialize from the provided list.  */
       int idx;
       gpgme_key_t key;
 
+      add_trustdb_dialog (list);
       for (idx=0; (key = list->initial_keys[idx]); idx++)
         {
           gpgme_key_ref (key);
@@ -230,18 +254,23 @@ gpa_keylist_init (GTypeInstance *instance, void *class_ptr)
     }
   else
     {
+      /* If the keys have not yet been listed, show the keys from the
+         snapshot of the last run until the listing is complete.  We
+         don't need the trustdb dialog in this case.  */
+      if (gpa_keytable_get_public_instance ()->initialized
+          || !load_snapshot (list))
+        add_trustdb_dialog (list);
+
       /* Initialize from the global keytable.
        *
        * We must forcefully load the secret keytable first to
-       * prevent concurrent access to the TOFU database. */
+       * prevent concurrent access to the TOFU database.  The public
+       * keyring is loaded by secret_keys_ready.  */
+      g_object_ref (list);
       gpa_keytable_force_reload (gpa_keytable_get_secret_instance (),
-                                 NULL, (GpaKeyTableEndFunc) g_application_quit,
-                                 NULL);
-      // gtk_main ();
-
-      /* Now we can load the public keyring. */
-      gpa_keytable_list_keys (gpa_keytable_get_public_instance(),
-                              gpa_keylist_next, gpa_keylist_end, list);
+                                 NULL, NULL, NULL);
+      gpa_keytable_when_ready (gpa_keytable_get_secret_instance (),
+                               secret_keys_ready, list);
     }
 
 }
@@ -308,7 +337,15 @@ gpa_keylist_class_init (void *class_ptr, void *class_data)
       FALSE,
       G_PARAM_WRITABLE|G_PARAM_CONSTRUCT_ONLY));
 
-
+  /* Signals */
+  signals[LISTING_DONE] =
+    g_signal_new ("listing_done",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_FIRST,
+		  G_STRUCT_OFFSET (GpaKeyListClass, listing_done),
+		  NULL, NULL,
+		  g_cclosure_marshal_VOID__VOID,
+		  G_TYPE_NONE, 0);
 }
 
 
@@ -413,6 +450,165 @@ get_key_pixbuf (gpgme_key_t key)
 
 
 
+/* Paint the keys from the snapshot of the last run.  The rows don't
+   have a key; thus selecting them is disabled until they are replaced
+   by the actual keys.  Returns FALSE if there is no usable
+   snapshot.  */
+static gboolean
+load_snapshot (GpaKeyList *list)
+{
+  gpa_key_snapshot_t snapshot;
+  GpaKeyListModel *model;
+  unsigned int idx, n;
+
+  snapshot = gpa_key_snapshot_open ();
+  n = gpa_key_snapshot_count (snapshot);
+  if (!n)
+    {
+      gpa_key_snapshot_close (snapshot);
+      return FALSE;
+    }
+
+  model = GPA_KEYLIST_MODEL (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
+  list->snapshot_rows = g_hash_table_new_full
+    (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+
+  for (idx = 0; idx < n; idx++)
+    {
+      struct gpa_key_snapshot_entry_s entry;
+      GtkTreeIter iter;
+
+      gpa_key_snapshot_get (snapshot, idx, &entry);
+      if (!entry.fpr)
+        continue;
+
+      gpa_keylist_model_append_snapshot (model, &entry, &iter);
+      g_hash_table_replace (list->snapshot_rows, g_strdup (entry.fpr),
+                            gtk_tree_iter_copy (&iter));
+    }
+  gpa_key_snapshot_close (snapshot);
+
+  gtk_tree_selection_set_mode
+    (gtk_tree_view_get_selection (GTK_TREE_VIEW (list)), GTK_SELECTION_NONE);
+
+  return TRUE;
+}
+
+
+/* If there is a snapshot row for the key with fingerprint FPR, store
+   its iter at R_ITER, forget about the row and return TRUE.  */
+static gboolean
+take_snapshot_row (GpaKeyList *list, const char *fpr, GtkTreeIter *r_iter)
+{
+  GtkTreeIter *iter;
+
+  if (!list->snapshot_rows || !fpr)
+    return FALSE;
+  iter = g_hash_table_lookup (list->snapshot_rows, fpr);
+  if (!iter)
+    return FALSE;
+  *r_iter = *iter;
+  g_hash_table_remove (list->snapshot_rows, fpr);
+  return TRUE;
+}
+
+
+/* Remove the remaining snapshot rows; their keys do not exist
+   anymore.  Then allow selections again.  */
+static void
+drop_snapshot_rows (GpaKeyList *list)
+{
+  GpaKeyListModel *model;
+  GHashTableIter hiter;
+  gpointer value;
+
+  model = GPA_KEYLIST_MODEL (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
+  g_hash_table_iter_init (&hiter, list->snapshot_rows);
+  while (g_hash_table_iter_next (&hiter, NULL, &value))
+    gpa_keylist_model_remove (model, (GtkTreeIter *) value);
+  g_hash_table_destroy (list->snapshot_rows);
+  list->snapshot_rows = NULL;
+
+  gtk_tree_selection_set_mode
+    (gtk_tree_view_get_selection (GTK_TREE_VIEW (list)),
+     GTK_SELECTION_MULTIPLE);
+}
+
+
+/* Write the display fields of all keys to the snapshot file.  */
+static void
+write_snapshot (GpaKeyList *list)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (list));
+  GArray *entries;
+  GPtrArray *strings;
+  GtkTreeIter iter;
+  gboolean valid;
+
+  entries = g_array_new (FALSE, TRUE,
+                         sizeof (struct gpa_key_snapshot_entry_s));
+  strings = g_ptr_array_new_with_free_func (g_free);
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      struct gpa_key_snapshot_entry_s entry;
+      char *icon, *keytype, *created, *expiry, *ownertrust, *validity;
+      char *userid;
+      gpgme_key_t key;
+      gint has_secret;
+      gulong created_ts, expiry_ts, ownertrust_value;
+      glong validity_value;
+
+      gtk_tree_model_get (model, &iter,
+                          GPA_KEYLIST_COLUMN_IMAGE, &icon,
+                          GPA_KEYLIST_COLUMN_KEYTYPE, &keytype,
+                          GPA_KEYLIST_COLUMN_CREATED, &created,
+                          GPA_KEYLIST_COLUMN_EXPIRY, &expiry,
+                          GPA_KEYLIST_COLUMN_OWNERTRUST, &ownertrust,
+                          GPA_KEYLIST_COLUMN_VALIDITY, &validity,
+                          GPA_KEYLIST_COLUMN_USERID, &userid,
+                          GPA_KEYLIST_COLUMN_KEY, &key,
+                          GPA_KEYLIST_COLUMN_HAS_SECRET, &has_secret,
+                          GPA_KEYLIST_COLUMN_CREATED_TS, &created_ts,
+                          GPA_KEYLIST_COLUMN_EXPIRY_TS, &expiry_ts,
+                          GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
+                          &ownertrust_value,
+                          GPA_KEYLIST_COLUMN_VALIDITY_VALUE, &validity_value,
+                          -1);
+      g_ptr_array_add (strings, icon);
+      g_ptr_array_add (strings, keytype);
+      g_ptr_array_add (strings, created);
+      g_ptr_array_add (strings, expiry);
+      g_ptr_array_add (strings, ownertrust);
+      g_ptr_array_add (strings, validity);
+      g_ptr_array_add (strings, userid);
+      if (!key || !key->subkeys)
+        continue;
+
+      entry.fpr = key->subkeys->fpr;
+      entry.icon = icon;
+      entry.keytype = keytype;
+      entry.created = created;
+      entry.expiry = expiry;
+      entry.ownertrust = ownertrust;
+      entry.validity = validity;
+      entry.userid = userid;
+      entry.has_secret = has_secret;
+      entry.created_ts = created_ts;
+      entry.expiry_ts = expiry_ts;
+      entry.ownertrust_value = ownertrust_value;
+      entry.validity_value = validity_value;
+      g_array_append_val (entries, entry);
+    }
+
+  gpa_key_snapshot_write ((struct gpa_key_snapshot_entry_s *) entries->data,
+                          entries->len);
+  g_array_free (entries, TRUE);
+  g_ptr_array_free (strings, TRUE);
+}
+
+
 /* For keys, gpg can't cope with, the fingerprint is set to all
    zero. This helper function returns true for such a FPR. */
 static int
@@ -425,18 +621,134 @@ is_zero_fpr (const char *fpr)
 }
 
 
+/* While keys are inserted in bulk, keep the model unsorted so that
+   each insertion does not require a re-sort.  */
+static void
+suspend_sorting (GpaKeyList *list)
+{
+  GtkTreeSortable *sortable = GTK_TREE_SORTABLE
+    (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
+
+  if (list->sort_suspended)
+    return;
+  if (!gtk_tree_sortable_get_sort_column_id (sortable,
+                                             &list->saved_sort_column,
+                                             &list->saved_sort_order))
+    return;  /* Not sorted.  */
+  gtk_tree_sortable_set_sort_column_id
+    (sortable, GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+     list->saved_sort_order);
+  list->sort_suspended = TRUE;
+}
+
+
+static void
+resume_sorting (GpaKeyList *list)
+{
+  GtkTreeSortable *sortable = GTK_TREE_SORTABLE
+    (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
+  gint column;
+  GtkSortType order;
+
+  if (!list->sort_suspended)
+    return;
+  list->sort_suspended = FALSE;
+  /* Do not override a sort order the user selected meanwhile.  */
+  gtk_tree_sortable_get_sort_column_id (sortable, &column, &order);
+  if (column == GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID)
+    gtk_tree_sortable_set_sort_column_id (sortable, list->saved_sort_column,
+                                          list->saved_sort_order);
+}
+
+
+/* Insert up to LIMIT queued keys into the model; a LIMIT of 0 inserts
+   all of them.  Returns TRUE if keys are left.  */
+static gboolean
+ingest_keys (GpaKeyList *list, guint limit)
+{
+  guint end;
+
+  if (!list->ingest)
+    return FALSE;
+
+  end = list->ingest->len;
+  if (limit && end - list->ingest_pos > limit)
+    end = list->ingest_pos + limit;
+  while (list->ingest_pos < end)
+    add_key_row (list, g_ptr_array_index (list->ingest, list->ingest_pos++));
+
+  if (list->ingest_pos < list->ingest->len)
+    return TRUE;
+  g_ptr_array_set_size (list->ingest, 0);
+  list->ingest_pos = 0;
+  return FALSE;
+}
+
+
+/* Insert all queued keys now and finish a pending listing.  */
+static void
+ingest_flush (GpaKeyList *list)
+{
+  if (!list->ingest_id)
+    return;
+  g_source_remove (list->ingest_id);
+  list->ingest_id = 0;
+  ingest_keys (list, 0);
+  resume_sorting (list);
+  if (list->ingest_end)
+    {
+      list->ingest_end = FALSE;
+      listing_finished (list);
+    }
+}
+
+
+static gboolean
+ingest_idle (gpointer data)
+{
+  GpaKeyList *list = data;
+
+  if (ingest_keys (list, INGEST_CHUNK))
+    return TRUE;
+
+  list->ingest_id = 0;
+  resume_sorting (list);
+  if (list->ingest_end)
+    {
+      list->ingest_end = FALSE;
+      listing_finished (list);
+    }
+  return FALSE;
+}
+
+
+/* Drop all queued keys.  */
+static void
+ingest_discard (GpaKeyList *list)
+{
+  if (list->ingest_id)
+    {
+      g_source_remove (list->ingest_id);
+      list->ingest_id = 0;
+    }
+  if (list->ingest)
+    {
+      while (list->ingest_pos < list->ingest->len)
+        gpgme_key_unref (g_ptr_array_index (list->ingest,
+                                            list->ingest_pos++));
+      g_ptr_array_free (list->ingest, TRUE);
+      list->ingest = NULL;
+    }
+  list->ingest_pos = 0;
+  list->ingest_end = FALSE;
+}
+
+
 /* Note that this function takes ownership of KEY.  */
 static void
 gpa_keylist_next (gpgme_key_t key, gpointer data)
 {
   GpaKeyList *list = data;
-  GtkListStore *store;
-  GtkTreeIter iter;
-  const gchar *ownertrust, *validity;
-  gchar *userid, *created, *expiry;
-  gboolean has_secret;
-  long int val_value;
-  const char *keytype;
 
   /* Remove the dialog if it is being displayed */
   remove_trustdb_dialog (list);
@@ -474,71 +786,48 @@ gpa_keylist_next (gpgme_key_t key, gpointer data)
       return;
     }
 
-  /* Append the key to the list.  */
-  list->keys = g_list_append (list->keys, key);
-  store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
-  /* Get the column values */
-  keytype = (key->protocol == GPGME_PROTOCOL_OpenPGP? "P" :
-             key->protocol == GPGME_PROTOCOL_CMS? "X" : "?");
-  created = gpa_creation_date_string (key->subkeys->timestamp);
-  expiry = gpa_expiry_date_string (key->subkeys->expires);
-  ownertrust = gpa_key_ownertrust_string (key);
-  validity = gpa_key_validity_string (key);
-  if (key->protocol == GPGME_PROTOCOL_CMS)
-    userid = gpa_format_dn (key->uids? key->uids->uid : NULL);
-  else
-    userid = gpa_gpgme_key_get_userid (key->uids);
+  /* Queue the key; it is inserted into the model from an idle
+     handler.  */
+  if (!list->ingest)
+    list->ingest = g_ptr_array_new ();
+  g_ptr_array_add (list->ingest, key);
+  if (!list->ingest_id)
+    {
+      suspend_sorting (list);
+      list->ingest_id = g_idle_add (ingest_idle, list);
+    }
+}
+
+
+/* Insert KEY into the model of LIST.  Takes ownership of KEY.  */
+static void
+add_key_row (GpaKeyList *list, gpgme_key_t key)
+{
+  GpaKeyListModel *model;
+  GtkTreeIter iter;
+  gboolean has_secret;
+  const char *icon;
+
+  model = GPA_KEYLIST_MODEL (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
   if (list->public_only)
-    has_secret = 0;
+    {
+      has_secret = 0;
+      icon = NULL;
+    }
   else
-    has_secret = (!is_zero_fpr (key->subkeys->fpr)
-                  && gpa_keytable_lookup_key
-                  (gpa_keytable_get_secret_instance(), key->subkeys->fpr));
-
-  /* Append the key to the list */
-  gtk_list_store_append (store, &iter);
-
-  /* Set an appropiate value for sorting revoked and expired keys. This
-   * includes a hack for forcing a value to a range outside the
-   * usual validity values */
-  if (key->subkeys->revoked)
-      val_value = GPGME_VALIDITY_UNKNOWN-2;
-  else if (key->subkeys->expired)
-      val_value = GPGME_VALIDITY_UNKNOWN-1;
-  else if (key->uids)
-      val_value = key->uids->validity;
+    {
+      has_secret = (!is_zero_fpr (key->subkeys->fpr)
+                    && gpa_keytable_lookup_key
+                    (gpa_keytable_get_secret_instance(), key->subkeys->fpr));
+      icon = get_key_pixbuf (key);
+    }
+
+  /* Append the key to the list or replace its row from the snapshot.
+     The display strings are formatted by the model on demand.  */
+  if (take_snapshot_row (list, key->subkeys->fpr, &iter))
+    gpa_keylist_model_set_key (model, &iter, key, has_secret, icon);
   else
-      val_value = GPGME_VALIDITY_UNKNOWN;
-
-  gtk_list_store_set (store, &iter,
-		      GPA_KEYLIST_COLUMN_KEYTYPE, keytype,
-		      GPA_KEYLIST_COLUMN_CREATED, created,
-		      GPA_KEYLIST_COLUMN_EXPIRY, expiry,
-		      GPA_KEYLIST_COLUMN_OWNERTRUST, ownertrust,
-		      GPA_KEYLIST_COLUMN_VALIDITY, validity,
-		      GPA_KEYLIST_COLUMN_USERID, userid,
-		      GPA_KEYLIST_COLUMN_KEY, key,
-		      GPA_KEYLIST_COLUMN_HAS_SECRET, has_secret,
-		      GPA_KEYLIST_COLUMN_CREATED_TS, key->subkeys->timestamp,
-
-		      /* Set "no expiration" to a large value for sorting */
-		      GPA_KEYLIST_COLUMN_EXPIRY_TS,
-		      key->subkeys->expires ?
-		      key->subkeys->expires : G_MAXULONG,
-
-		      GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
-		      key->owner_trust,
-		      /* Set revoked and expired keys to "never trust"
-		         for sorting.  */
-		      GPA_KEYLIST_COLUMN_VALIDITY_VALUE, val_value,
-                      /* Store the image only if enabled.  */
-		      list->public_only ? -1 : GPA_KEYLIST_COLUMN_IMAGE,
-                      list->public_only ? NULL : get_key_pixbuf (key),
-		      -1);
-  /* Clean up */
-  g_free (userid);
-  g_free (created);
-  g_free (expiry);
+    gpa_keylist_model_append (model, key, has_secret, icon, NULL);
 }
 
 
@@ -548,6 +837,43 @@ gpa_keylist_end (gpointer data)
   GpaKeyList *list = data;
 
   remove_trustdb_dialog (list);
+  if (list->disposed)
+    return;
+
+  /* Finish the listing after the queued keys have been inserted.  */
+  if (list->ingest_id)
+    list->ingest_end = TRUE;
+  else
+    listing_finished (list);
+}
+
+
+/* Called after all keys of a listing have been inserted.  */
+static void
+listing_finished (GpaKeyList *list)
+{
+  GpaKeyTable *keytable = gpa_keytable_get_public_instance ();
+
+  if (list->snapshot_rows)
+    drop_snapshot_rows (list);
+
+  /* Save the display fields for the next start but only after a
+     listing of the entire keyring, if we show all keys and the
+     listing was successful.  Keys hidden by the filter are not in
+     the view.  Refreshes of single keys do not update the snapshot;
+     the next full listing catches up.  */
+  if (list->snapshot_due)
+    {
+      list->snapshot_due = FALSE;
+      if (!list->public_only && list->protocol == GPGME_PROTOCOL_UNKNOWN
+          && !list->requested_usage && !list->only_usable_keys
+          && !list->initial_keys && !list->filter
+          && keytable->initialized
+          && !keytable->pgp_err && !keytable->cms_err)
+        write_snapshot (list);
+    }
+
+  g_signal_emit (list, signals[LISTING_DONE], 0);
 }
 
 
@@ -565,18 +891,95 @@ gpa_keylist_clear_columns (GpaKeyList *keylist)
 }
 
 
-gboolean
+static void
+release_match (struct keylist_match_s *match)
+{
+  if (!match)
+    return;
+  g_free (match->text);
+  if (match->keys)
+    g_hash_table_unref (match->keys);
+  g_free (match);
+}
+
+
+/* Return the search result for TEXT cached at SLOT, updating it if
+   needed.  A result made before the keytable was loaded has no keys
+   and is redone once it is loaded, so that the index is used.  */
+static struct keylist_match_s *
+get_match (struct keylist_match_s **slot, const char *text)
+{
+  GpaKeyTable *keytable = gpa_keytable_get_public_instance ();
+  struct keylist_match_s *match = *slot;
+
+  if (match && !strcmp (match->text, text)
+      && (match->keys
+          ? match->generation == keytable->generation
+          : !keytable->initialized))
+    return match;
+
+  release_match (match);
+  match = g_malloc0 (sizeof *match);
+  match->text = g_strdup (text);
+  match->keys = gpa_keytable_search (keytable, text);
+  if (match->keys)
+    match->generation = keytable->generation;
+  *slot = match;
+  return match;
+}
+
+
+/* Return true if KEY matches MATCH.  */
+static gboolean
+key_matches (struct keylist_match_s *match, gpgme_key_t key)
+{
+  if (match->keys)
+    {
+      if (g_hash_table_contains (match->keys, key))
+        return TRUE;
+      /* Keys of the keytable are covered by the index.  */
+      if (key->subkeys
+          && (gpa_keytable_lookup_key (gpa_keytable_get_public_instance (),
+                                       key->subkeys->fpr) == key))
+        return FALSE;
+    }
+
+  return gpa_key_search_match_key (key, match->text);
+}
+
+
+static gboolean
+filter_visible (gpgme_key_t key, gpointer data)
+{
+  GpaKeyList *list = data;
+
+  return key_matches (get_match (&list->filter_match, list->filter), key);
+}
+
+
+/* Interactive search.  Note that this returns FALSE for a match.  */
+static gboolean
 search_keylist_function (GtkTreeModel *model, gint column,
                          const gchar *key_to_search_for, GtkTreeIter *iter,
                          gpointer search_data)
 {
+  GpaKeyList *list = search_data;
   gboolean result = TRUE;
+  gpgme_key_t key;
   gchar *user_id;
   gint search_len;
   const char *s;
 
+  key = gpa_keylist_model_get_key (GPA_KEYLIST_MODEL (model), iter);
+  if (key)
+    return !key_matches (get_match (&list->search_match, key_to_search_for),
+                         key);
+
+  /* A row from the snapshot; look at the displayed user ID.  */
   gtk_tree_model_get (model, iter,
                       GPA_KEYLIST_COLUMN_USERID, &user_id, -1);
+  if (!user_id)
+    return TRUE;
 
   search_len = strlen (key_to_search_for);
 
@@ -693,7 +1096,8 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
 
   gtk_tree_view_set_enable_search (GTK_TREE_VIEW(keylist), TRUE);
   gtk_tree_view_set_search_equal_func (GTK_TREE_VIEW(keylist),
-                                       search_keylist_function, NULL, NULL);
+                                       search_keylist_function, keylist,
+                                       NULL);
 }
 
 
@@ -890,6 +1294,75 @@ gpa_keylist_get_selected_key (GpaKeyList *keylist)
 }
 
 
+/* Return a GList with the keys of up to COUNT rows above and below
+   the selected row, nearest first.  Returns NULL unless exactly one
+   row is selected.  No references are provided.  */
+GList *
+gpa_keylist_get_adjacent_keys (GpaKeyList *keylist, int count)
+{
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  GList *list, *keys = NULL;
+  gint pos, n_rows, i, d;
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
+  if (gtk_tree_selection_count_selected_rows (selection) != 1)
+    return NULL;
+
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (keylist));
+  list = gtk_tree_selection_get_selected_rows (selection, &model);
+  if (!list)
+    return NULL;
+  pos = gtk_tree_path_get_indices (list->data)[0];
+  g_list_foreach (list, (GFunc) gtk_tree_path_free, NULL);
+  g_list_free (list);
+
+  n_rows = gtk_tree_model_iter_n_children (model, NULL);
+  for (d = 1; d <= count; d++)
+    for (i = pos + d; i >= pos - d; i -= 2 * d)
+      {
+        GtkTreeIter iter;
+        gpgme_key_t key;
+
+        if (i < 0 || i >= n_rows
+            || !gtk_tree_model_iter_nth_child (model, &iter, NULL, i))
+          continue;
+        key = gpa_keylist_model_get_key (GPA_KEYLIST_MODEL (model), &iter);
+        if (key)
+          keys = g_list_prepend (keys, key);
+      }
+
+  return g_list_reverse (keys);
+}
+
+
+/* Show only keys whose user IDs, mail addresses, key IDs or
+   fingerprints contain TEXT.  A TEXT of NULL or "" shows all keys.  */
+void
+gpa_keylist_set_filter (GpaKeyList *keylist, const char *text)
+{
+  GtkTreeModel *model;
+
+  if (text && !*text)
+    text = NULL;
+  if (!g_strcmp0 (text, keylist->filter))
+    return;
+  g_free (keylist->filter);
+  keylist->filter = g_strdup (text);
+
+  /* Detach the model so that the view does not need to process a
+     signal for each row.  */
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (keylist));
+  g_object_ref (model);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (keylist), NULL);
+  gpa_keylist_model_set_filter (GPA_KEYLIST_MODEL (model),
+                                keylist->filter? filter_visible : NULL,
+                                keylist);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (keylist), model);
+  g_object_unref (model);
+}
+
+
 /* Begin a reload of the keyring. */
 void
 gpa_keylist_start_reload (GpaKeyList * keylist)
@@ -897,37 +1370,203 @@ gpa_keylist_start_reload (GpaKeyList * keylist)
   GtkTreeSelection *selection =
     gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
   gtk_tree_selection_unselect_all (selection);
-  gtk_list_store_clear (GTK_LIST_STORE (gtk_tree_view_get_model
-					(GTK_TREE_VIEW (keylist))));
-  g_list_foreach (keylist->keys, (GFunc) gpgme_key_unref, NULL);
-  g_list_free (keylist->keys);
-  keylist->keys = NULL;
+  ingest_discard (keylist);
+  resume_sorting (keylist);
+  if (keylist->snapshot_rows)
+    drop_snapshot_rows (keylist);
+  gpa_keylist_model_clear (GPA_KEYLIST_MODEL (gtk_tree_view_get_model
+                                              (GTK_TREE_VIEW (keylist))));
+  /* Pending incremental refreshes are not needed anymore.  A refresh
+     listing the secret keys finishes without effect; one listing the
+     public keys is replaced by the reload.  */
+  g_strfreev (keylist->refresh_fprs);
+  keylist->refresh_fprs = NULL;
+  g_strfreev (keylist->refresh_queued);
+  keylist->refresh_queued = NULL;
+  if (keylist->refresh_state == 2)
+    keylist->refresh_state = 0;
   add_trustdb_dialog (keylist);
 
+  keylist->snapshot_due = TRUE;
   gpa_keytable_force_reload (gpa_keytable_get_public_instance (),
 			     gpa_keylist_next, gpa_keylist_end, keylist);
 }
 
 
+/* Remove all rows showing one of the keys with the fingerprints
+   FPRS from KEYLIST.  */
+static void
+remove_keys (GpaKeyList *keylist, char **fprs)
+{
+  GHashTable *fprset;
+  int idx;
+
+  /* Old versions of the keys might still be queued.  */
+  ingest_flush (keylist);
+
+  fprset = g_hash_table_new (g_str_hash, g_str_equal);
+  for (idx = 0; fprs[idx]; idx++)
+    g_hash_table_add (fprset, fprs[idx]);
+
+  gpa_keylist_model_remove_keys
+    (GPA_KEYLIST_MODEL (gtk_tree_view_get_model (GTK_TREE_VIEW (keylist))),
+     fprset);
+
+  g_hash_table_destroy (fprset);
+}
+
+
+/* Start the refresh queued while the last one was running.  */
+static void
+refresh_queued_keys (GpaKeyList *keylist)
+{
+  char **fprs = keylist->refresh_queued;
+
+  keylist->refresh_queued = NULL;
+  if (fprs && !keylist->disposed)
+    start_refresh (keylist, fprs);
+  else
+    g_strfreev (fprs);
+}
+
+
+/* Called after the public keys of a refresh have been listed.  */
+static void
+refresh_public_done (gpointer data)
+{
+  GpaKeyList *keylist = data;
+
+  gpa_keylist_end (keylist);
+  keylist->refresh_state = 0;
+  refresh_queued_keys (keylist);
+}
+
+
+/* Called after the secret keytable has been refreshed.  Now replace
+   the rows of the refreshed keys.  */
+static void
+refresh_secret_done (gpointer data)
+{
+  GpaKeyList *keylist = data;
+  char **fprs = keylist->refresh_fprs;
+
+  keylist->refresh_fprs = NULL;
+  if (!keylist->disposed && fprs)
+    {
+      remove_keys (keylist, fprs);
+      keylist->refresh_state = 2;
+      gpa_keytable_refresh_keys (gpa_keytable_get_public_instance (),
+                                 (const char **) fprs,
+                                 gpa_keylist_next, refresh_public_done,
+                                 keylist);
+    }
+  else
+    {
+      /* The refresh has been superseded by a reload.  */
+      keylist->refresh_state = 0;
+      refresh_queued_keys (keylist);
+    }
+  g_strfreev (fprs);
+  g_object_unref (keylist);
+}
+
+
+/* Refresh the keys with the fingerprints FPRS, which are taken over
+   by this function.  */
+static void
+start_refresh (GpaKeyList *keylist, char **fprs)
+{
+  keylist->refresh_fprs = fprs;
+  keylist->refresh_state = 1;
+  add_trustdb_dialog (keylist);
+  /* The secret keytable needs to be up-to-date before we show the
+     public keys so that the key icons are correct.  */
+  g_object_ref (keylist);
+  gpa_keytable_refresh_keys (gpa_keytable_get_secret_instance (),
+                             (const char **) fprs,
+                             NULL, refresh_secret_done, keylist);
+}
+
+
+/* Reload only the keys with the fingerprints given by the NULL
+   terminated array FPRS.  Rows of keys which are not anymore
+   available are removed.  */
+void
+gpa_keylist_refresh_keys (GpaKeyList *keylist, const char **fprs)
+{
+  g_return_if_fail (fprs && *fprs);
+
+  if (keylist->refresh_state)
+    {
+      /* A refresh is already running; the keytables can only run one
+         listing at a time.  Queue the fingerprints for another
+         refresh once it has finished.  */
+      char **merged;
+      int n1, n2, idx;
+
+      n1 = keylist->refresh_queued? g_strv_length (keylist->refresh_queued):0;
+      n2 = g_strv_length ((char **) fprs);
+      merged = g_new (char *, n1 + n2 + 1);
+      for (idx = 0; idx < n1; idx++)
+        merged[idx] = keylist->refresh_queued[idx];
+      for (idx = 0; idx < n2; idx++)
+        merged[n1 + idx] = g_strdup (fprs[idx]);
+      merged[n1 + n2] = NULL;
+      g_free (keylist->refresh_queued);
+      keylist->refresh_queued = merged;
+      return;
+    }
+
+  start_refresh (keylist, g_strdupv ((char **) fprs));
+}
+
+
+/* Helper for gpa_keylist_new_key.  */
+struct new_key_parm_s
+{
+  GpaKeyList *keylist;
+  char *fpr;
+};
+
+
+/* Load the new public key once the secret key has been loaded.  */
+static void
+new_key_secret_done (gpointer data)
+{
+  struct new_key_parm_s *parm = data;
+  GpaKeyList *keylist = parm->keylist;
+
+  remove_trustdb_dialog (keylist);
+  if (!keylist->disposed)
+    {
+      /* The trustdb seems not to be updated for a --list-secret, so
+       * we display the dialog both times, just in case */
+      add_trustdb_dialog (keylist);
+      gpa_keytable_load_new (gpa_keytable_get_public_instance (), parm->fpr,
+                             gpa_keylist_next, gpa_keylist_end, keylist);
+    }
+  g_object_unref (keylist);
+  g_free (parm->fpr);
+  g_free (parm);
+}
+
+
 /* Let the keylist know that a new key with the given fingerprint is
    available.  */
 void
 gpa_keylist_new_key (GpaKeyList * keylist, const char *fpr)
 {
+  struct new_key_parm_s *parm;
+
   /* FIXME: I don't understand the code.  Investigate this and
      implement public_only.  */
 
   add_trustdb_dialog (keylist);
+  parm = g_malloc (sizeof *parm);
+  parm->keylist = g_object_ref (keylist);
+  parm->fpr = g_strdup (fpr);
   gpa_keytable_load_new (gpa_keytable_get_secret_instance (), fpr,
-			 NULL, (GpaKeyTableEndFunc) g_application_quit, NULL);
-  /* Hack. Turn the asynchronous listing into a synchronous one */
-  gtk_main ();
-  remove_trustdb_dialog (keylist);
-  /* The trustdb seems not to be updated for a --list-secret, so we
-   * cdisplay the dialog both times, just in case */
-  add_trustdb_dialog (keylist);
-  gpa_keytable_load_new (gpa_keytable_get_public_instance (), fpr,
-			 gpa_keylist_next, gpa_keylist_end, keylist);
+			 NULL, new_key_secret_done, parm);
 }
 
 
@@ -938,10 +1577,7 @@ gpa_keylist_imported_secret_key (GpaKeyList *keylist)
   /* KEYLIST is currently not used. */
 
   gpa_keytable_load_new (gpa_keytable_get_secret_instance (), NULL,
-			 NULL, (GpaKeyTableEndFunc) g_application_quit, NULL);
-  /* Hack. Turn the asynchronous listing into a synchronous one */
-  /* FIXME:  Does that work well with the server shutdown code? */
-  // gtk_main ();
+			 NULL, NULL, NULL);
 }
 
 
@@ -40,8 +40,6 @@ struct _GpaKeyList {
   gboolean secret;
   /* Parent window for dialogs */
   GtkWidget *window;
-  /* Keys loaded into the model */
-  GList *keys;
   /* Dialog for warning about a trustdb rebuilding */
   GtkWidget *dialog;
   /* ID of the timeout that displays the dialog */
@@ -55,6 +53,37 @@ struct _GpaKeyList {
   const char *initial_pattern;
   int requested_usage;
   gboolean only_usable_keys;
+  /* Fingerprints of the running incremental refresh, the
+     fingerprints to refresh once it has finished and its state: 0
+     if none is running, 1 while the secret keys and 2 while the
+     public keys are listed.  */
+  char **refresh_fprs;
+  char **refresh_queued;
+  int refresh_state;
+  /* Rows painted from the on-disk snapshot which have not yet been
+     replaced by the real keys.  Maps fingerprints to GtkTreeIters.  */
+  GHashTable *snapshot_rows;
+  /* True if the running listing covers the entire keyring and is to
+     be saved as the snapshot for the next start.  */
+  gboolean snapshot_due;
+  /* The text the list is filtered by or NULL.  */
+  char *filter;
+  /* Cached search results for the filter and the interactive
+     search.  */
+  struct keylist_match_s *filter_match;
+  struct keylist_match_s *search_match;
+  /* Keys received from the keytable which are yet to be inserted
+     into the model, the index of the next one and the ID of the idle
+     handler inserting them.  */
+  GPtrArray *ingest;
+  guint ingest_pos;
+  guint ingest_id;
+  /* True if the listing ended while keys were still queued.  */
+  gboolean ingest_end;
+  /* The sort order which is suspended while inserting keys.  */
+  gboolean sort_suspended;
+  gint saved_sort_column;
+  GtkSortType saved_sort_order;
 
   int disposed;
 };
@@ -64,6 +93,7 @@ struct _GpaKeyListClass {
 
   /* Signal handlers */
   void (*context_menu) (GpaKeyList *keylist);
+  void (*listing_done) (GpaKeyList *keylist);
 };
 
 GType gpa_keylist_get_type (void) G_GNUC_CONST;
@@ -114,9 +144,22 @@ GList *gpa_keylist_get_selected_keys (GpaKeyList *keylist,
    than one key has been selected.  */
 gpgme_key_t gpa_keylist_get_selected_key (GpaKeyList *keylist);
 
+/* Return a GList with the keys of up to COUNT rows above and below
+   the selected row, nearest first.  Returns NULL unless exactly one
+   row is selected.  No references are provided.  */
+GList *gpa_keylist_get_adjacent_keys (GpaKeyList *keylist, int count);
+
+/* Show only keys whose user IDs, mail addresses, key IDs or
+   fingerprints contain TEXT.  A TEXT of NULL or "" shows all keys.  */
+void gpa_keylist_set_filter (GpaKeyList *keylist, const char *text);
+
 /* Begin a reload of the keyring. */
 void gpa_keylist_start_reload (GpaKeyList * keylist);
 
+/* Reload only the keys with the fingerprints given by the NULL
+   terminated array FPRS.  */
+void gpa_keylist_refresh_keys (GpaKeyList *keylist, const char **fprs);
+
 /* Let the keylist know that a new key with the given fingerprint is
    available. */
 void gpa_keylist_new_key (GpaKeyList * keylist, const char *fpr);
@@ -0,0 +1,1135 @@
+/* keylistmodel.c - The tree model of the key list.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "gpa.h"
+#include "convert.h"
+#include "gpgmetools.h"
+#include "format-dn.h"
+#include "keylistmodel.h"
+
+
+/* The number of rows whose formatted strings are cached.  This must
+   be well above the number of rows visible at once.  */
+#define CACHE_SIZE 512
+
+/* The allocated strings kept in the cache.  The other strings are
+   static anyway.  */
+enum
+  {
+    CACHED_CREATED,
+    CACHED_EXPIRY,
+    CACHED_USERID,
+    N_CACHED
+  };
+
+/* The number of text columns.  They come first in GpaKeyListColumn.  */
+#define N_TEXT_COLUMNS (GPA_KEYLIST_COLUMN_USERID + 1)
+
+struct cache_entry_s;
+
+struct row_s
+{
+  guint index;                  /* The position in MODEL->ROWS or
+                                   MODEL->HIDDEN.  */
+  gboolean hidden;
+  gpgme_key_t key;              /* NULL for a snapshot row.  */
+  const char *icon;
+  gboolean has_secret;
+  gulong created_ts;
+  gulong expiry_ts;
+  gulong ownertrust_value;
+  glong validity_value;
+  /* The strings of a snapshot row indexed by the column.  */
+  char **snapshot;
+  /* The formatted strings if they are cached.  */
+  struct cache_entry_s *cached;
+};
+typedef struct row_s *row_t;
+
+struct cache_entry_s
+{
+  GList link;                   /* The link in MODEL->CACHE.  */
+  row_t row;
+  char *str[N_CACHED];
+};
+
+/* Context for sorting all rows.  */
+struct sort_ctx_s
+{
+  GpaKeyListModel *model;
+  char **collate_keys;          /* Indexed by the old row index.  */
+};
+
+
+/* GObject */
+static GObjectClass *parent_class = NULL;
+
+
+
+/************************************************************
+ *********************  String cache  ***********************
+ ************************************************************/
+
+static void
+cache_drop (GpaKeyListModel *model, row_t row)
+{
+  struct cache_entry_s *entry = row->cached;
+  int idx;
+
+  if (!entry)
+    return;
+  g_queue_unlink (&model->cache, &entry->link);
+  for (idx = 0; idx < N_CACHED; idx++)
+    g_free (entry->str[idx]);
+  g_free (entry);
+  row->cached = NULL;
+}
+
+
+static char *
+format_userid (gpgme_key_t key)
+{
+  if (key->protocol == GPGME_PROTOCOL_CMS)
+    return gpa_format_dn (key->uids? key->uids->uid : NULL);
+  else
+    return gpa_gpgme_key_get_userid (key->uids);
+}
+
+
+/* Return the cached string WHICH of ROW, formatting the strings if
+   required.  The string is valid until the next call.  */
+static const char *
+cached_string (GpaKeyListModel *model, row_t row, int which)
+{
+  struct cache_entry_s *entry = row->cached;
+
+  if (entry)
+    {
+      /* Move to the front.  */
+      if (model->cache.head != &entry->link)
+        {
+          g_queue_unlink (&model->cache, &entry->link);
+          g_queue_push_head_link (&model->cache, &entry->link);
+        }
+      return entry->str[which];
+    }
+
+  if (model->cache.length >= CACHE_SIZE)
+    {
+      struct cache_entry_s *oldest = model->cache.tail->data;
+
+      cache_drop (model, oldest->row);
+    }
+
+  entry = g_new0 (struct cache_entry_s, 1);
+  entry->link.data = entry;
+  entry->row = row;
+  entry->str[CACHED_CREATED]
+    = gpa_creation_date_string (row->key->subkeys->timestamp);
+  entry->str[CACHED_EXPIRY]
+    = gpa_expiry_date_string (row->key->subkeys->expires);
+  entry->str[CACHED_USERID] = format_userid (row->key);
+  g_queue_push_head_link (&model->cache, &entry->link);
+  row->cached = entry;
+
+  return entry->str[which];
+}
+
+
+/* Return the string for the text COLUMN of ROW.  The string is valid
+   until the next call.  */
+static const char *
+row_string (GpaKeyListModel *model, row_t row, int column)
+{
+  gpgme_key_t key = row->key;
+
+  if (!key)
+    return row->snapshot? row->snapshot[column] : NULL;
+
+  switch (column)
+    {
+    case GPA_KEYLIST_COLUMN_IMAGE:
+      return row->icon;
+    case GPA_KEYLIST_COLUMN_KEYTYPE:
+      return (key->protocol == GPGME_PROTOCOL_OpenPGP? "P" :
+              key->protocol == GPGME_PROTOCOL_CMS? "X" : "?");
+    case GPA_KEYLIST_COLUMN_CREATED:
+      return cached_string (model, row, CACHED_CREATED);
+    case GPA_KEYLIST_COLUMN_EXPIRY:
+      return cached_string (model, row, CACHED_EXPIRY);
+    case GPA_KEYLIST_COLUMN_OWNERTRUST:
+      return gpa_key_ownertrust_string (key);
+    case GPA_KEYLIST_COLUMN_VALIDITY:
+      return gpa_key_validity_string (key);
+    case GPA_KEYLIST_COLUMN_USERID:
+      return cached_string (model, row, CACHED_USERID);
+    default:
+      return NULL;
+    }
+}
+
+
+/* Return a newly allocated string for the text COLUMN of ROW without
+   touching the cache.  */
+static char *
+row_dup_string (row_t row, int column)
+{
+  if (!row->key)
+    return g_strdup (row->snapshot? row->snapshot[column] : NULL);
+
+  switch (column)
+    {
+    case GPA_KEYLIST_COLUMN_CREATED:
+      return gpa_creation_date_string (row->key->subkeys->timestamp);
+    case GPA_KEYLIST_COLUMN_EXPIRY:
+      return gpa_expiry_date_string (row->key->subkeys->expires);
+    case GPA_KEYLIST_COLUMN_USERID:
+      return format_userid (row->key);
+    default:
+      return g_strdup (row_string (NULL, row, column));
+    }
+}
+
+
+
+/************************************************************
+ ***********************  Rows  *****************************
+ ************************************************************/
+
+static void
+row_set_key (row_t row, gpgme_key_t key, gboolean has_secret,
+             const char *icon)
+{
+  row->key = key;
+  row->icon = icon;
+  row->has_secret = has_secret;
+  row->created_ts = key->subkeys->timestamp;
+  /* Set "no expiration" to a large value for sorting */
+  row->expiry_ts = key->subkeys->expires? key->subkeys->expires : G_MAXULONG;
+  row->ownertrust_value = key->owner_trust;
+
+  /* Set an appropiate value for sorting revoked and expired keys. This
+   * includes a hack for forcing a value to a range outside the
+   * usual validity values */
+  if (key->subkeys->revoked)
+    row->validity_value = GPGME_VALIDITY_UNKNOWN-2;
+  else if (key->subkeys->expired)
+    row->validity_value = GPGME_VALIDITY_UNKNOWN-1;
+  else if (key->uids)
+    row->validity_value = key->uids->validity;
+  else
+    row->validity_value = GPGME_VALIDITY_UNKNOWN;
+}
+
+
+/* Release the contents of ROW but not ROW itself.  */
+static void
+row_clear (GpaKeyListModel *model, row_t row)
+{
+  int idx;
+
+  cache_drop (model, row);
+  if (row->key)
+    gpgme_key_unref (row->key);
+  row->key = NULL;
+  if (row->snapshot)
+    {
+      for (idx = 0; idx < N_TEXT_COLUMNS; idx++)
+        g_free (row->snapshot[idx]);
+      g_free (row->snapshot);
+      row->snapshot = NULL;
+    }
+}
+
+
+static gboolean
+is_sorted (GpaKeyListModel *model)
+{
+  return (model->sort_column != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID
+          && model->sort_column != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID);
+}
+
+
+#define CMP(a,b) (((a) > (b)) - ((a) < (b)))
+
+static gint
+compare_rows (GpaKeyListModel *model, row_t a, row_t b)
+{
+  gint res;
+
+  switch (model->sort_column)
+    {
+    case GPA_KEYLIST_COLUMN_HAS_SECRET:
+      res = CMP (a->has_secret, b->has_secret);
+      break;
+    case GPA_KEYLIST_COLUMN_CREATED_TS:
+      res = CMP (a->created_ts, b->created_ts);
+      break;
+    case GPA_KEYLIST_COLUMN_EXPIRY_TS:
+      res = CMP (a->expiry_ts, b->expiry_ts);
+      break;
+    case GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE:
+      res = CMP (a->ownertrust_value, b->ownertrust_value);
+      break;
+    case GPA_KEYLIST_COLUMN_VALIDITY_VALUE:
+      res = CMP (a->validity_value, b->validity_value);
+      break;
+    default:
+      if (model->sort_column < N_TEXT_COLUMNS)
+        {
+          /* Both strings stay cached because the cache holds more
+             than two entries.  */
+          const char *sa = row_string (model, a, model->sort_column);
+          const char *sb = row_string (model, b, model->sort_column);
+
+          res = g_utf8_collate (sa? sa : "", sb? sb : "");
+        }
+      else
+        res = 0;
+      break;
+    }
+
+  return model->sort_order == GTK_SORT_DESCENDING? -res : res;
+}
+
+
+/* Set the index of the rows in ARRAY starting at position START.  */
+static void
+renumber_rows (GPtrArray *array, guint start)
+{
+  guint idx;
+
+  for (idx = start; idx < array->len; idx++)
+    ((row_t) g_ptr_array_index (array, idx))->index = idx;
+}
+
+
+static gboolean
+is_visible (GpaKeyListModel *model, row_t row)
+{
+  return !row->key || !model->filter || model->filter (row->key,
+                                                       model->filter_data);
+}
+
+
+/* Put ROW, which is not part of the model, into the list of hidden
+   rows.  */
+static void
+hide_row (GpaKeyListModel *model, row_t row)
+{
+  cache_drop (model, row);
+  row->hidden = TRUE;
+  row->index = model->hidden->len;
+  g_ptr_array_add (model->hidden, row);
+}
+
+
+/* Insert ROW at its sorted position or at the end if the model is
+   not sorted.  */
+static void
+insert_row (GpaKeyListModel *model, row_t row, GtkTreeIter *r_iter)
+{
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  guint lo, hi;
+
+  lo = 0;
+  hi = model->rows->len;
+  if (is_sorted (model))
+    while (lo < hi)
+      {
+        guint mid = lo + (hi - lo) / 2;
+
+        if (compare_rows (model, g_ptr_array_index (model->rows, mid),
+                          row) <= 0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+  else
+    lo = hi;
+
+  row->hidden = FALSE;
+  g_ptr_array_insert (model->rows, lo, row);
+  renumber_rows (model->rows, lo);
+
+  iter.stamp = model->stamp;
+  iter.user_data = row;
+  path = gtk_tree_path_new_from_indices (lo, -1);
+  gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+  gtk_tree_path_free (path);
+
+  if (r_iter)
+    *r_iter = iter;
+}
+
+
+/* Take ROW out of the model without releasing it.  */
+static void
+unlink_row (GpaKeyListModel *model, row_t row)
+{
+  GtkTreePath *path;
+  guint pos = row->index;
+
+  g_ptr_array_remove_index (model->rows, pos);
+  renumber_rows (model->rows, pos);
+
+  path = gtk_tree_path_new_from_indices (pos, -1);
+  gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+  gtk_tree_path_free (path);
+}
+
+
+static gint
+sort_compare (gconstpointer pa, gconstpointer pb, gpointer data)
+{
+  struct sort_ctx_s *ctx = data;
+  row_t a = *(row_t *) pa;
+  row_t b = *(row_t *) pb;
+  gint res;
+
+  if (!ctx->collate_keys)
+    return compare_rows (ctx->model, a, b);
+
+  res = strcmp (ctx->collate_keys[a->index], ctx->collate_keys[b->index]);
+  return ctx->model->sort_order == GTK_SORT_DESCENDING? -res : res;
+}
+
+
+/* Sort all rows according to the current sort column.  */
+static void
+sort_rows (GpaKeyListModel *model)
+{
+  struct sort_ctx_s ctx;
+  guint n = model->rows->len;
+  GtkTreePath *path;
+  gint *new_order;
+  guint idx;
+
+  if (!is_sorted (model) || n < 2)
+    return;
+
+  ctx.model = model;
+  ctx.collate_keys = NULL;
+  if (model->sort_column < N_TEXT_COLUMNS)
+    {
+      /* Compute the collation keys once instead of formatting the
+         strings for each comparison.  */
+      ctx.collate_keys = g_new (char *, n);
+      for (idx = 0; idx < n; idx++)
+        {
+          char *str = row_dup_string (g_ptr_array_index (model->rows, idx),
+                                      model->sort_column);
+
+          ctx.collate_keys[idx] = g_utf8_collate_key (str? str : "", -1);
+          g_free (str);
+        }
+    }
+
+  g_ptr_array_sort_with_data (model->rows, sort_compare, &ctx);
+
+  new_order = g_new (gint, n);
+  for (idx = 0; idx < n; idx++)
+    {
+      row_t row = g_ptr_array_index (model->rows, idx);
+
+      new_order[idx] = row->index;
+      row->index = idx;
+    }
+
+  path = gtk_tree_path_new ();
+  gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, NULL,
+                                 new_order);
+  gtk_tree_path_free (path);
+  g_free (new_order);
+
+  if (ctx.collate_keys)
+    {
+      for (idx = 0; idx < n; idx++)
+        g_free (ctx.collate_keys[idx]);
+      g_free (ctx.collate_keys);
+    }
+}
+
+
+
+/************************************************************
+ ******************  GtkTreeModel interface  ****************
+ ************************************************************/
+
+static GtkTreeModelFlags
+model_get_flags (GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+
+static gint
+model_get_n_columns (GtkTreeModel *tree_model)
+{
+  return GPA_KEYLIST_N_COLUMNS;
+}
+
+
+static GType
+model_get_column_type (GtkTreeModel *tree_model, gint column)
+{
+  switch (column)
+    {
+    case GPA_KEYLIST_COLUMN_KEY:
+      return G_TYPE_POINTER;
+    case GPA_KEYLIST_COLUMN_HAS_SECRET:
+      return G_TYPE_INT;
+    case GPA_KEYLIST_COLUMN_CREATED_TS:
+    case GPA_KEYLIST_COLUMN_EXPIRY_TS:
+    case GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE:
+      return G_TYPE_ULONG;
+    case GPA_KEYLIST_COLUMN_VALIDITY_VALUE:
+      return G_TYPE_LONG;
+    default:
+      g_return_val_if_fail (column >= 0 && column < N_TEXT_COLUMNS,
+                            G_TYPE_INVALID);
+      return G_TYPE_STRING;
+    }
+}
+
+
+static gboolean
+set_iter (GpaKeyListModel *model, GtkTreeIter *iter, guint pos)
+{
+  if (pos >= model->rows->len)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+  iter->stamp = model->stamp;
+  iter->user_data = g_ptr_array_index (model->rows, pos);
+  return TRUE;
+}
+
+
+static gboolean
+model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                GtkTreePath *path)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  if (gtk_tree_path_get_depth (path) != 1)
+    return FALSE;
+  return set_iter (model, iter, gtk_tree_path_get_indices (path)[0]);
+}
+
+
+static GtkTreePath *
+model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+  row_t row = iter->user_data;
+
+  g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+  return gtk_tree_path_new_from_indices (row->index, -1);
+}
+
+
+static void
+model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, gint column,
+                 GValue *value)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+  row_t row = iter->user_data;
+
+  g_return_if_fail (iter->stamp == model->stamp);
+
+  g_value_init (value, model_get_column_type (tree_model, column));
+  switch (column)
+    {
+    case GPA_KEYLIST_COLUMN_KEY:
+      g_value_set_pointer (value, row->key);
+      break;
+    case GPA_KEYLIST_COLUMN_HAS_SECRET:
+      g_value_set_int (value, row->has_secret);
+      break;
+    case GPA_KEYLIST_COLUMN_CREATED_TS:
+      g_value_set_ulong (value, row->created_ts);
+      break;
+    case GPA_KEYLIST_COLUMN_EXPIRY_TS:
+      g_value_set_ulong (value, row->expiry_ts);
+      break;
+    case GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE:
+      g_value_set_ulong (value, row->ownertrust_value);
+      break;
+    case GPA_KEYLIST_COLUMN_VALIDITY_VALUE:
+      g_value_set_long (value, row->validity_value);
+      break;
+    default:
+      if (column >= 0 && column < N_TEXT_COLUMNS)
+        g_value_set_string (value, row_string (model, row, column));
+      break;
+    }
+}
+
+
+static gboolean
+model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+  row_t row = iter->user_data;
+
+  g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+  return set_iter (model, iter, row->index + 1);
+}
+
+
+static gboolean
+model_iter_previous (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+  row_t row = iter->user_data;
+
+  g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+  if (!row->index)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+  return set_iter (model, iter, row->index - 1);
+}
+
+
+static gboolean
+model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                     GtkTreeIter *parent)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  if (parent)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+  return set_iter (model, iter, 0);
+}
+
+
+static gboolean
+model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+
+static gint
+model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  return iter? 0 : model->rows->len;
+}
+
+
+static gboolean
+model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                      GtkTreeIter *parent, gint n)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  if (parent || n < 0)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+  return set_iter (model, iter, n);
+}
+
+
+static gboolean
+model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                   GtkTreeIter *child)
+{
+  iter->stamp = 0;
+  return FALSE;
+}
+
+
+static void
+gpa_keylist_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = model_get_flags;
+  iface->get_n_columns = model_get_n_columns;
+  iface->get_column_type = model_get_column_type;
+  iface->get_iter = model_get_iter;
+  iface->get_path = model_get_path;
+  iface->get_value = model_get_value;
+  iface->iter_next = model_iter_next;
+  iface->iter_previous = model_iter_previous;
+  iface->iter_children = model_iter_children;
+  iface->iter_has_child = model_iter_has_child;
+  iface->iter_n_children = model_iter_n_children;
+  iface->iter_nth_child = model_iter_nth_child;
+  iface->iter_parent = model_iter_parent;
+}
+
+
+
+/************************************************************
+ ****************  GtkTreeSortable interface  ***************
+ ************************************************************/
+
+static gboolean
+sortable_get_sort_column_id (GtkTreeSortable *sortable, gint *column,
+                             GtkSortType *order)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (sortable);
+
+  if (column)
+    *column = model->sort_column;
+  if (order)
+    *order = model->sort_order;
+  return is_sorted (model);
+}
+
+
+static void
+sortable_set_sort_column_id (GtkTreeSortable *sortable, gint column,
+                             GtkSortType order)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (sortable);
+
+  if (model->sort_column == column && model->sort_order == order)
+    return;
+
+  model->sort_column = column;
+  model->sort_order = order;
+  gtk_tree_sortable_sort_column_changed (sortable);
+  sort_rows (model);
+}
+
+
+static void
+sortable_set_sort_func (GtkTreeSortable *sortable, gint column,
+                        GtkTreeIterCompareFunc func, gpointer data,
+                        GDestroyNotify destroy)
+{
+  g_warning ("%s: custom sort functions are not supported", G_STRFUNC);
+}
+
+
+static void
+sortable_set_default_sort_func (GtkTreeSortable *sortable,
+                                GtkTreeIterCompareFunc func, gpointer data,
+                                GDestroyNotify destroy)
+{
+  g_warning ("%s: custom sort functions are not supported", G_STRFUNC);
+}
+
+
+static gboolean
+sortable_has_default_sort_func (GtkTreeSortable *sortable)
+{
+  return FALSE;
+}
+
+
+static void
+gpa_keylist_model_sortable_init (GtkTreeSortableIface *iface)
+{
+  iface->get_sort_column_id = sortable_get_sort_column_id;
+  iface->set_sort_column_id = sortable_set_sort_column_id;
+  iface->set_sort_func = sortable_set_sort_func;
+  iface->set_default_sort_func = sortable_set_default_sort_func;
+  iface->has_default_sort_func = sortable_has_default_sort_func;
+}
+
+
+
+/************************************************************
+ ******************  Object Management  *********************
+ ************************************************************/
+
+static void
+gpa_keylist_model_finalize (GObject *object)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (object);
+  guint idx;
+
+  for (idx = 0; idx < model->rows->len; idx++)
+    {
+      row_t row = g_ptr_array_index (model->rows, idx);
+
+      row_clear (model, row);
+      g_free (row);
+    }
+  g_ptr_array_free (model->rows, TRUE);
+  for (idx = 0; idx < model->hidden->len; idx++)
+    {
+      row_t row = g_ptr_array_index (model->hidden, idx);
+
+      row_clear (model, row);
+      g_free (row);
+    }
+  g_ptr_array_free (model->hidden, TRUE);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static void
+gpa_keylist_model_init (GTypeInstance *instance, void *class_ptr)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (instance);
+
+  model->stamp = g_random_int ();
+  model->rows = g_ptr_array_new ();
+  model->hidden = g_ptr_array_new ();
+  model->sort_column = GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+  model->sort_order = GTK_SORT_ASCENDING;
+  g_queue_init (&model->cache);
+}
+
+
+static void
+gpa_keylist_model_class_init (void *class_ptr, void *class_data)
+{
+  GpaKeyListModelClass *klass = class_ptr;
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  object_class->finalize = gpa_keylist_model_finalize;
+}
+
+
+GType
+gpa_keylist_model_get_type (void)
+{
+  static GType model_type = 0;
+
+  if (!model_type)
+    {
+      static const GTypeInfo model_info =
+      {
+        sizeof (GpaKeyListModelClass),
+        (GBaseInitFunc) NULL,
+        (GBaseFinalizeFunc) NULL,
+        gpa_keylist_model_class_init,
+        NULL,           /* class_finalize */
+        NULL,           /* class_data */
+        sizeof (GpaKeyListModel),
+        0,              /* n_preallocs */
+        gpa_keylist_model_init,
+      };
+      static const GInterfaceInfo tree_model_info =
+      {
+        (GInterfaceInitFunc) gpa_keylist_model_tree_model_init,
+        NULL,
+        NULL
+      };
+      static const GInterfaceInfo sortable_info =
+      {
+        (GInterfaceInitFunc) gpa_keylist_model_sortable_init,
+        NULL,
+        NULL
+      };
+
+      model_type = g_type_register_static (G_TYPE_OBJECT,
+                                           "GpaKeyListModel",
+                                           &model_info, 0);
+      g_type_add_interface_static (model_type, GTK_TYPE_TREE_MODEL,
+                                   &tree_model_info);
+      g_type_add_interface_static (model_type, GTK_TYPE_TREE_SORTABLE,
+                                   &sortable_info);
+    }
+
+  return model_type;
+}
+
+
+
+/************************************************************
+ **********************  Public API  ************************
+ ************************************************************/
+
+/* Create a new empty model.  */
+GpaKeyListModel *
+gpa_keylist_model_new (void)
+{
+  return g_object_new (GPA_KEYLIST_MODEL_TYPE, NULL);
+}
+
+
+/* Add a row for KEY and store it at R_ITER if that is not NULL.
+   ICON is the static name of the icon or NULL.  Takes ownership of
+   KEY.  */
+void
+gpa_keylist_model_append (GpaKeyListModel *model, gpgme_key_t key,
+                          gboolean has_secret, const char *icon,
+                          GtkTreeIter *r_iter)
+{
+  row_t row;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+  g_return_if_fail (key && key->subkeys);
+
+  row = g_new0 (struct row_s, 1);
+  row_set_key (row, key, has_secret, icon);
+  if (is_visible (model, row))
+    insert_row (model, row, r_iter);
+  else
+    {
+      hide_row (model, row);
+      if (r_iter)
+        r_iter->stamp = 0;
+    }
+}
+
+
+/* Add a row without a key showing the snapshot ENTRY.  */
+void
+gpa_keylist_model_append_snapshot
+  (GpaKeyListModel *model, const struct gpa_key_snapshot_entry_s *entry,
+   GtkTreeIter *r_iter)
+{
+  row_t row;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+
+  row = g_new0 (struct row_s, 1);
+  row->snapshot = g_new0 (char *, N_TEXT_COLUMNS);
+  row->snapshot[GPA_KEYLIST_COLUMN_IMAGE] = g_strdup (entry->icon);
+  row->snapshot[GPA_KEYLIST_COLUMN_KEYTYPE] = g_strdup (entry->keytype);
+  row->snapshot[GPA_KEYLIST_COLUMN_CREATED] = g_strdup (entry->created);
+  row->snapshot[GPA_KEYLIST_COLUMN_EXPIRY] = g_strdup (entry->expiry);
+  row->snapshot[GPA_KEYLIST_COLUMN_OWNERTRUST] = g_strdup (entry->ownertrust);
+  row->snapshot[GPA_KEYLIST_COLUMN_VALIDITY] = g_strdup (entry->validity);
+  row->snapshot[GPA_KEYLIST_COLUMN_USERID] = g_strdup (entry->userid);
+  row->has_secret = entry->has_secret;
+  row->created_ts = entry->created_ts;
+  row->expiry_ts = entry->expiry_ts;
+  row->ownertrust_value = entry->ownertrust_value;
+  row->validity_value = entry->validity_value;
+  insert_row (model, row, r_iter);
+}
+
+
+/* Replace the contents of the row at ITER by KEY.  Takes ownership of
+   KEY.  If the filter hides the key, ITER is invalidated.  */
+void
+gpa_keylist_model_set_key (GpaKeyListModel *model, GtkTreeIter *iter,
+                           gpgme_key_t key, gboolean has_secret,
+                           const char *icon)
+{
+  GtkTreePath *path;
+  row_t row;
+  guint pos;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+  g_return_if_fail (iter->stamp == model->stamp);
+  g_return_if_fail (key && key->subkeys);
+
+  row = iter->user_data;
+  row_clear (model, row);
+  row_set_key (row, key, has_secret, icon);
+
+  if (!is_visible (model, row))
+    {
+      unlink_row (model, row);
+      hide_row (model, row);
+      iter->stamp = 0;
+      return;
+    }
+
+  /* Move the row if it is not at its sorted position anymore.  */
+  pos = row->index;
+  if (is_sorted (model)
+      && ((pos > 0
+           && compare_rows (model, g_ptr_array_index (model->rows, pos - 1),
+                            row) > 0)
+          || (pos + 1 < model->rows->len
+              && compare_rows (model, row,
+                               g_ptr_array_index (model->rows, pos + 1)) > 0)))
+    {
+      unlink_row (model, row);
+      insert_row (model, row, iter);
+      return;
+    }
+
+  path = gtk_tree_path_new_from_indices (pos, -1);
+  gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, iter);
+  gtk_tree_path_free (path);
+}
+
+
+/* Return the key of the row at ITER.  The key belongs to the model;
+   it is NULL for snapshot rows.  */
+gpgme_key_t
+gpa_keylist_model_get_key (GpaKeyListModel *model, GtkTreeIter *iter)
+{
+  g_return_val_if_fail (GPA_IS_KEYLIST_MODEL (model), NULL);
+  g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+
+  return ((row_t) iter->user_data)->key;
+}
+
+
+/* Remove the row at ITER.  Returns TRUE and sets ITER to the next
+   row if there is one.  */
+gboolean
+gpa_keylist_model_remove (GpaKeyListModel *model, GtkTreeIter *iter)
+{
+  row_t row;
+  guint pos;
+
+  g_return_val_if_fail (GPA_IS_KEYLIST_MODEL (model), FALSE);
+  g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+  row = iter->user_data;
+  pos = row->index;
+  unlink_row (model, row);
+  row_clear (model, row);
+  g_free (row);
+
+  return set_iter (model, iter, pos);
+}
+
+
+/* Remove all rows.  */
+void
+gpa_keylist_model_clear (GpaKeyListModel *model)
+{
+  GtkTreeIter iter;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+
+  /* Remove from the end so that no rows need to be moved.  */
+  while (set_iter (model, &iter, model->rows->len - 1))
+    gpa_keylist_model_remove (model, &iter);
+
+  while (model->hidden->len)
+    {
+      row_t row = g_ptr_array_remove_index (model->hidden,
+                                            model->hidden->len - 1);
+
+      row_clear (model, row);
+      g_free (row);
+    }
+}
+
+
+static gboolean
+row_in_set (row_t row, GHashTable *fprs)
+{
+  return (row->key && row->key->subkeys && row->key->subkeys->fpr
+          && g_hash_table_contains (fprs, row->key->subkeys->fpr));
+}
+
+
+/* Remove the rows of all keys, including hidden ones, whose primary
+   fingerprint is in the set FPRS.  */
+void
+gpa_keylist_model_remove_keys (GpaKeyListModel *model, GHashTable *fprs)
+{
+  GtkTreeIter iter;
+  gboolean valid;
+  guint idx, keep;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+
+  valid = set_iter (model, &iter, 0);
+  while (valid)
+    {
+      if (row_in_set (iter.user_data, fprs))
+        valid = gpa_keylist_model_remove (model, &iter);
+      else
+        valid = model_iter_next (GTK_TREE_MODEL (model), &iter);
+    }
+
+  /* The hidden rows are not visible to the view; thus they can be
+     compacted in one pass.  */
+  for (idx = keep = 0; idx < model->hidden->len; idx++)
+    {
+      row_t row = g_ptr_array_index (model->hidden, idx);
+
+      if (row_in_set (row, fprs))
+        {
+          row_clear (model, row);
+          g_free (row);
+        }
+      else
+        {
+          row->index = keep;
+          g_ptr_array_index (model->hidden, keep++) = row;
+        }
+    }
+  g_ptr_array_set_size (model->hidden, keep);
+}
+
+
+/* Show only the keys for which FILTER returns true; snapshot rows are
+   always shown.  A FILTER of NULL shows all keys.  No signals are
+   emitted; thus the model must not be attached to a view.  */
+void
+gpa_keylist_model_set_filter (GpaKeyListModel *model,
+                              GpaKeyListModelFilterFunc filter,
+                              gpointer data)
+{
+  GPtrArray *rows, *hidden;
+  guint idx;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+
+  model->filter = filter;
+  model->filter_data = data;
+
+  rows = g_ptr_array_sized_new (model->rows->len + model->hidden->len);
+  hidden = model->hidden;
+  model->hidden = g_ptr_array_new ();
+
+  for (idx = 0; idx < model->rows->len; idx++)
+    {
+      row_t row = g_ptr_array_index (model->rows, idx);
+
+      if (is_visible (model, row))
+        g_ptr_array_add (rows, row);
+      else
+        hide_row (model, row);
+    }
+  for (idx = 0; idx < hidden->len; idx++)
+    {
+      row_t row = g_ptr_array_index (hidden, idx);
+
+      if (is_visible (model, row))
+        {
+          row->hidden = FALSE;
+          g_ptr_array_add (rows, row);
+        }
+      else
+        hide_row (model, row);
+    }
+  g_ptr_array_free (hidden, TRUE);
+  g_ptr_array_free (model->rows, TRUE);
+  model->rows = rows;
+  renumber_rows (model->rows, 0);
+
+  /* Rows which became visible have been appended.  */
+  sort_rows (model);
+}
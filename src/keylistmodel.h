@@ -0,0 +1,142 @@
+/* keylistmodel.h - The tree model of the key list.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A list model holding one row per key.  Unlike a GtkListStore the
+   display strings are not stored; they are computed from the key when
+   the view asks for them and a small number of them is cached.  */
+
+#ifndef GPA_KEYLIST_MODEL_H
+#define GPA_KEYLIST_MODEL_H
+
+#include <gtk/gtk.h>
+#include <gpgme.h>
+
+#include "keysnapshot.h"
+
+/* GObject stuff */
+#define GPA_KEYLIST_MODEL_TYPE	  (gpa_keylist_model_get_type ())
+#define GPA_KEYLIST_MODEL(obj)	  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_KEYLIST_MODEL_TYPE, GpaKeyListModel))
+#define GPA_KEYLIST_MODEL_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_KEYLIST_MODEL_TYPE, GpaKeyListModelClass))
+#define GPA_IS_KEYLIST_MODEL(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEYLIST_MODEL_TYPE))
+#define GPA_IS_KEYLIST_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_KEYLIST_MODEL_TYPE))
+#define GPA_KEYLIST_MODEL_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_KEYLIST_MODEL_TYPE, GpaKeyListModelClass))
+
+typedef struct _GpaKeyListModel GpaKeyListModel;
+typedef struct _GpaKeyListModelClass GpaKeyListModelClass;
+
+/* Return true if KEY shall be shown.  */
+typedef gboolean (*GpaKeyListModelFilterFunc) (gpgme_key_t key,
+                                               gpointer data);
+
+
+/* Symbols to access the columns.  */
+typedef enum
+{
+  /* These are the displayed columns */
+  GPA_KEYLIST_COLUMN_IMAGE,
+  GPA_KEYLIST_COLUMN_KEYTYPE,
+  GPA_KEYLIST_COLUMN_CREATED,
+  GPA_KEYLIST_COLUMN_EXPIRY,
+  GPA_KEYLIST_COLUMN_OWNERTRUST,
+  GPA_KEYLIST_COLUMN_VALIDITY,
+  GPA_KEYLIST_COLUMN_USERID,
+  /* This column contains the gpgme_key_t */
+  GPA_KEYLIST_COLUMN_KEY,
+  /* These columns are used only internally for sorting */
+  GPA_KEYLIST_COLUMN_HAS_SECRET,
+  GPA_KEYLIST_COLUMN_CREATED_TS,
+  GPA_KEYLIST_COLUMN_EXPIRY_TS,
+  GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
+  GPA_KEYLIST_COLUMN_VALIDITY_VALUE,
+  GPA_KEYLIST_N_COLUMNS
+} GpaKeyListColumn;
+
+
+struct _GpaKeyListModel {
+  GObject parent;
+
+  /* Private.  */
+  gint stamp;
+  /* The rows in display order.  */
+  GPtrArray *rows;
+  /* The rows hidden by the filter.  */
+  GPtrArray *hidden;
+  GpaKeyListModelFilterFunc filter;
+  gpointer filter_data;
+  gint sort_column;
+  GtkSortType sort_order;
+  /* Recently used formatted strings; the most recently used first.  */
+  GQueue cache;
+};
+
+struct _GpaKeyListModelClass {
+  GObjectClass parent_class;
+};
+
+GType gpa_keylist_model_get_type (void) G_GNUC_CONST;
+
+/* API */
+
+/* Create a new empty model.  */
+GpaKeyListModel *gpa_keylist_model_new (void);
+
+/* Add a row for KEY and store it at R_ITER if that is not NULL.
+   ICON is the static name of the icon or NULL.  Takes ownership of
+   KEY.  If the filter hides the key, R_ITER is invalid.  */
+void gpa_keylist_model_append (GpaKeyListModel *model, gpgme_key_t key,
+                               gboolean has_secret, const char *icon,
+                               GtkTreeIter *r_iter);
+
+/* Add a row without a key showing the snapshot ENTRY.  */
+void gpa_keylist_model_append_snapshot
+  (GpaKeyListModel *model, const struct gpa_key_snapshot_entry_s *entry,
+   GtkTreeIter *r_iter);
+
+/* Replace the contents of the row at ITER by KEY.  Takes ownership of
+   KEY.  */
+void gpa_keylist_model_set_key (GpaKeyListModel *model, GtkTreeIter *iter,
+                                gpgme_key_t key, gboolean has_secret,
+                                const char *icon);
+
+/* Return the key of the row at ITER.  The key belongs to the model;
+   it is NULL for snapshot rows.  */
+gpgme_key_t gpa_keylist_model_get_key (GpaKeyListModel *model,
+                                       GtkTreeIter *iter);
+
+/* Remove the row at ITER.  Returns TRUE and sets ITER to the next
+   row if there is one.  */
+gboolean gpa_keylist_model_remove (GpaKeyListModel *model,
+                                   GtkTreeIter *iter);
+
+/* Remove the rows of all keys, including hidden ones, whose primary
+   fingerprint is in the set FPRS.  */
+void gpa_keylist_model_remove_keys (GpaKeyListModel *model,
+                                    GHashTable *fprs);
+
+/* Remove all rows.  */
+void gpa_keylist_model_clear (GpaKeyListModel *model);
+
+/* Show only the keys for which FILTER returns true; snapshot rows are
+   always shown.  A FILTER of NULL shows all keys.  No signals are
+   emitted; thus the model must not be attached to a view.  */
+void gpa_keylist_model_set_filter (GpaKeyListModel *model,
+                                   GpaKeyListModelFilterFunc filter,
+                                   gpointer data);
+
+#endif /* GPA_KEYLIST_MODEL_H */
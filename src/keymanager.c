@@ -44,6 +44,7 @@
 #include "gpgmetools.h"
 #include "gpgmeedit.h"
 #include "keytable.h"
+#include "keysnapshot.h"
 #include "server-access.h"
 #include "options.h"
 #include "convert.h"
@@ -124,6 +125,40 @@ struct _GpaKeyManager
   /* Hack: warn the selection callback to ignore changes. Don't, ever,
      assign a value directly.  Raise and lower it with increments.  */
   int freeze_selection;
+
+  /* Fingerprints of keys changed by our own operations.  They are
+     collected until the idle handler with the id REFRESH_ID does an
+     incremental refresh of the key list.  */
+  GHashTable *pending_fprs;
+  guint refresh_id;
+  /* Number of our own key operations still running.  */
+  int ops_running;
+  /* True while the key list lists keys on our behalf.  */
+  gboolean listing;
+  /* Keyring file changes are considered to be caused by ourself up
+     to this monotonic time.  */
+  gint64 quiet_until;
+  /* The state of the keyring files when the quiet time started.  */
+  struct gpa_keyring_stamp_s quiet_stamp;
+  /* True if the keyring files changed while we were busy or quiet.
+     They are compared with QUIET_STAMP once we are idle again.  */
+  gboolean keyring_dirty;
+  /* Timeout handler id for this check.  */
+  guint reload_id;
+
+  /* Recently listed keys with all signatures.  DETAILS_LRU holds the
+     entries with the most recently used first and DETAILS_CACHE maps
+     the fingerprints to the entries.  */
+  GQueue details_lru;
+  GHashTable *details_cache;
+  /* Fingerprint and protocol of the selected key if it is still to be
+     listed.  */
+  char *details_fpr;
+  gpgme_protocol_t details_protocol;
+  /* Timeout handler id for the delayed listing of the selected key.  */
+  guint details_fetch_id;
+  /* True if the neighbours of the selected key have been listed.  */
+  gboolean prefetched;
 };
 
 
@@ -138,9 +173,42 @@ static GpaKeyManager *this_instance;
 typedef gboolean (*sensitivity_func_t) (gpointer);
 
 
+/* The watches for keyring changes done by other applications.  They
+   are indexed like gpa_keyring_files.  */
+static char *keyring_fnames[GPA_KEYRING_N_FILES];
+static gpa_filewatch_id_t keyring_watches[GPA_KEYRING_N_FILES];
+static int keyring_watch_lost[GPA_KEYRING_N_FILES];
+static guint keyring_rewatch_id;
+
+/* Seconds to ignore keyring file changes after we changed or listed
+   the keyring ourself.  */
+#define KEYRING_QUIET_TIME 5
+
+/* The number of keys kept in the details cache.  */
+#define DETAILS_CACHE_SIZE 64
+
+/* Milliseconds to wait after a selection change before listing the
+   selected key.  */
+#define DETAILS_FETCH_DELAY 150
+
+/* The number of rows above and below the selected key to prefetch.  */
+#define DETAILS_PREFETCH 2
+
+/* An entry of the details cache.  */
+struct details_entry_s
+{
+  GList link;
+  char *fpr;
+  gpgme_key_t key;
+};
+
 /* Local prototypes */
+static void keyring_watch_cb (void *user_data, const char *filename,
+                              const char *reason);
 static int idle_update_details (gpointer param);
 static void keyring_update_details (GpaKeyManager *self);
+static void details_cache_invalidate (GpaKeyManager *self, const char *fpr);
+static gboolean key_manager_external_change (gpointer param);
 
 static void gpa_key_manager_finalize (GObject *object);
 
@@ -289,29 +357,269 @@ key_manager_current_key (GpaKeyManager *self)
 /* Action callbacks.  */
 
 
+/* Return true if keyring file changes may be caused by ourself.  */
+static gboolean
+key_manager_busy (GpaKeyManager *self)
+{
+  return (self->ops_running || self->refresh_id || self->listing
+          || g_get_monotonic_time () < self->quiet_until);
+}
+
+
+/* Schedule the check for changes of the keyring files by other
+   applications if there were changes.  While an operation or a
+   listing is running this is done again once it has finished.  */
 static void
-gpa_key_manager_changed_wot_cb (gpointer data)
+key_manager_schedule_check (GpaKeyManager *self)
 {
-  GpaKeyManager *self = data;
+  gint64 now = g_get_monotonic_time ();
+  guint delay = 0;
+
+  if (!self->keyring_dirty || self->reload_id
+      || self->ops_running || self->refresh_id || self->listing)
+    return;
+
+  if (now < self->quiet_until)
+    delay = (self->quiet_until - now) / 1000;
+  /* Wait a moment so that we reload only once for a burst of
+     changes.  */
+  self->reload_id = g_timeout_add (delay + 1000, key_manager_external_change,
+                                   self);
+}
+
+
+/* Ignore keyring changes for the next KEYRING_QUIET_TIME seconds and
+   remember the current state of the keyring files.  */
+static void
+key_manager_set_quiet (GpaKeyManager *self)
+{
+  if (self->listing)
+    return;  /* Done by key_manager_listing_done.  */
+
+  self->quiet_until = (g_get_monotonic_time ()
+                       + KEYRING_QUIET_TIME * G_USEC_PER_SEC);
+  gpa_keyring_stamp (&self->quiet_stamp);
+  key_manager_schedule_check (self);
+}
+
+
+/* Called by the key list after a listing has finished.  A listing
+   may update the trustdb; thus the quiet time starts only now.  */
+static void
+key_manager_listing_done (GpaKeyList *keylist, gpointer param)
+{
+  GpaKeyManager *self = param;
+
+  self->listing = FALSE;
+  key_manager_set_quiet (self);
+}
+
+
+/* Reload the entire key list.  */
+static void
+key_manager_reload (GpaKeyManager *self)
+{
+  if (self->refresh_id)
+    {
+      g_source_remove (self->refresh_id);
+      self->refresh_id = 0;
+    }
+  if (self->reload_id)
+    {
+      g_source_remove (self->reload_id);
+      self->reload_id = 0;
+    }
+  g_hash_table_remove_all (self->pending_fprs);
+  details_cache_invalidate (self, NULL);
+  self->listing = TRUE;
   gpa_keylist_start_reload (self->keylist);
 }
 
 
+/* Idle handler to refresh the keys collected in PENDING_FPRS.  */
+static gboolean
+key_manager_refresh_pending (gpointer param)
+{
+  GpaKeyManager *self = param;
+  const char **fprs;
+
+  self->refresh_id = 0;
+  if (!g_hash_table_size (self->pending_fprs))
+    return FALSE;
+
+  fprs = (const char **) g_hash_table_get_keys_as_array (self->pending_fprs,
+                                                         NULL);
+  self->listing = TRUE;
+  gpa_keylist_refresh_keys (self->keylist, fprs);
+  g_free (fprs);
+  g_hash_table_remove_all (self->pending_fprs);
+
+  return FALSE;
+}
+
+
+/* Schedule an incremental refresh of the key with fingerprint FPR.  */
 static void
-gpa_key_manager_changed_wot_secret_cb (gpointer data)
+key_manager_queue_refresh (GpaKeyManager *self, const char *fpr)
+{
+  if (!fpr)
+    return;
+
+  g_hash_table_add (self->pending_fprs, g_strdup (fpr));
+  details_cache_invalidate (self, fpr);
+  /* The keyring files are checked again after the refresh.  */
+  if (self->reload_id)
+    {
+      g_source_remove (self->reload_id);
+      self->reload_id = 0;
+    }
+  if (!self->refresh_id)
+    self->refresh_id = g_idle_add (key_manager_refresh_pending, self);
+}
+
+
+/* Timeout handler to reload the key list if another application
+   changed the keyring.  */
+static gboolean
+key_manager_external_change (gpointer param)
+{
+  GpaKeyManager *self = param;
+  struct gpa_keyring_stamp_s stamp;
+
+  self->reload_id = 0;
+  if (key_manager_busy (self))
+    {
+      key_manager_schedule_check (self);
+      return FALSE;
+    }
+
+  self->keyring_dirty = FALSE;
+  gpa_keyring_stamp (&stamp);
+  /* The changes seen during the quiet time are our own if the files
+     are as they were at its start.  */
+  if (memcmp (&stamp, &self->quiet_stamp, sizeof stamp))
+    key_manager_reload (self);
+  return FALSE;
+}
+
+
+/* Idle handler to watch keyring files again which have been replaced
+   (e.g. by a rename).  */
+static gboolean
+keyring_rewatch (gpointer param)
+{
+  int idx;
+
+  keyring_rewatch_id = 0;
+  for (idx = 0; gpa_keyring_files[idx]; idx++)
+    if (keyring_watch_lost[idx])
+      {
+        keyring_watch_lost[idx] = 0;
+        gpa_remove_filewatch (keyring_watches[idx]);
+        keyring_watches[idx] = gpa_add_filewatch (keyring_fnames[idx], "wx",
+                                                  keyring_watch_cb, NULL);
+      }
+
+  return FALSE;
+}
+
+
+/* File watch callback for the keyring files.  */
+static void
+keyring_watch_cb (void *user_data, const char *filename, const char *reason)
+{
+  GpaKeyManager *self = this_instance;
+  int idx;
+
+  if (strchr (reason, 'x'))
+    {
+      /* The file has been removed or replaced.  */
+      for (idx = 0; gpa_keyring_files[idx]; idx++)
+        if (!strcmp (filename, keyring_fnames[idx]))
+          keyring_watch_lost[idx] = 1;
+      if (!keyring_rewatch_id)
+        keyring_rewatch_id = g_timeout_add_seconds (1, keyring_rewatch, NULL);
+    }
+
+  if (!self)
+    return;
+
+  self->keyring_dirty = TRUE;
+  key_manager_schedule_check (self);
+}
+
+
+/* Start watching the keyring files.  This needs to be done only once
+   for all instances of the key manager.  */
+static void
+keyring_watch_init (void)
+{
+  static int initialized;
+  int idx;
+
+  if (initialized)
+    return;
+  initialized = 1;
+
+  for (idx = 0; gpa_keyring_files[idx]; idx++)
+    {
+      keyring_fnames[idx] = g_build_filename (gnupg_homedir,
+                                              gpa_keyring_files[idx], NULL);
+      keyring_watches[idx] = gpa_add_filewatch (keyring_fnames[idx], "wx",
+                                                keyring_watch_cb, NULL);
+    }
+}
+
+
+static void
+gpa_key_manager_changed_wot_cb (GpaKeyOperation *op, gpointer data)
 {
   GpaKeyManager *self = data;
+  GList *keys;
 
-  gpa_keylist_imported_secret_key (self->keylist);
-  gpa_keylist_start_reload (self->keylist);
+  /* Changing the owner trust may change the validity of many other
+     keys; thus we need to reload everything.  */
+  if (GPA_IS_KEY_TRUST_OPERATION (op))
+    {
+      key_manager_reload (self);
+      return;
+    }
+
+  for (keys = gpa_key_operation_keys (op); keys; keys = g_list_next (keys))
+    {
+      gpgme_key_t key = keys->data;
+
+      if (key && key->subkeys)
+        key_manager_queue_refresh (self, key->subkeys->fpr);
+    }
 }
 
+
+static void
+gpa_key_manager_imported_keys_cb (GpaImportOperation *op, gpointer data)
+{
+  GpaKeyManager *self = data;
+  guint idx;
+
+  /* Without changed keys there is nothing to refresh.  */
+  if (!op->fprs || !op->fprs->len)
+    return;
+
+  for (idx = 0; idx < op->fprs->len; idx++)
+    key_manager_queue_refresh (self, g_ptr_array_index (op->fprs, idx));
+}
+
+
 static void
 gpa_key_manager_key_modified (GpaKeyEditDialog *dialog, gpgme_key_t key,
 				 gpointer data)
 {
   GpaKeyManager *self = data;
-  gpa_keylist_start_reload (self->keylist);
+
+  if (key && key->subkeys)
+    key_manager_queue_refresh (self, key->subkeys->fpr);
+  else
+    key_manager_reload (self);
 }
 
 
@@ -326,12 +634,31 @@ gpa_key_manager_new_key_cb (gpointer data, const gchar *fpr)
 }
 
 
+/* Called when one of our own operations has completed.  */
+static void
+gpa_key_manager_op_completed_cb (gpointer data)
+{
+  GpaKeyManager *self = data;
+
+  if (self->ops_running)
+    self->ops_running--;
+  /* Late keyring file events are still caused by the operation.
+     Changes seen while it was running are checked after the quiet
+     time.  */
+  key_manager_set_quiet (self);
+}
+
+
 static void
 register_key_operation (GpaKeyManager *self, GpaKeyOperation *op)
 {
-  g_signal_connect_swapped (G_OBJECT (op), "changed_wot",
-			    G_CALLBACK (gpa_key_manager_changed_wot_cb),
-			    self);
+  self->ops_running++;
+  g_signal_connect (G_OBJECT (op), "changed_wot",
+		    G_CALLBACK (gpa_key_manager_changed_wot_cb),
+		    self);
+  g_signal_connect_swapped (G_OBJECT (op), "completed",
+                            G_CALLBACK (gpa_key_manager_op_completed_cb),
+                            self);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), self);
 }
@@ -340,13 +667,16 @@ register_key_operation (GpaKeyManager *self, GpaKeyOperation *op)
 static void
 register_import_operation (GpaKeyManager *self, GpaImportOperation *op)
 {
-  g_signal_connect_swapped (G_OBJECT (op), "imported_keys",
-			    G_CALLBACK (gpa_key_manager_changed_wot_cb),
-			    self);
-  g_signal_connect_swapped
-    (G_OBJECT (op), "imported_secret_keys",
-     G_CALLBACK (gpa_key_manager_changed_wot_secret_cb),
-     self);
+  self->ops_running++;
+  g_signal_connect (G_OBJECT (op), "imported_keys",
+                    G_CALLBACK (gpa_key_manager_imported_keys_cb),
+                    self);
+  g_signal_connect (G_OBJECT (op), "imported_secret_keys",
+                    G_CALLBACK (gpa_key_manager_imported_keys_cb),
+                    self);
+  g_signal_connect_swapped (G_OBJECT (op), "completed",
+                            G_CALLBACK (gpa_key_manager_op_completed_cb),
+                            self);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), self);
 }
@@ -667,6 +997,189 @@ keyring_selection_update_actions (GpaKeyManager *self)
 }
 
 
+/* Remove ENTRY from the details cache and release it.  */
+static void
+details_cache_drop (GpaKeyManager *self, struct details_entry_s *entry)
+{
+  g_queue_unlink (&self->details_lru, &entry->link);
+  g_hash_table_remove (self->details_cache, entry->fpr);
+  gpgme_key_unref (entry->key);
+  g_free (entry->fpr);
+  g_free (entry);
+}
+
+
+/* Return the cached key with fingerprint FPR or NULL.  No reference
+   is provided.  */
+static gpgme_key_t
+details_cache_lookup (GpaKeyManager *self, const char *fpr)
+{
+  struct details_entry_s *entry;
+
+  entry = fpr? g_hash_table_lookup (self->details_cache, fpr) : NULL;
+  if (!entry)
+    return NULL;
+  if (self->details_lru.head != &entry->link)
+    {
+      g_queue_unlink (&self->details_lru, &entry->link);
+      g_queue_push_head_link (&self->details_lru, &entry->link);
+    }
+  return entry->key;
+}
+
+
+/* Add KEY to the details cache.  */
+static void
+details_cache_add (GpaKeyManager *self, gpgme_key_t key)
+{
+  struct details_entry_s *entry;
+
+  if (!key->subkeys || !key->subkeys->fpr)
+    return;
+
+  entry = g_hash_table_lookup (self->details_cache, key->subkeys->fpr);
+  if (entry)
+    details_cache_drop (self, entry);
+  else if (self->details_lru.length >= DETAILS_CACHE_SIZE)
+    details_cache_drop (self, self->details_lru.tail->data);
+
+  entry = g_malloc0 (sizeof *entry);
+  entry->link.data = entry;
+  entry->fpr = g_strdup (key->subkeys->fpr);
+  gpgme_key_ref (key);
+  entry->key = key;
+  g_queue_push_head_link (&self->details_lru, &entry->link);
+  g_hash_table_insert (self->details_cache, entry->fpr, entry);
+}
+
+
+/* Forget the cached details of the key with fingerprint FPR; or of
+   all keys if FPR is NULL.  */
+static void
+details_cache_invalidate (GpaKeyManager *self, const char *fpr)
+{
+  struct details_entry_s *entry;
+
+  if (fpr)
+    {
+      entry = g_hash_table_lookup (self->details_cache, fpr);
+      if (entry)
+        details_cache_drop (self, entry);
+    }
+  else
+    while (self->details_lru.head)
+      details_cache_drop (self, self->details_lru.head->data);
+}
+
+
+/* Start a listing with signatures of the keys with the fingerprints
+   FPRS.  */
+static void
+details_start_listing (GpaKeyManager *self, const char **fprs,
+                       gpgme_protocol_t protocol)
+{
+  gpg_error_t err;
+  int old_mode;
+
+  old_mode = gpgme_get_keylist_mode (self->ctx->ctx);
+
+  /* With all the signatures and validating for the sake of X.509.
+     Note that we should not save and restore the old protocol
+     because the protocol should not be changed before the
+     gpgme_op_keylist_end.  Saving and restoring the keylist mode
+     is okay. */
+  gpgme_set_keylist_mode (self->ctx->ctx,
+                          (old_mode
+#ifdef GPGME_KEYLIST_MODE_WITH_TOFU
+                           | GPGME_KEYLIST_MODE_WITH_TOFU
+#endif
+                           | GPGME_KEYLIST_MODE_SIGS
+                           | GPGME_KEYLIST_MODE_VALIDATE));
+  gpgme_set_protocol (self->ctx->ctx, protocol);
+  err = gpgme_op_keylist_ext_start (self->ctx->ctx, fprs, FALSE, 0);
+  if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
+    gpa_gpgme_warning (err);
+
+  gpgme_set_keylist_mode (self->ctx->ctx, old_mode);
+}
+
+
+/* List the keys next to the selected one so that they are
+   immediately available when the user moves on.  Only keys of the
+   same protocol as the first uncached one are listed at once.  */
+static void
+details_prefetch (GpaKeyManager *self)
+{
+  GList *keys, *item;
+  GPtrArray *fprs;
+  gpgme_protocol_t protocol = GPGME_PROTOCOL_UNKNOWN;
+
+  if (self->prefetched || self->details_fpr || gpa_context_busy (self->ctx))
+    return;
+  self->prefetched = TRUE;
+
+  keys = gpa_keylist_get_adjacent_keys (self->keylist, DETAILS_PREFETCH);
+  fprs = g_ptr_array_new ();
+  for (item = keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      if (!key->subkeys || !key->subkeys->fpr
+          || details_cache_lookup (self, key->subkeys->fpr))
+        continue;
+      if (protocol == GPGME_PROTOCOL_UNKNOWN)
+        protocol = key->protocol;
+      if (key->protocol == protocol)
+        g_ptr_array_add (fprs, key->subkeys->fpr);
+    }
+  g_list_free (keys);
+
+  if (fprs->len)
+    {
+      g_ptr_array_add (fprs, NULL);
+      details_start_listing (self, (const char **) fprs->pdata, protocol);
+    }
+  g_ptr_array_free (fprs, TRUE);
+}
+
+
+/* Make KEY the current key.  */
+static void
+details_set_current (GpaKeyManager *self, gpgme_key_t key)
+{
+  gpgme_key_ref (key);
+  gpgme_key_unref (self->current_key);
+  self->current_key = key;
+  g_free (self->details_fpr);
+  self->details_fpr = NULL;
+
+  keyring_selection_update_actions (self);
+}
+
+
+/* Timeout handler to list the selected key.  */
+static gboolean
+details_fetch_cb (gpointer param)
+{
+  GpaKeyManager *self = param;
+  const char *fprs[2];
+
+  self->details_fetch_id = 0;
+  if (!self->details_fpr)
+    return FALSE;
+
+  /* Abort a prefetch still running.  */
+  if (gpa_context_busy (self->ctx))
+    gpgme_op_keylist_end (self->ctx->ctx);
+
+  fprs[0] = self->details_fpr;
+  fprs[1] = NULL;
+  details_start_listing (self, fprs, self->details_protocol);
+
+  return FALSE;
+}
+
+
 /* Callback for key listings invoked with the "next_key" signal.  Used
    to receive and set the new current key.  */
 static void
@@ -674,10 +1187,22 @@ key_manager_key_listed (GpaContext *ctx, gpgme_key_t key, gpointer param)
 {
   GpaKeyManager *self = param;
 
-  gpgme_key_unref (self->current_key);
-  self->current_key = key;
+  details_cache_add (self, key);
+  if (self->details_fpr && key->subkeys
+      && !g_strcmp0 (key->subkeys->fpr, self->details_fpr))
+    details_set_current (self, key);
+  gpgme_key_unref (key);
+}
 
-  keyring_selection_update_actions (self);
+
+/* Callback for the "done" signal of the details context.  */
+static void
+key_manager_key_list_done (GpaContext *ctx, gpg_error_t err, gpointer param)
+{
+  GpaKeyManager *self = param;
+
+  if (!err && this_instance == self)
+    details_prefetch (self);
 }
 
 
@@ -700,43 +1225,35 @@ key_manager_selection_changed (GtkTreeSelection *treeselection,
       gpgme_key_unref (self->current_key);
       self->current_key = NULL;
     }
-
-  /* Abort retrieval of the current key.  */
-  if (gpa_context_busy (self->ctx))
-    gpgme_op_keylist_end (self->ctx->ctx);
+  g_free (self->details_fpr);
+  self->details_fpr = NULL;
+  self->prefetched = FALSE;
 
   /* Load the new one.  */
   if (gpa_keylist_has_single_selection (self->keylist)
       && (selection = gpa_keylist_get_selected_keys (self->keylist,
                                                      GPGME_PROTOCOL_UNKNOWN)))
     {
-      gpg_error_t err;
-      gpgme_key_t key;
-      int old_mode;
-
-      key = (gpgme_key_t) selection->data;
-      old_mode = gpgme_get_keylist_mode (self->ctx->ctx);
-
-      /* With all the signatures and validating for the sake of X.509.
-         Note that we should not save and restore the old protocol
-         because the protocol should not be changed before the
-         gpgme_op_keylist_end.  Saving and restoring the keylist mode
-         is okay. */
-      gpgme_set_keylist_mode (self->ctx->ctx,
-			      (old_mode
-#ifdef GPGME_KEYLIST_MODE_WITH_TOFU
-                               | GPGME_KEYLIST_MODE_WITH_TOFU
-#endif
-                               | GPGME_KEYLIST_MODE_SIGS
-                               | GPGME_KEYLIST_MODE_VALIDATE));
-      gpgme_set_protocol (self->ctx->ctx, key->protocol);
-      err = gpgme_op_keylist_start (self->ctx->ctx, key->subkeys->fpr,
-				    FALSE);
-      if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
-	gpa_gpgme_warning (err);
-
-      gpgme_set_keylist_mode (self->ctx->ctx, old_mode);
+      gpgme_key_t key = (gpgme_key_t) selection->data;
+      gpgme_key_t cached;
+
       g_list_free (selection);
+      cached = details_cache_lookup (self, key->subkeys->fpr);
+      if (cached)
+        {
+          details_set_current (self, cached);
+          details_prefetch (self);
+          return;
+        }
+
+      /* Delay the listing so that moving through the list does not
+         start a listing for each key passed.  */
+      self->details_fpr = g_strdup (key->subkeys->fpr);
+      self->details_protocol = key->protocol;
+      if (self->details_fetch_id)
+        g_source_remove (self->details_fetch_id);
+      self->details_fetch_id = g_timeout_add (DETAILS_FETCH_DELAY,
+                                              details_fetch_cb, self);
 
       /* Make sure the actions that depend on a current key are
 	 disabled.  */
@@ -966,7 +1483,7 @@ key_manager_refresh (GSimpleAction *simple, GVariant *parameter, gpointer user_d
      key has been imported.  */
   gpa_keylist_imported_secret_key (self->keylist);
 
-  gpa_keylist_start_reload (self->keylist);
+  key_manager_reload (self);
 }
 
 
@@ -1746,6 +2263,18 @@ keyring_default_key_changed (GpaOptions *options, gpointer param)
 }
 
 
+/* Signal handler for the "search-changed" signal of the filter
+   entry.  */
+static void
+key_manager_filter_changed (GtkSearchEntry *entry, gpointer param)
+{
+  GpaKeyManager *self = param;
+
+  gpa_keylist_set_filter (self->keylist,
+                          gtk_entry_get_text (GTK_ENTRY (entry)));
+}
+
+
 /* Create all the widgets of this window.  */
 static void
 construct_widgets (GpaKeyManager *self)
@@ -1758,6 +2287,7 @@ construct_widgets (GpaKeyManager *self)
   GtkWidget *toolbar;
   GtkWidget *hbox;
   GtkWidget *icon;
+  GtkWidget *entry;
   GtkWidget *paned;
   GtkWidget *statusbar;
   GtkWidget *main_box;
@@ -1800,6 +2330,15 @@ construct_widgets (GpaKeyManager *self)
   gtk_widget_set_halign (GTK_WIDGET (label), GTK_ALIGN_START);
   gtk_widget_set_valign (GTK_WIDGET (label), GTK_ALIGN_CENTER);
 
+  /* The filter entry narrows the list as you type.  */
+  entry = gtk_search_entry_new ();
+  gtk_entry_set_placeholder_text (GTK_ENTRY (entry), _("Filter"));
+  gtk_widget_set_tooltip_text
+    (entry, _("Show only the keys whose user names, email addresses,"
+              " key IDs or fingerprints contain this text."));
+  gtk_widget_set_valign (entry, GTK_ALIGN_CENTER);
+  gtk_box_pack_start (GTK_BOX (hbox), entry, FALSE, TRUE, 5);
+
   paned = gtk_paned_new (GTK_ORIENTATION_VERTICAL);
 
   main_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
@@ -1822,6 +2361,10 @@ construct_widgets (GpaKeyManager *self)
 
   keylist = gpa_keylist_new (GTK_WIDGET (self));
   self->keylist = GPA_KEYLIST (keylist);
+  /* The key list is loaded right away.  */
+  self->listing = TRUE;
+  g_signal_connect (G_OBJECT (keylist), "listing_done",
+                    G_CALLBACK (key_manager_listing_done), self);
   if (gpa_options_get_detailed_view (gpa_options_get_instance()))
     gpa_keylist_set_detailed (self->keylist);
   else
@@ -1839,6 +2382,10 @@ construct_widgets (GpaKeyManager *self)
   g_signal_connect_swapped (G_OBJECT (keylist), "button_press_event",
                             G_CALLBACK (display_popup_menu), self);
 
+  /* GtkSearchEntry delays the signal until typing pauses.  */
+  g_signal_connect (G_OBJECT (entry), "search-changed",
+                    G_CALLBACK (key_manager_filter_changed), self);
+
   self->details = gpa_key_details_new ();
   gtk_paned_pack2 (GTK_PANED (paned), self->details, TRUE, TRUE);
   gtk_paned_set_position (GTK_PANED (paned), 250);
@@ -1856,9 +2403,16 @@ construct_widgets (GpaKeyManager *self)
   self->current_key = NULL;
   self->ctx = gpa_context_new ();
   self->freeze_selection = 0;
+  self->pending_fprs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+  g_queue_init (&self->details_lru);
+  self->details_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  keyring_watch_init ();
 
   g_signal_connect (G_OBJECT (self->ctx), "next_key",
 		    G_CALLBACK (key_manager_key_listed), self);
+  g_signal_connect (G_OBJECT (self->ctx), "done",
+		    G_CALLBACK (key_manager_key_list_done), self);
 
 }
 
@@ -1867,6 +2421,23 @@ construct_widgets (GpaKeyManager *self)
 static void
 gpa_key_manager_closed (GtkWidget *widget, gpointer param)
 {
+  GpaKeyManager *self = param;
+
+  if (self->refresh_id)
+    {
+      g_source_remove (self->refresh_id);
+      self->refresh_id = 0;
+    }
+  if (self->reload_id)
+    {
+      g_source_remove (self->reload_id);
+      self->reload_id = 0;
+    }
+  if (self->details_fetch_id)
+    {
+      g_source_remove (self->details_fetch_id);
+      self->details_fetch_id = 0;
+    }
   this_instance = NULL;
 }
 
@@ -1905,6 +2476,17 @@ gpa_key_manager_finalize (GObject *object)
 
   g_list_free (self->selection_sensitive_actions);
   self->selection_sensitive_actions = NULL;
+  if (self->pending_fprs)
+    g_hash_table_destroy (self->pending_fprs);
+  self->pending_fprs = NULL;
+  if (self->details_cache)
+    {
+      details_cache_invalidate (self, NULL);
+      g_hash_table_destroy (self->details_cache);
+      self->details_cache = NULL;
+    }
+  g_free (self->details_fpr);
+  self->details_fpr = NULL;
 
   G_OBJECT_CLASS (g_type_class_peek_parent
                   (GPA_KEY_MANAGER_GET_CLASS (self)))->finalize (object);
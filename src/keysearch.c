@@ -0,0 +1,251 @@
+/* keysearch.c - Substring search over keys.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For each key the searchable strings are lowercased and joined by
+   newlines.  The index maps each trigram of these texts to the
+   ascending list of keys containing it.  A query looks up the
+   shortest posting list of its trigrams and verifies the candidates
+   with strstr.  Queries shorter than a trigram scan all texts.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gpa.h"
+#include "keysearch.h"
+
+
+struct gpa_key_search_s
+{
+  /* The keys and their searchable texts.  */
+  GPtrArray *keys;
+  GPtrArray *texts;
+  /* Maps trigrams to GArrays of guint32 key indices.  */
+  GHashTable *trigrams;
+};
+
+
+#define TRIGRAM(p) GUINT_TO_POINTER (((guint)(guchar)(p)[0] << 16)       \
+                                     | ((guint)(guchar)(p)[1] << 8)      \
+                                     | (guint)(guchar)(p)[2])
+
+
+/* Return the searchable text of KEY.  */
+static char *
+key_text (gpgme_key_t key)
+{
+  GString *text = g_string_new (NULL);
+  gpgme_user_id_t uid;
+  gpgme_subkey_t subkey;
+  char *result;
+
+  for (uid = key->uids; uid; uid = uid->next)
+    {
+      if (uid->uid)
+        {
+          g_string_append (text, uid->uid);
+          g_string_append_c (text, '\n');
+        }
+      /* The address is usually part of the user ID but not for
+         X.509 where the user ID is a DN.  */
+      if (uid->email && *uid->email
+          && !(uid->uid && strstr (uid->uid, uid->email)))
+        {
+          g_string_append (text, uid->email);
+          g_string_append_c (text, '\n');
+        }
+    }
+  /* The key IDs are suffixes of the fingerprints.  */
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      if (subkey->fpr)
+        g_string_append (text, subkey->fpr);
+      else if (subkey->keyid)
+        g_string_append (text, subkey->keyid);
+      g_string_append_c (text, '\n');
+    }
+
+  result = g_ascii_strdown (text->str, text->len);
+  g_string_free (text, TRUE);
+  return result;
+}
+
+
+/* Return the normalized form of the query TEXT or NULL if it is
+   empty.  */
+static char *
+normalize_query (const char *text)
+{
+  char *query;
+
+  if (!text)
+    return NULL;
+  while (g_ascii_isspace (*text))
+    text++;
+  /* Allow for key IDs written as 0x1234ABCD.  */
+  if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X') && text[2])
+    text += 2;
+  if (!*text)
+    return NULL;
+
+  query = g_ascii_strdown (text, -1);
+  g_strchomp (query);
+  return query;
+}
+
+
+/* Build an index over the keys in the array KEYS.  The index does not
+   take references; the keys must outlive it.  */
+gpa_key_search_t
+gpa_key_search_new (GPtrArray *keys)
+{
+  gpa_key_search_t search;
+  guint idx;
+
+  search = g_malloc0 (sizeof *search);
+  search->keys = g_ptr_array_sized_new (keys->len);
+  search->texts = g_ptr_array_new_full (keys->len, g_free);
+  search->trigrams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) g_array_unref);
+
+  for (idx = 0; idx < keys->len; idx++)
+    {
+      gpgme_key_t key = g_ptr_array_index (keys, idx);
+      char *text = key_text (key);
+      guint32 docid = search->keys->len;
+      const char *p;
+
+      g_ptr_array_add (search->keys, key);
+      g_ptr_array_add (search->texts, text);
+
+      for (p = text; p[0] && p[1] && p[2]; p++)
+        {
+          GArray *postings;
+
+          if (p[0] == '\n' || p[1] == '\n' || p[2] == '\n')
+            continue;
+          postings = g_hash_table_lookup (search->trigrams, TRIGRAM (p));
+          if (!postings)
+            {
+              postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+              g_hash_table_insert (search->trigrams, TRIGRAM (p), postings);
+            }
+          /* Each key is added only once to a list.  */
+          if (!postings->len
+              || g_array_index (postings, guint32, postings->len - 1) != docid)
+            g_array_append_val (postings, docid);
+        }
+    }
+
+  return search;
+}
+
+
+/* Release SEARCH.  */
+void
+gpa_key_search_release (gpa_key_search_t search)
+{
+  if (!search)
+    return;
+  g_hash_table_destroy (search->trigrams);
+  g_ptr_array_free (search->texts, TRUE);
+  g_ptr_array_free (search->keys, TRUE);
+  g_free (search);
+}
+
+
+/* Return a set with all keys of SEARCH matching TEXT.  The caller must
+   release the returned hash table.  */
+GHashTable *
+gpa_key_search_find (gpa_key_search_t search, const char *text)
+{
+  GHashTable *result;
+  char *query;
+  size_t len;
+  guint idx;
+
+  result = g_hash_table_new (g_direct_hash, g_direct_equal);
+  query = normalize_query (text);
+  if (!query)
+    {
+      for (idx = 0; idx < search->keys->len; idx++)
+        g_hash_table_add (result, g_ptr_array_index (search->keys, idx));
+      return result;
+    }
+
+  len = strlen (query);
+  if (len < 3)
+    {
+      for (idx = 0; idx < search->keys->len; idx++)
+        if (strstr (g_ptr_array_index (search->texts, idx), query))
+          g_hash_table_add (result, g_ptr_array_index (search->keys, idx));
+    }
+  else
+    {
+      GArray *best = NULL;
+      const char *p;
+
+      for (p = query; p[2]; p++)
+        {
+          GArray *postings;
+
+          postings = g_hash_table_lookup (search->trigrams, TRIGRAM (p));
+          if (!postings)
+            {
+              best = NULL;
+              break;
+            }
+          if (!best || postings->len < best->len)
+            best = postings;
+        }
+
+      for (idx = 0; best && idx < best->len; idx++)
+        {
+          guint32 docid = g_array_index (best, guint32, idx);
+
+          if (strstr (g_ptr_array_index (search->texts, docid), query))
+            g_hash_table_add (result, g_ptr_array_index (search->keys, docid));
+        }
+    }
+
+  g_free (query);
+  return result;
+}
+
+
+/* Return true if KEY matches TEXT.  This is for keys not covered by
+   an index.  */
+gboolean
+gpa_key_search_match_key (gpgme_key_t key, const char *text)
+{
+  char *query, *keytext;
+  gboolean match;
+
+  query = normalize_query (text);
+  if (!query)
+    return TRUE;
+  keytext = key_text (key);
+  match = !!strstr (keytext, query);
+  g_free (keytext);
+  g_free (query);
+  return match;
+}
@@ -0,0 +1,46 @@
+/* keysearch.h - Substring search over keys.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYSEARCH_H
+#define KEYSEARCH_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+/* A trigram index over the user IDs, mail addresses, fingerprints and
+   key IDs of a set of keys.  Matching is case insensitive for ASCII
+   letters.  */
+typedef struct gpa_key_search_s *gpa_key_search_t;
+
+/* Build an index over the keys in the array KEYS.  The index does not
+   take references; the keys must outlive it.  */
+gpa_key_search_t gpa_key_search_new (GPtrArray *keys);
+
+/* Release SEARCH.  */
+void gpa_key_search_release (gpa_key_search_t search);
+
+/* Return a set with all keys of SEARCH matching TEXT.  The caller must
+   release the returned hash table.  */
+GHashTable *gpa_key_search_find (gpa_key_search_t search, const char *text);
+
+/* Return true if KEY matches TEXT.  This is for keys not covered by
+   an index.  */
+gboolean gpa_key_search_match_key (gpgme_key_t key, const char *text);
+
+#endif /*KEYSEARCH_H*/
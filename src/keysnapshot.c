@@ -0,0 +1,360 @@
+/* keysnapshot.c - On-disk snapshot of the key list.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The snapshot file is a cache private to this host; thus all
+   numbers are stored in host byte order.  The layout is:
+
+     struct snapshot_header_s
+     struct snapshot_record_s [n_entries]
+     string pool
+
+   Strings are referenced by their offset into the string pool;
+   NO_STRING denotes a NULL pointer.  The header contains the
+   modification time and size of the keyring files and the trustdb
+   from the time the snapshot was written.  The snapshot is ignored
+   if any of them differ.  GnuPG does not offer a cheap way to get
+   the trustdb generation, thus the trustdb's stamp is used
+   instead.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <glib/gstdio.h>
+
+#include "gpa.h"
+#include "membuf.h"
+#include "keysnapshot.h"
+
+
+#define SNAPSHOT_NAME   "gpa-keylist.snapshot"
+#define SNAPSHOT_MAGIC  "GPAKSNP2"
+#define SNAPSHOT_BOM    0x01020304
+#define NO_STRING       0xffffffff
+
+/* The files whose state determines the validity of the snapshot.
+   They are also watched by the key manager and checked by the
+   recipient cache.  */
+const char *gpa_keyring_files[GPA_KEYRING_N_FILES + 1] =
+  {
+    "pubring.kbx",
+    "pubring.gpg",
+    "secring.gpg",
+    "private-keys-v1.d",
+    "trustdb.gpg",
+    NULL
+  };
+
+struct snapshot_header_s
+{
+  char magic[8];
+  guint32 bom;
+  guint32 n_entries;
+  guint32 pool_size;
+  guint32 cms_hack;
+  struct gpa_keyring_stamp_s stamp;
+  char locale[64];
+};
+
+/* The order of the string offsets matches the order of the string
+   fields in struct gpa_key_snapshot_entry_s.  */
+enum
+  {
+    STR_FPR,
+    STR_ICON,
+    STR_KEYTYPE,
+    STR_CREATED,
+    STR_EXPIRY,
+    STR_OWNERTRUST,
+    STR_VALIDITY,
+    STR_USERID,
+    N_STRINGS
+  };
+
+struct snapshot_record_s
+{
+  guint32 str[N_STRINGS];
+  guint32 has_secret;
+  guint32 reserved;
+  guint64 created_ts;
+  guint64 expiry_ts;
+  guint64 ownertrust_value;
+  gint64 validity_value;
+};
+
+struct gpa_key_snapshot_s
+{
+  GMappedFile *file;
+  const struct snapshot_record_s *records;
+  unsigned int n_entries;
+  const char *pool;
+  guint32 pool_size;
+};
+
+
+
+/* Store the current state of the keyring files at STAMP.  The
+   nanoseconds of the modification time are used where available
+   because the trustdb is updated in place and an update within the
+   same second does not change its size.  */
+void
+gpa_keyring_stamp (struct gpa_keyring_stamp_s *stamp)
+{
+  int idx;
+
+  memset (stamp, 0, sizeof *stamp);
+  for (idx = 0; gpa_keyring_files[idx]; idx++)
+    {
+      char *fname = g_build_filename (gnupg_homedir,
+                                      gpa_keyring_files[idx], NULL);
+      GStatBuf st;
+
+      if (!g_stat (fname, &st))
+        {
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+          stamp->file[idx][0] = ((guint64)st.st_mtim.tv_sec * 1000000000
+                                 + st.st_mtim.tv_nsec);
+#else
+          stamp->file[idx][0] = (guint64)st.st_mtime * 1000000000;
+#endif
+          stamp->file[idx][1] = st.st_size;
+        }
+      g_free (fname);
+    }
+}
+
+
+/* Fill HDR with everything but the counters.  */
+static void
+init_header (struct snapshot_header_s *hdr)
+{
+  const char *locale;
+
+  memset (hdr, 0, sizeof *hdr);
+  memcpy (hdr->magic, SNAPSHOT_MAGIC, sizeof hdr->magic);
+  hdr->bom = SNAPSHOT_BOM;
+  hdr->cms_hack = !!cms_hack;
+  gpa_keyring_stamp (&hdr->stamp);
+
+  /* The translated strings depend on the locale.  */
+  locale = setlocale (LC_MESSAGES, NULL);
+  if (locale)
+    g_strlcpy (hdr->locale, locale, sizeof hdr->locale);
+}
+
+
+static const char *
+get_string (gpa_key_snapshot_t snapshot, guint32 off)
+{
+  if (off == NO_STRING || off >= snapshot->pool_size)
+    return NULL;
+  return snapshot->pool + off;
+}
+
+
+/* Open the snapshot file.  Returns NULL if there is no snapshot or if
+   it does not match the current state of the keyring.  */
+gpa_key_snapshot_t
+gpa_key_snapshot_open (void)
+{
+  struct snapshot_header_s current, hdr;
+  gpa_key_snapshot_t snapshot;
+  GMappedFile *file;
+  char *fname;
+  const char *buf;
+  gsize len, need;
+
+  fname = g_build_filename (gnupg_homedir, SNAPSHOT_NAME, NULL);
+  file = g_mapped_file_new (fname, FALSE, NULL);
+  g_free (fname);
+  if (!file)
+    return NULL;
+
+  buf = g_mapped_file_get_contents (file);
+  len = g_mapped_file_get_length (file);
+  if (len < sizeof hdr)
+    goto leave;
+  memcpy (&hdr, buf, sizeof hdr);
+
+  init_header (&current);
+  current.n_entries = hdr.n_entries;
+  current.pool_size = hdr.pool_size;
+  if (memcmp (&hdr, &current, sizeof hdr))
+    goto leave;
+
+  need = (sizeof hdr + (gsize)hdr.n_entries * sizeof (struct snapshot_record_s)
+          + hdr.pool_size);
+  if (hdr.n_entries > len / sizeof (struct snapshot_record_s)
+      || need != len
+      || (hdr.pool_size && buf[len - 1]))
+    goto leave;
+
+  snapshot = g_malloc0 (sizeof *snapshot);
+  snapshot->file = file;
+  snapshot->n_entries = hdr.n_entries;
+  snapshot->records = (const void *)(buf + sizeof hdr);
+  snapshot->pool = buf + len - hdr.pool_size;
+  snapshot->pool_size = hdr.pool_size;
+  return snapshot;
+
+ leave:
+  g_mapped_file_unref (file);
+  return NULL;
+}
+
+
+/* Return the number of entries in SNAPSHOT.  */
+unsigned int
+gpa_key_snapshot_count (gpa_key_snapshot_t snapshot)
+{
+  return snapshot? snapshot->n_entries : 0;
+}
+
+
+/* Store the entry with index IDX of SNAPSHOT at R_ENTRY.  The strings
+   are valid until the snapshot is closed.  */
+void
+gpa_key_snapshot_get (gpa_key_snapshot_t snapshot, unsigned int idx,
+                      gpa_key_snapshot_entry_t r_entry)
+{
+  struct snapshot_record_s rec;
+
+  g_return_if_fail (snapshot && idx < snapshot->n_entries);
+
+  /* The mapped records might not be properly aligned.  */
+  memcpy (&rec, snapshot->records + idx, sizeof rec);
+
+  r_entry->fpr        = get_string (snapshot, rec.str[STR_FPR]);
+  r_entry->icon       = get_string (snapshot, rec.str[STR_ICON]);
+  r_entry->keytype    = get_string (snapshot, rec.str[STR_KEYTYPE]);
+  r_entry->created    = get_string (snapshot, rec.str[STR_CREATED]);
+  r_entry->expiry     = get_string (snapshot, rec.str[STR_EXPIRY]);
+  r_entry->ownertrust = get_string (snapshot, rec.str[STR_OWNERTRUST]);
+  r_entry->validity   = get_string (snapshot, rec.str[STR_VALIDITY]);
+  r_entry->userid     = get_string (snapshot, rec.str[STR_USERID]);
+  r_entry->has_secret = rec.has_secret;
+  r_entry->created_ts = rec.created_ts;
+  r_entry->expiry_ts  = rec.expiry_ts;
+  r_entry->ownertrust_value = rec.ownertrust_value;
+  r_entry->validity_value = rec.validity_value;
+}
+
+
+/* Release SNAPSHOT.  */
+void
+gpa_key_snapshot_close (gpa_key_snapshot_t snapshot)
+{
+  if (!snapshot)
+    return;
+  g_mapped_file_unref (snapshot->file);
+  g_free (snapshot);
+}
+
+
+/* Append STRING to the string POOL and return its offset.  Identical
+   strings (e.g. dates and validity strings) are stored only once.  */
+static guint32
+add_string (membuf_t *pool, GHashTable *seen, const char *string)
+{
+  gpointer value;
+  guint32 off;
+
+  if (!string)
+    return NO_STRING;
+  if (g_hash_table_lookup_extended (seen, string, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  off = get_membuf_len (pool);
+  put_membuf (pool, string, strlen (string) + 1);
+  g_hash_table_insert (seen, (char *)string, GUINT_TO_POINTER (off));
+  return off;
+}
+
+
+/* Write a new snapshot with the N entries from ENTRIES.  Errors are
+   ignored because the snapshot is only an optimization.  */
+void
+gpa_key_snapshot_write (const struct gpa_key_snapshot_entry_s *entries,
+                        unsigned int n)
+{
+  struct snapshot_header_s hdr;
+  struct snapshot_record_s *records;
+  membuf_t pool;
+  GHashTable *seen;
+  char *poolbuf;
+  size_t poolsize;
+  GString *file;
+  char *fname;
+  unsigned int idx;
+
+  records = g_new0 (struct snapshot_record_s, n? n : 1);
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  init_membuf (&pool, 4096);
+
+  for (idx = 0; idx < n; idx++)
+    {
+      const struct gpa_key_snapshot_entry_s *e = entries + idx;
+      struct snapshot_record_s *rec = records + idx;
+
+      rec->str[STR_FPR]        = add_string (&pool, seen, e->fpr);
+      rec->str[STR_ICON]       = add_string (&pool, seen, e->icon);
+      rec->str[STR_KEYTYPE]    = add_string (&pool, seen, e->keytype);
+      rec->str[STR_CREATED]    = add_string (&pool, seen, e->created);
+      rec->str[STR_EXPIRY]     = add_string (&pool, seen, e->expiry);
+      rec->str[STR_OWNERTRUST] = add_string (&pool, seen, e->ownertrust);
+      rec->str[STR_VALIDITY]   = add_string (&pool, seen, e->validity);
+      rec->str[STR_USERID]     = add_string (&pool, seen, e->userid);
+      rec->has_secret = !!e->has_secret;
+      rec->created_ts = e->created_ts;
+      rec->expiry_ts = e->expiry_ts;
+      rec->ownertrust_value = e->ownertrust_value;
+      rec->validity_value = e->validity_value;
+    }
+  g_hash_table_destroy (seen);
+
+  poolbuf = get_membuf (&pool, &poolsize);
+  if (!poolbuf)
+    {
+      g_free (records);
+      return;
+    }
+
+  init_header (&hdr);
+  hdr.n_entries = n;
+  hdr.pool_size = poolsize;
+
+  file = g_string_sized_new (sizeof hdr + n * sizeof *records + poolsize);
+  g_string_append_len (file, (const char *)&hdr, sizeof hdr);
+  g_string_append_len (file, (const char *)records, n * sizeof *records);
+  g_string_append_len (file, poolbuf, poolsize);
+  g_free (records);
+  g_free (poolbuf);
+
+  /* g_file_set_contents writes to a temporary file first; thus a
+     reader never sees a partial snapshot.  */
+  fname = g_build_filename (gnupg_homedir, SNAPSHOT_NAME, NULL);
+  if (!g_file_set_contents (fname, file->str, file->len, NULL))
+    g_debug ("error writing key list snapshot `%s'", fname);
+  g_free (fname);
+  g_string_free (file, TRUE);
+}
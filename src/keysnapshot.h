@@ -0,0 +1,87 @@
+/* keysnapshot.h - On-disk snapshot of the key list.
+ * Copyright (C) 2026 g10 Code GmbH.
+ *
+ * This file is part of GPA.
+ *
+ * GPA is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * GPA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The snapshot stores the display fields of the key list so that the
+   key manager can show the keys right at startup.  It is only used
+   as long as the keyring files did not change.  */
+
+#ifndef KEYSNAPSHOT_H
+#define KEYSNAPSHOT_H
+
+#include <glib.h>
+
+/* The display fields of one key.  Strings may be NULL.  */
+struct gpa_key_snapshot_entry_s
+{
+  const char *fpr;
+  const char *icon;
+  const char *keytype;
+  const char *created;
+  const char *expiry;
+  const char *ownertrust;
+  const char *validity;
+  const char *userid;
+  int has_secret;
+  unsigned long created_ts;
+  unsigned long expiry_ts;
+  unsigned long ownertrust_value;
+  long validity_value;
+};
+typedef struct gpa_key_snapshot_entry_s *gpa_key_snapshot_entry_t;
+
+typedef struct gpa_key_snapshot_s *gpa_key_snapshot_t;
+
+/* The files in the GnuPG home directory which hold the keys and
+   their trust.  The list is NULL terminated.  */
+extern const char *gpa_keyring_files[];
+#define GPA_KEYRING_N_FILES 5
+
+/* The state of the keyring files: the modification time in
+   nanoseconds and the size of each file in gpa_keyring_files.  A
+   missing file is stored as zeroes.  */
+struct gpa_keyring_stamp_s
+{
+  guint64 file[GPA_KEYRING_N_FILES][2];
+};
+
+
+/* Store the current state of the keyring files at STAMP.  */
+void gpa_keyring_stamp (struct gpa_keyring_stamp_s *stamp);
+
+
+/* Open the snapshot file.  Returns NULL if there is no snapshot or if
+   it does not match the current state of the keyring.  */
+gpa_key_snapshot_t gpa_key_snapshot_open (void);
+
+/* Return the number of entries in SNAPSHOT.  */
+unsigned int gpa_key_snapshot_count (gpa_key_snapshot_t snapshot);
+
+/* Store the entry with index IDX of SNAPSHOT at R_ENTRY.  The strings
+   are valid until the snapshot is closed.  */
+void gpa_key_snapshot_get (gpa_key_snapshot_t snapshot, unsigned int idx,
+                           gpa_key_snapshot_entry_t r_entry);
+
+/* Release SNAPSHOT.  */
+void gpa_key_snapshot_close (gpa_key_snapshot_t snapshot);
+
+/* Write a new snapshot with the N entries from ENTRIES.  */
+void gpa_key_snapshot_write (const struct gpa_key_snapshot_entry_s *entries,
+                             unsigned int n);
+
+#endif /*KEYSNAPSHOT_H*/
@@ -27,16 +27,22 @@
 #include "gtktools.h"
 
 /* Internal */
-static void first_half_done_cb (GpaContext *context, gpg_error_t err,
-                                GpaKeyTable *keytable);
+static void pgp_done_cb (GpaContext *context, gpg_error_t err,
+                         GpaKeyTable *keytable);
+static void cms_done_cb (GpaContext *context, gpg_error_t err,
+                         GpaKeyTable *keytable);
 static void next_key_cb (GpaContext *context, gpgme_key_t key,
 			 GpaKeyTable *keytable);
+static void next_cms_key_cb (GpaContext *context, gpgme_key_t key,
+                             GpaKeyTable *keytable);
 
 /* GObject type functions */
 
 static void gpa_keytable_init (GpaKeyTable *keytable);
 static void gpa_keytable_class_init (GpaKeyTableClass *klass);
 static void gpa_keytable_finalize (GObject *object);
+static void release_key_array (GPtrArray *array);
+static void release_waiters (GpaKeyTable *keytable);
 
 static GObjectClass *parent_class = NULL;
 
@@ -86,20 +92,30 @@ gpa_keytable_init (GpaKeyTable *keytable)
   keytable->next = NULL;
   keytable->end = NULL;
   keytable->data = NULL;
-  keytable->did_first_half = 0;
-  keytable->first_half_err = 0;
+  keytable->pending = 0;
+  keytable->pgp_err = 0;
+  keytable->cms_err = 0;
   keytable->context = gpa_context_new ();
-  keytable->keys = NULL;
+  keytable->cms_context = gpa_context_new ();
+  keytable->keys = g_ptr_array_new ();
   keytable->secret = FALSE;
   keytable->initialized = FALSE;
   keytable->new_key = FALSE;
-  keytable->tmp_list = NULL;
+  keytable->refresh = FALSE;
+  keytable->patterns = NULL;
+  keytable->tmp_keys = NULL;
+  keytable->tmp_cms_keys = NULL;
+  keytable->index = g_hash_table_new (g_str_hash, g_str_equal);
   /* Note, that the next_key and done signals are emitted by means of
      gpgme events with the help of gpacontext.c:gpa_context_event_cb.  */
   g_signal_connect (G_OBJECT (keytable->context), "next_key",
 		    G_CALLBACK (next_key_cb), keytable);
   g_signal_connect (G_OBJECT (keytable->context), "done",
-		    G_CALLBACK (first_half_done_cb), keytable);
+		    G_CALLBACK (pgp_done_cb), keytable);
+  g_signal_connect (G_OBJECT (keytable->cms_context), "next_key",
+		    G_CALLBACK (next_cms_key_cb), keytable);
+  g_signal_connect (G_OBJECT (keytable->cms_context), "done",
+		    G_CALLBACK (cms_done_cb), keytable);
 }
 
 static void
@@ -108,25 +124,309 @@ gpa_keytable_finalize (GObject *object)
   GpaKeyTable *keytable = GPA_KEYTABLE (object);
 
   g_object_unref (keytable->context);
-  g_list_foreach (keytable->keys, (GFunc) gpgme_key_unref, NULL);
-  g_list_free (keytable->keys);
+  g_object_unref (keytable->cms_context);
+  g_hash_table_destroy (keytable->index);
+  gpa_key_search_release (keytable->search);
+  release_key_array (keytable->keys);
+  if (keytable->tmp_keys)
+    release_key_array (keytable->tmp_keys);
+  if (keytable->tmp_cms_keys)
+    release_key_array (keytable->tmp_cms_keys);
+  g_strfreev (keytable->patterns);
+  release_waiters (keytable);
 }
 
 /* Internal functions */
 
+/* A callback registered with gpa_keytable_when_ready.  */
+struct waiter_s
+{
+  GpaKeyTableReadyFunc func;
+  gpointer data;
+};
+
+
+/* A key listing which waits for the running listing to finish.  */
+struct deferred_list_s
+{
+  GpaKeyTableNextFunc next;
+  GpaKeyTableEndFunc end;
+  gpointer data;
+};
+
+
+/* Drop all waiting callbacks without calling them.  */
+static void
+release_waiters (GpaKeyTable *keytable)
+{
+  if (keytable->ready_id)
+    {
+      g_source_remove (keytable->ready_id);
+      keytable->ready_id = 0;
+    }
+  g_slist_free_full (keytable->waiters, g_free);
+  keytable->waiters = NULL;
+}
+
+
+/* Call all callbacks waiting for KEYTABLE in the order they have been
+   registered.  Callbacks registered meanwhile are kept for the next
+   round.  */
+static void
+run_waiters (GpaKeyTable *keytable)
+{
+  GSList *waiters, *item;
+
+  if (keytable->ready_id)
+    {
+      g_source_remove (keytable->ready_id);
+      keytable->ready_id = 0;
+    }
+  waiters = g_slist_reverse (keytable->waiters);
+  keytable->waiters = NULL;
+  for (item = waiters; item; item = item->next)
+    {
+      struct waiter_s *waiter = item->data;
+
+      waiter->func (keytable, waiter->data);
+      g_free (waiter);
+    }
+  g_slist_free (waiters);
+}
+
+
+static gboolean
+ready_idle_cb (gpointer data)
+{
+  GpaKeyTable *keytable = data;
+
+  keytable->ready_id = 0;
+  /* If a listing has been started meanwhile, done_cb runs the
+     waiters.  */
+  if (!keytable->pending)
+    run_waiters (keytable);
+  return FALSE;
+}
+
+
+/* Run the waiters of KEYTABLE from the main loop.  */
 static void
-reload_cache (GpaKeyTable *keytable, const char *fpr)
+schedule_waiters (GpaKeyTable *keytable)
+{
+  if (keytable->waiters && !keytable->ready_id)
+    keytable->ready_id = g_idle_add (ready_idle_cb, keytable);
+}
+
+/* Release all keys in ARRAY and ARRAY itself.  */
+static void
+release_key_array (GPtrArray *array)
+{
+  guint idx;
+
+  for (idx = 0; idx < array->len; idx++)
+    gpgme_key_unref ((gpgme_key_t) g_ptr_array_index (array, idx));
+  g_ptr_array_free (array, TRUE);
+}
+
+
+/* Return true if FPR is all zero.  gpg uses this for keys it can't
+   cope with.  */
+static int
+is_zero_fpr (const char *fpr)
+{
+  for (; *fpr; fpr++)
+    if (*fpr != '0')
+      return 0;
+  return 1;
+}
+
+
+/* Add KEY to the fingerprint index of KEYTABLE.  The primary key's
+   fingerprint and key ID take precedence over those of subkeys
+   belonging to other keys.  Note that we always use replace to make
+   sure the hash key points into the memory of the key stored as
+   value.  */
+static void
+index_add_key (GpaKeyTable *keytable, gpgme_key_t key)
+{
+  gpgme_subkey_t subkey;
+
+  if (!key->subkeys)
+    return;
+
+  subkey = key->subkeys;
+  if (subkey->fpr)
+    g_hash_table_replace (keytable->index, subkey->fpr, key);
+  if (subkey->keyid)
+    g_hash_table_replace (keytable->index, subkey->keyid, key);
+
+  for (subkey = subkey->next; subkey; subkey = subkey->next)
+    {
+      if (subkey->fpr
+          && !g_hash_table_lookup (keytable->index, subkey->fpr))
+        g_hash_table_replace (keytable->index, subkey->fpr, key);
+      if (subkey->keyid
+          && !g_hash_table_lookup (keytable->index, subkey->keyid))
+        g_hash_table_replace (keytable->index, subkey->keyid, key);
+    }
+}
+
+
+/* Remove the entries of KEY from the fingerprint index of KEYTABLE.
+   Entries of a subkey shared with another key are not restored for
+   that other key.  */
+static void
+index_remove_key (GpaKeyTable *keytable, gpgme_key_t key)
+{
+  gpgme_subkey_t subkey;
+
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      if (subkey->fpr
+          && g_hash_table_lookup (keytable->index, subkey->fpr) == key)
+        g_hash_table_remove (keytable->index, subkey->fpr);
+      if (subkey->keyid
+          && g_hash_table_lookup (keytable->index, subkey->keyid) == key)
+        g_hash_table_remove (keytable->index, subkey->keyid);
+    }
+}
+
+
+/* Drop the search index of KEYTABLE after a change of KEYTABLE->KEYS.
+   It is rebuilt by the next search.  */
+static void
+invalidate_search (GpaKeyTable *keytable)
+{
+  gpa_key_search_release (keytable->search);
+  keytable->search = NULL;
+  keytable->generation++;
+}
+
+
+/* Rebuild the fingerprint index from the list of keys.  This needs to
+   be called after KEYTABLE->KEYS has been replaced.  */
+static void
+rebuild_index (GpaKeyTable *keytable)
+{
+  guint idx;
+
+  g_hash_table_remove_all (keytable->index);
+  for (idx = 0; idx < keytable->keys->len; idx++)
+    index_add_key (keytable,
+                   (gpgme_key_t) g_ptr_array_index (keytable->keys, idx));
+  invalidate_search (keytable);
+}
+
+
+/* Remove all keys from KEYTABLE->KEYS which are superseded by a key
+   in NEWKEYS with the same primary fingerprint and protocol.  If
+   PATTERNS is not NULL all keys matching one of these fingerprints
+   are removed as well.  This requires an up-to-date index; the
+   entries of the removed keys are removed from it.  */
+static void
+remove_superseded_keys (GpaKeyTable *keytable, GPtrArray *newkeys,
+                        char **patterns)
+{
+  GHashTable *drop = NULL;
+  guint idx, n;
+
+  for (idx = 0; patterns && patterns[idx]; idx++)
+    {
+      gpgme_key_t old = g_hash_table_lookup (keytable->index, patterns[idx]);
+
+      if (old)
+        {
+          if (!drop)
+            drop = g_hash_table_new (g_direct_hash, g_direct_equal);
+          g_hash_table_add (drop, old);
+        }
+    }
+
+  for (idx = 0; idx < newkeys->len; idx++)
+    {
+      gpgme_key_t key = (gpgme_key_t) g_ptr_array_index (newkeys, idx);
+      gpgme_key_t old;
+
+      if (!key->subkeys || !key->subkeys->fpr
+          || is_zero_fpr (key->subkeys->fpr))
+        continue;
+      old = g_hash_table_lookup (keytable->index, key->subkeys->fpr);
+      if (old && old->protocol == key->protocol && old->subkeys
+          && g_str_equal (old->subkeys->fpr, key->subkeys->fpr))
+        {
+          if (!drop)
+            drop = g_hash_table_new (g_direct_hash, g_direct_equal);
+          g_hash_table_add (drop, old);
+        }
+    }
+  if (!drop)
+    return;
+
+  /* Compact the array in place to keep the order of the keys.  */
+  for (idx = n = 0; idx < keytable->keys->len; idx++)
+    {
+      gpointer key = g_ptr_array_index (keytable->keys, idx);
+
+      if (g_hash_table_contains (drop, key))
+        {
+          index_remove_key (keytable, (gpgme_key_t) key);
+          gpgme_key_unref ((gpgme_key_t) key);
+        }
+      else
+        keytable->keys->pdata[n++] = key;
+    }
+  g_ptr_array_set_size (keytable->keys, n);
+  g_hash_table_destroy (drop);
+}
+
+
+/* Handle an error from starting the X.509 key listing.  */
+static void
+cms_start_error (gpg_error_t err)
+{
+  if ((gpg_err_code (err) == GPG_ERR_INV_ENGINE
+       || gpg_err_code (err) == GPG_ERR_UNSUPPORTED_PROTOCOL)
+      && gpg_err_source (err) == GPG_ERR_SOURCE_GPGME)
+    {
+      if (gpg_err_code (err) == GPG_ERR_UNSUPPORTED_PROTOCOL)
+        g_message ("Note: Please check libgpgme has "
+                   "been build with support for CMS");
+      gpa_window_error
+        (_("It seems that no CMS engine is installed.\n\n"
+           "Temporary disabling support for X.509.\n\n"
+           "Please install a CMS engine or invoke this program\n"
+           "with the option --disable-x509 ."), NULL);
+      cms_hack = 0;
+    }
+  else
+    gpa_gpgme_warning (err);
+}
+
+
+/* Start a listing of the keys matching PATTERNS or of all keys if
+   PATTERNS is NULL.  PATTERNS is copied.  The OpenPGP and, if
+   enabled, the X.509 listing are run at the same time.  */
+static void
+reload_cache (GpaKeyTable *keytable, const char **patterns)
 {
   gpg_error_t err;
 
-  /* We select the Open PGP protocol here.  At the end
-     first_half_done_cb will do another keylist_start for X,509.  */
-  keytable->did_first_half = 0;
-  keytable->first_half_err = 0;
-  keytable->fpr = fpr;
+  keytable->pending = 0;
+  keytable->pgp_err = 0;
+  keytable->cms_err = 0;
+  g_strfreev (keytable->patterns);
+  keytable->patterns = patterns? g_strdupv ((char **) patterns) : NULL;
+  if (keytable->tmp_keys)
+    release_key_array (keytable->tmp_keys);
+  keytable->tmp_keys = g_ptr_array_new ();
+  if (keytable->tmp_cms_keys)
+    release_key_array (keytable->tmp_cms_keys);
+  keytable->tmp_cms_keys = g_ptr_array_new ();
+
   gpgme_set_protocol (keytable->context->ctx, GPGME_PROTOCOL_OpenPGP);
-  err = gpgme_op_keylist_start (keytable->context->ctx, fpr,
-				keytable->secret);
+  err = gpgme_op_keylist_ext_start (keytable->context->ctx,
+                                    (const char **) keytable->patterns,
+                                    keytable->secret, 0);
   if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
     {
       gpa_gpgme_warning (err);
@@ -134,111 +434,135 @@ reload_cache (GpaKeyTable *keytable, const char *fpr)
 	{
 	  keytable->end (keytable->data);
 	}
+      schedule_waiters (keytable);
       return;
     }
-  keytable->tmp_list = NULL;
+  keytable->pending++;
+
+  if (cms_hack)
+    {
+      gpgme_set_protocol (keytable->cms_context->ctx, GPGME_PROTOCOL_CMS);
+      err = gpgme_op_keylist_ext_start (keytable->cms_context->ctx,
+                                        (const char **) keytable->patterns,
+                                        keytable->secret, 0);
+      if (err)
+        cms_start_error (err);
+      else
+        keytable->pending++;
+    }
 }
 
 static void
-done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
+done_cb (GpaKeyTable *keytable)
 {
-  if (err || keytable->first_half_err)
+  guint idx;
+
+  if (keytable->pgp_err || keytable->cms_err)
     {
-      if (keytable->first_half_err)
-        gpa_gpgme_warning (keytable->first_half_err);
-      if (err)
-        gpa_gpgme_warning (err);
+      if (keytable->pgp_err)
+        gpa_gpgme_warning (keytable->pgp_err);
+      if (keytable->cms_err)
+        gpa_gpgme_warning (keytable->cms_err);
+      keytable->new_key = FALSE;
+      keytable->refresh = FALSE;
+      /* Tell the caller that we are done so that it does not wait
+         forever.  */
+      if (keytable->end)
+        keytable->end (keytable->data);
+      run_waiters (keytable);
       return;
     }
-  /* Reverse the list to have the keys come up in the same order they
-   * were listed */
-  keytable->tmp_list = g_list_reverse (keytable->tmp_list);
+
+  /* Merge the X.509 keys after the OpenPGP keys so that the order
+     does not depend on which listing finished first.  */
+  for (idx = 0; idx < keytable->tmp_cms_keys->len; idx++)
+    g_ptr_array_add (keytable->tmp_keys,
+                     g_ptr_array_index (keytable->tmp_cms_keys, idx));
+  g_ptr_array_set_size (keytable->tmp_cms_keys, 0);
+
   if (keytable->new_key)
     {
-      /* Append the new key(s)
+      /* Append the new key(s) and drop the old versions of them.
        */
-      keytable->keys = g_list_concat (keytable->keys, keytable->tmp_list);
+      GPtrArray *newkeys = keytable->tmp_keys;
+
+      remove_superseded_keys (keytable, newkeys,
+                              keytable->refresh? keytable->patterns : NULL);
+      for (idx = 0; idx < newkeys->len; idx++)
+        {
+          gpgme_key_t key = g_ptr_array_index (newkeys, idx);
+
+          g_ptr_array_add (keytable->keys, key);
+          index_add_key (keytable, key);
+        }
+      g_ptr_array_free (newkeys, TRUE);
+      keytable->new_key = FALSE;
+      keytable->refresh = FALSE;
+      invalidate_search (keytable);
     }
   else
     {
       /* Replace the list
        */
-      if (keytable->keys)
-	{
-	  g_list_foreach (keytable->keys, (GFunc) gpgme_key_unref,
-			  NULL);
-	  g_list_free (keytable->keys);
-	}
-      keytable->keys = keytable->tmp_list;
+      release_key_array (keytable->keys);
+      keytable->keys = keytable->tmp_keys;
+      rebuild_index (keytable);
     }
+  keytable->tmp_keys = NULL;
+  g_strfreev (keytable->patterns);
+  keytable->patterns = NULL;
   keytable->initialized = TRUE;
   if (keytable->end)
     {
       keytable->end (keytable->data);
     }
+  run_waiters (keytable);
 }
 
 
+/* Called when one of the listings has finished.  */
 static void
-first_half_done_cb (GpaContext *context, gpg_error_t err,
-                    GpaKeyTable *keytable)
+listing_done (GpaKeyTable *keytable)
 {
-  if (keytable->did_first_half || !cms_hack)
-    {
-      /* We are here for the second time and thus we continue with the
-         real done handler.  We do this also if the CMS_HACK has not
-         been enabled.  We reset the protocol to OpenPGP because some
-         old code might assume that it is in OpenPGP mode.  */
-      keytable->fpr = NULL; /* Not needed anymore.  */
-      gpgme_set_protocol (keytable->context->ctx, GPGME_PROTOCOL_OpenPGP);
-      done_cb (context, err, keytable);
-      return;
-    }
+  if (keytable->pending > 0)
+    keytable->pending--;
+  if (!keytable->pending)
+    done_cb (keytable);
+}
 
-  /* Now continue with a key listing for X.509 keys but save the error
-     of the the PGP key listing.  */
-  keytable->first_half_err = err;
-  keytable->did_first_half = 1;
-
-  gpgme_set_protocol (context->ctx, GPGME_PROTOCOL_CMS);
-  err = gpgme_op_keylist_start (keytable->context->ctx,
-                                keytable->fpr,
-				keytable->secret);
-  keytable->fpr = NULL; /* Not needed anymore.  */
-  if (err)
-    {
-      if (keytable->first_half_err)
-        gpa_gpgme_warning (keytable->first_half_err);
 
-      if ((gpg_err_code (err) == GPG_ERR_INV_ENGINE
-           || gpg_err_code (err) == GPG_ERR_UNSUPPORTED_PROTOCOL)
-          && gpg_err_source (err) == GPG_ERR_SOURCE_GPGME)
-        {
-          if (gpg_err_code (err) == GPG_ERR_UNSUPPORTED_PROTOCOL)
-            g_message ("Note: Please check libgpgme has "
-                       "been build with support for CMS");
-          gpa_window_error
-            (_("It seems that no CMS engine is installed.\n\n"
-               "Temporary disabling support for X.509.\n\n"
-               "Please install a CMS engine or invoke this program\n"
-               "with the option --disable-x509 ."), NULL);
-          cms_hack = 0;
-          err = 0;
-        }
-      else
-        gpa_gpgme_warning (err);
-      if (keytable->end)
-	{
-	  keytable->end (keytable->data);
-	}
-    }
+static void
+pgp_done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
+{
+  keytable->pgp_err = err;
+  listing_done (keytable);
+}
+
+
+static void
+cms_done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
+{
+  keytable->cms_err = err;
+  listing_done (keytable);
 }
 
 
 static void
 next_key_cb (GpaContext *context, gpgme_key_t key, GpaKeyTable *keytable)
 {
-  keytable->tmp_list = g_list_prepend (keytable->tmp_list, key);
+  g_ptr_array_add (keytable->tmp_keys, key);
+  gpgme_key_ref (key);
+  if (keytable->next)
+    {
+      keytable->next (key, keytable->data);
+    }
+}
+
+
+static void
+next_cms_key_cb (GpaContext *context, gpgme_key_t key, GpaKeyTable *keytable)
+{
+  g_ptr_array_add (keytable->tmp_cms_keys, key);
   gpgme_key_ref (key);
   if (keytable->next)
     {
@@ -249,11 +573,11 @@ next_key_cb (GpaContext *context, gpgme_key_t key, GpaKeyTable *keytable)
 static void
 list_cache (GpaKeyTable *keytable)
 {
-  GList *list = keytable->keys;
+  guint idx;
 
-  for (; list; list = g_list_next (list))
+  for (idx = 0; idx < keytable->keys->len; idx++)
     {
-      gpgme_key_t key = (gpgme_key_t) list->data;
+      gpgme_key_t key = (gpgme_key_t) g_ptr_array_index (keytable->keys, idx);
       gpgme_key_ref (key);
       if (keytable->next)
 	{
@@ -267,6 +591,29 @@ list_cache (GpaKeyTable *keytable)
     }
 }
 
+
+/* Waiter used to list the keys once the running listing has
+   finished.  */
+static void
+deferred_list_cb (GpaKeyTable *keytable, gpointer data)
+{
+  struct deferred_list_s *deferred = data;
+
+  /* The end function of the previous listing may have started
+     another one.  */
+  if (keytable->pending)
+    {
+      gpa_keytable_when_ready (keytable, deferred_list_cb, deferred);
+      return;
+    }
+
+  keytable->next = deferred->next;
+  keytable->end = deferred->end;
+  keytable->data = deferred->data;
+  g_free (deferred);
+  list_cache (keytable);
+}
+
 /* API */
 
 static GpaKeyTable *public_instance = NULL;
@@ -326,12 +673,26 @@ gpa_keytable_list_keys (GpaKeyTable *keytable,
   g_return_if_fail (keytable != NULL);
   g_return_if_fail (GPA_IS_KEYTABLE (keytable));
 
+  if (keytable->pending)
+    {
+      /* A listing is running; list its result instead of starting
+         another one.  */
+      struct deferred_list_s *deferred;
+
+      deferred = g_malloc (sizeof *deferred);
+      deferred->next = next;
+      deferred->end = end;
+      deferred->data = data;
+      gpa_keytable_when_ready (keytable, deferred_list_cb, deferred);
+      return;
+    }
+
   /* Set up callbacks */
   keytable->next = next;
   keytable->end = end;
   keytable->data = data;
   /* List keys */
-  if (keytable->keys)
+  if (keytable->keys->len)
     {
       /* There is a cached list */
       list_cache (keytable);
@@ -358,6 +719,8 @@ gpa_keytable_force_reload (GpaKeyTable *keytable,
   keytable->end = end;
   keytable->data = data;
   /* List keys */
+  keytable->new_key = FALSE;
+  keytable->refresh = FALSE;
   reload_cache (keytable, NULL);
 }
 
@@ -380,52 +743,129 @@ gpa_keytable_load_new (GpaKeyTable *keytable,
   keytable->data = data;
   /* List keys */
   keytable->new_key = TRUE;
-  reload_cache (keytable, fpr);
+  if (fpr)
+    {
+      const char *patterns[2];
+
+      patterns[0] = fpr;
+      patterns[1] = NULL;
+      reload_cache (keytable, patterns);
+    }
+  else
+    reload_cache (keytable, NULL);
 }
 
 
-/* Make sure the keytable has been loaded.  Warning: This function
- * must never be used from a idle callback because it starts another
- * gtk_main temporary (at least that seems to be problematic in one of
- * my tests).  */
+/* Reload the keys with the given fingerprints from GnuPG.  Cached
+ * versions of these keys are dropped; keys which are not anymore
+ * available are thus removed from the keytable.  FPRS is a NULL
+ * terminated array.  The "next" function is only called for the
+ * reloaded keys.
+ */
 void
-gpa_keytable_ensure (GpaKeyTable *keytable)
+gpa_keytable_refresh_keys (GpaKeyTable *keytable,
+                           const char **fprs,
+                           GpaKeyTableNextFunc next,
+                           GpaKeyTableEndFunc end,
+                           gpointer data)
 {
+  g_return_if_fail (keytable != NULL);
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (fprs && *fprs);
+
+  /* Set up callbacks */
+  keytable->next = next;
+  keytable->end = end;
+  keytable->data = data;
+  /* List keys */
+  keytable->new_key = TRUE;
+  keytable->refresh = TRUE;
+  reload_cache (keytable, fprs);
+}
+
+
+/* Call FUNC with DATA once the keytable has been loaded and no
+ * listing is running anymore.  If the keytable has not yet been
+ * loaded, a listing is started; all callers waiting at the same time
+ * share the same listing.  FUNC is always called from the main loop,
+ * even if the keytable is already available.  If the listing failed,
+ * KEYTABLE->INITIALIZED is still false when FUNC is called.  */
+void
+gpa_keytable_when_ready (GpaKeyTable *keytable,
+                         GpaKeyTableReadyFunc func, gpointer data)
+{
+  struct waiter_s *waiter;
+
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (func);
+
+  waiter = g_malloc (sizeof *waiter);
+  waiter->func = func;
+  waiter->data = data;
+  keytable->waiters = g_slist_prepend (keytable->waiters, waiter);
+
+  /* A running listing calls the waiters when it is done.  */
+  if (keytable->pending)
+    return;
   if (keytable->initialized)
+    schedule_waiters (keytable);
+  else
+    gpa_keytable_ensure (keytable);
+}
+
+
+/* Start loading the keytable if that has not yet been done.  This
+ * does not wait for the listing; use gpa_keytable_when_ready for
+ * that.  */
+void
+gpa_keytable_ensure (GpaKeyTable *keytable)
+{
+  if (keytable->initialized || keytable->pending)
     return;
 
-  keytable->end = (GpaKeyTableEndFunc) gtk_main_quit;
-  reload_cache (keytable, NULL);
-  gtk_main ();
+  keytable->next = NULL;
   keytable->end = NULL;
-
+  keytable->data = NULL;
+  keytable->new_key = FALSE;
+  keytable->refresh = FALSE;
+  reload_cache (keytable, NULL);
 }
 
 /* Return the key with a given fingerprint from the keytable, NULL if
- * there is none.  No reference is provided.  If this called from an
- * idle callback, you should make sure that gpa_keytable_ensure has
- * been called before the idle callback. */
+ * there is none.  FPR may also be a long key ID or the fingerprint of
+ * a subkey.  No reference is provided.  If the keytable has not yet
+ * been loaded, loading is started and NULL is returned; callers which
+ * may run that early need to use gpa_keytable_when_ready first.  */
 gpgme_key_t
 gpa_keytable_lookup_key (GpaKeyTable *keytable, const char *fpr)
 {
-  GList *cur;
+  if (!fpr)
+    return NULL;
 
   if (!keytable->initialized)
     {
-      /* There is no list yet. We really, really, need one, so we list it.
-       * FIXME: This is a hack and a basic problem. Hopefully it won't cause
-       * any real problems.
-       * Actually is a real problem, see function desription.    */
       gpa_keytable_ensure (keytable);
+      return NULL;
     }
 
-  for (cur = keytable->keys; cur; cur = g_list_next (cur))
-    {
-      gpgme_key_t key = (gpgme_key_t) cur->data;
-      if (g_str_equal (fpr, key->subkeys->fpr))
-        {
-          return key;
-        }
-    }
-  return NULL;
+  return g_hash_table_lookup (keytable->index, fpr);
+}
+
+
+/* Return a set with the keys of the keytable whose user IDs, mail
+ * addresses, fingerprints or key IDs contain TEXT.  Returns NULL if
+ * the keytable has not been loaded or is not indexed.  The index is
+ * built on the first search after a change.  The caller must release
+ * the hash table.  */
+GHashTable *
+gpa_keytable_search (GpaKeyTable *keytable, const char *text)
+{
+  /* The secret keys are not searched.  */
+  if (!keytable->initialized || keytable->secret)
+    return NULL;
+
+  if (!keytable->search)
+    keytable->search = gpa_key_search_new (keytable->keys);
+
+  return gpa_key_search_find (keytable->search, text);
 }
@@ -28,6 +28,7 @@
 #include <gtk/gtk.h>
 #include <gpgme.h>
 #include "gpacontext.h"
+#include "keysearch.h"
 
 /* GObject stuff */
 #define GPA_KEYTABLE_TYPE	  (gpa_keytable_get_type ())
@@ -42,23 +43,49 @@ typedef struct _GpaKeyTableClass GpaKeyTableClass;
 
 typedef void (*GpaKeyTableNextFunc) (gpgme_key_t key, gpointer data);
 typedef void (*GpaKeyTableEndFunc) (gpointer data);
+typedef void (*GpaKeyTableReadyFunc) (GpaKeyTable *keytable, gpointer data);
 
 struct _GpaKeyTable {
   GObject parent;
 
+  /* The contexts used for the OpenPGP and the X.509 key listing.
+     Both listings run at the same time.  */
   GpaContext *context;
+  GpaContext *cms_context;
 
   gboolean secret;
   gboolean new_key;
+  gboolean refresh;
   gboolean initialized;
   GpaKeyTableNextFunc next;
   GpaKeyTableEndFunc end;
   gpointer data;
-  const char *fpr;
-  int did_first_half;
-  gpg_error_t first_half_err;
-
-  GList *keys, *tmp_list;
+  char **patterns;
+  /* Number of listings still running and their results.  */
+  int pending;
+  gpg_error_t pgp_err;
+  gpg_error_t cms_err;
+
+  /* The cached keys and the keys collected by the running OpenPGP
+     and X.509 listings.  The arrays hold one reference for each key.  */
+  GPtrArray *keys, *tmp_keys, *tmp_cms_keys;
+
+  /* Index over KEYS mapping the fingerprints and long key IDs of the
+     primary key and all subkeys to the key.  The hash table does not
+     own any references; the strings belong to the keys in KEYS.  */
+  GHashTable *index;
+
+  /* Substring search index over KEYS; only for the public keys.  It
+     is built by the first search after a change of KEYS.  */
+  gpa_key_search_t search;
+  /* Incremented each time KEYS changes.  */
+  guint generation;
+
+  /* Callbacks waiting for the running listing to finish; see
+     gpa_keytable_when_ready.  READY_ID is the idle source used if no
+     listing is running.  */
+  GSList *waiters;
+  guint ready_id;
 };
 
 struct _GpaKeyTableClass {
@@ -104,16 +131,43 @@ void gpa_keytable_load_new (GpaKeyTable *keytable,
 			    GpaKeyTableEndFunc end,
 			    gpointer data);
 
-/* Make sure the keytable has been loaded.  Warning: This function
- * must never be used from a idle callback because it starts another
- * gtk_main temporary (at least that seems to be problematic in one of
- * my tests).  */
+/* Reload the keys with the given fingerprints from GnuPG.  Cached
+ * versions of these keys are dropped; keys which are not anymore
+ * available are thus removed from the keytable.  FPRS is a NULL
+ * terminated array.  The "next" function is only called for the
+ * reloaded keys.
+ */
+void gpa_keytable_refresh_keys (GpaKeyTable *keytable,
+                                const char **fprs,
+                                GpaKeyTableNextFunc next,
+                                GpaKeyTableEndFunc end,
+                                gpointer data);
+
+/* Call FUNC with DATA once the keytable has been loaded and no
+ * listing is running anymore.  If the keytable has not yet been
+ * loaded, a listing is started; all callers waiting at the same time
+ * share the same listing.  FUNC is always called from the main loop,
+ * even if the keytable is already available.  If the listing failed,
+ * KEYTABLE->INITIALIZED is still false when FUNC is called.  */
+void gpa_keytable_when_ready (GpaKeyTable *keytable,
+                              GpaKeyTableReadyFunc func, gpointer data);
+
+/* Start loading the keytable if that has not yet been done.  This
+ * does not wait for the listing; use gpa_keytable_when_ready for
+ * that.  */
 void gpa_keytable_ensure (GpaKeyTable *keytable);
 
 /* Return the key with a given fingerprint from the keytable, NULL if
- * there is none. No reference is provided.  If this called from an
- * idle callback, you should make sure that gpa_keytable_ensure has
- * been called before the idle callback.*/
+ * there is none.  FPR may also be a long key ID or the fingerprint of
+ * a subkey.  No reference is provided.  If the keytable has not yet
+ * been loaded, loading is started and NULL is returned; callers which
+ * may run that early need to use gpa_keytable_when_ready first.  */
 gpgme_key_t gpa_keytable_lookup_key (GpaKeyTable *keytable, const char *fpr);
 
+/* Return a set with the keys of the keytable whose user IDs, mail
+ * addresses, fingerprints or key IDs contain TEXT.  Returns NULL if
+ * the keytable has not been loaded or is not indexed.  The caller
+ * must release the hash table.  */
+GHashTable *gpa_keytable_search (GpaKeyTable *keytable, const char *text);
+
 #endif /* KEYTABLE_H */
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -40,6 +41,7 @@ init_membuf (membuf_t *mb, size_t initiallen)
   mb->len = 0;
   mb->size = initiallen;
   mb->out_of_core = 0;
+  mb->pos = 0;
   mb->buf = g_try_malloc (initiallen);
   if (!mb->buf)
     mb->out_of_core = errno;
@@ -56,7 +58,9 @@ put_membuf (membuf_t *mb, const void *buf, size_t len)
     {
       char *p;
       
-      mb->size += len + 1024;
+      /* Grow exponentially so that many small writes, as done by
+         gpgme, do not copy the buffer over and over.  */
+      mb->size = MAX (2 * mb->size, mb->len + len + 1024);
       p = g_try_realloc (mb->buf, mb->size);
       if (!p)
         {
@@ -102,3 +106,102 @@ get_membuf (membuf_t *mb, size_t *len)
   mb->out_of_core = ENOMEM; /* Hack to make sure it won't get reused. */
   return p;
 }
+
+
+/* Like get_membuf but the returned buffer is terminated by a Nul,
+   which is not included in LEN.  */
+char *
+get_membuf_string (membuf_t *mb, size_t *len)
+{
+  char *p;
+
+  put_membuf (mb, "", 1);
+  p = get_membuf (mb, len);
+  if (p && len)
+    (*len)--;
+  return p;
+}
+
+
+static gpgme_ssize_t
+membuf_data_read (void *handle, void *buffer, size_t size)
+{
+  membuf_t *mb = handle;
+
+  if (mb->out_of_core)
+    {
+      errno = mb->out_of_core;
+      return -1;
+    }
+  if (size > mb->len - mb->pos)
+    size = mb->len - mb->pos;
+  memcpy (buffer, mb->buf + mb->pos, size);
+  mb->pos += size;
+  return size;
+}
+
+
+static gpgme_ssize_t
+membuf_data_write (void *handle, const void *buffer, size_t size)
+{
+  membuf_t *mb = handle;
+
+  put_membuf (mb, buffer, size);
+  if (mb->out_of_core)
+    {
+      errno = mb->out_of_core;
+      return -1;
+    }
+  return size;
+}
+
+
+static off_t
+membuf_data_seek (void *handle, off_t offset, int whence)
+{
+  membuf_t *mb = handle;
+
+  switch (whence)
+    {
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      offset += mb->pos;
+      break;
+    case SEEK_END:
+      offset += mb->len;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+    }
+  if (offset < 0 || (size_t) offset > mb->len)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  mb->pos = offset;
+  return offset;
+}
+
+
+static struct gpgme_data_cbs membuf_data_cbs =
+  {
+    membuf_data_read,
+    membuf_data_write,
+    membuf_data_seek,
+    NULL
+  };
+
+
+/* Create a gpgme data object in R_DATA which appends everything
+   written to MB and reads from MB.  Writes always append, reads start
+   at the position set by seeking.  MB must have been initialized and
+   must stay valid until the data object has been released; the
+   buffer itself is not released with the data object.  This allows
+   to take the output of gpgme with get_membuf without copying it.  */
+gpgme_error_t
+membuf_data_new (gpgme_data_t *r_data, membuf_t *mb)
+{
+  return gpgme_data_new_from_cbs (r_data, &membuf_data_cbs, mb);
+}
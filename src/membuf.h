@@ -20,6 +20,8 @@
 #ifndef GPA_MEMBUF_H
 #define GPA_MEMBUF_H
 
+#include <gpgme.h>
+
 /* The definition of the structure is private, we only need it here,
    so it can be allocated on the stack. */
 struct private_membuf_s 
@@ -28,6 +30,7 @@ struct private_membuf_s
   size_t size;     
   char *buf;       
   int out_of_core; 
+  size_t pos;      /* The read position for membuf_data_new.  */
 };
 
 typedef struct private_membuf_s membuf_t;
@@ -35,12 +38,17 @@ typedef struct private_membuf_s membuf_t;
 /* Return the current length of the membuf.  */
 #define get_membuf_len(a)  ((a)->len)
 #define is_membuf_ready(a) ((a)->buf || (a)->out_of_core)
-#define MEMBUF_ZERO        { 0, 0, NULL, 0}
+#define MEMBUF_ZERO        { 0, 0, NULL, 0, 0}
 
 void init_membuf (membuf_t *mb, size_t initiallen);
 void put_membuf  (membuf_t *mb, const void *buf, size_t len);
 void put_membuf_str (membuf_t *mb, const char *string);
 void *get_membuf (membuf_t *mb, size_t *len);
+char *get_membuf_string (membuf_t *mb, size_t *len);
+
+/* Create a gpgme data object which writes into and reads from MB.
+   MB must stay valid until the data object has been released.  */
+gpgme_error_t membuf_data_new (gpgme_data_t *r_data, membuf_t *mb);
 
 
 #endif /*GPA_MEMBUF_H*/
@@ -51,6 +51,7 @@ enum
   CHANGED_DEFAULT_KEYSERVER,
   CHANGED_BACKUP_GENERATED,
   CHANGED_VIEW,
+  CHANGED_FILE_OPERATIONS,
   LAST_SIGNAL
 };
 
@@ -116,6 +117,7 @@ gpa_options_class_init (GpaOptionsClass *klass)
   klass->changed_default_keyserver = gpa_options_save_settings;
   klass->changed_backup_generated = gpa_options_save_settings;
   klass->changed_view = gpa_options_save_settings;
+  klass->changed_file_operations = gpa_options_save_settings;
 
   /* Signals */
   make_signal (CHANGED_UI_MODE, object_class,
@@ -137,6 +139,9 @@ gpa_options_class_init (GpaOptionsClass *klass)
   make_signal (CHANGED_BACKUP_GENERATED, object_class,
                "changed_backup_generated",
                G_STRUCT_OFFSET (GpaOptionsClass, changed_backup_generated));
+  make_signal (CHANGED_FILE_OPERATIONS, object_class,
+               "changed_file_operations",
+               G_STRUCT_OFFSET (GpaOptionsClass, changed_file_operations));
 }
 
 static void
@@ -150,6 +155,8 @@ gpa_options_init (GpaOptions *options)
   options->default_key_fpr = NULL;
   options->default_keyserver = NULL;
   options->detailed_view = FALSE;
+  options->file_workers = 0;
+  options->keep_going = FALSE;
 }
 
 static void
@@ -399,6 +406,38 @@ gpa_options_get_detailed_view (GpaOptions *options)
   return options->detailed_view;
 }
 
+/* Set the number of files processed at the same time */
+void
+gpa_options_set_file_workers (GpaOptions *options, int value)
+{
+  int change = (options->file_workers != value);
+  options->file_workers = value;
+  if (change)
+    g_signal_emit (options, signals[CHANGED_FILE_OPERATIONS], 0);
+}
+
+int
+gpa_options_get_file_workers (GpaOptions *options)
+{
+  return options->file_workers;
+}
+
+/* Remember whether to continue after a file failed */
+void
+gpa_options_set_keep_going (GpaOptions *options, gboolean value)
+{
+  int change = (!options->keep_going != !value);
+  options->keep_going = value;
+  if (change)
+    g_signal_emit (options, signals[CHANGED_FILE_OPERATIONS], 0);
+}
+
+gboolean
+gpa_options_get_keep_going (GpaOptions *options)
+{
+  return options->keep_going;
+}
+
 
 /* Remember whether the default key has already been backed up */
 void
@@ -454,6 +493,15 @@ gpa_options_save_settings (GpaOptions *options)
         {
           fprintf (options_file, "%s\n", "detailed-view");
         }
+      if (options->file_workers > 0)
+        {
+          fprintf (options_file, "file-workers %d\n",
+                   options->file_workers);
+        }
+      if (options->keep_going)
+        {
+          fprintf (options_file, "%s\n", "keep-going");
+        }
       fclose (options_file);
     }
 
@@ -496,6 +544,7 @@ typedef enum
    PARSE_OPTIONS_STATE_START,
    PARSE_OPTIONS_STATE_HAVE_KEY,
    PARSE_OPTIONS_STATE_HAVE_KEYSERVER,
+   PARSE_OPTIONS_STATE_HAVE_FILE_WORKERS,
  } ParseOptionsState;
 
 /* This MUST be called ONLY from gpa_options_new (). We don't emit any
@@ -552,6 +601,14 @@ gpa_options_read_settings (GpaOptions *options)
                 {
                   options->detailed_view = TRUE;
                 }
+              else if (g_str_equal (next_word, "file-workers"))
+                {
+                  state = PARSE_OPTIONS_STATE_HAVE_FILE_WORKERS;
+                }
+              else if (g_str_equal (next_word, "keep-going"))
+                {
+                  options->keep_going = TRUE;
+                }
               break;
             case PARSE_OPTIONS_STATE_HAVE_KEY:
               options->default_key_fpr = g_strdup (next_word);
@@ -562,6 +619,10 @@ gpa_options_read_settings (GpaOptions *options)
               /* options->default_keyserver = g_strdup (next_word); */
               state = PARSE_OPTIONS_STATE_START;
               break;
+            case PARSE_OPTIONS_STATE_HAVE_FILE_WORKERS:
+              options->file_workers = CLAMP (atoi (next_word), 0, 64);
+              state = PARSE_OPTIONS_STATE_START;
+              break;
             default:
               /* Can't happen */
               return;
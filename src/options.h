@@ -50,6 +50,11 @@ struct _GpaOptions {
   gchar *default_keyserver;
 
   gboolean detailed_view;
+
+  /* The number of files processed at the same time; 0 for the
+     default.  */
+  int file_workers;
+  gboolean keep_going;
 };
 
 struct _GpaOptionsClass {
@@ -62,6 +67,7 @@ struct _GpaOptionsClass {
   void (*changed_default_keyserver) (GpaOptions *options);
   void (*changed_backup_generated) (GpaOptions *options);
   void (*changed_view) (GpaOptions *options);
+  void (*changed_file_operations) (GpaOptions *options);
 };
 
 GType gpa_options_get_type (void) G_GNUC_CONST;
@@ -109,5 +115,15 @@ gboolean gpa_options_get_backup_generated (GpaOptions *options);
 void gpa_options_set_detailed_view (GpaOptions *options, gboolean value);
 gboolean gpa_options_get_detailed_view (GpaOptions *options);
 
+/* Set the number of files a file operation processes at the same
+   time.  0 selects a default based on the number of processors.  */
+void gpa_options_set_file_workers (GpaOptions *options, int value);
+int gpa_options_get_file_workers (GpaOptions *options);
+
+/* Set whether file operations continue with the next file after an
+   error.  */
+void gpa_options_set_keep_going (GpaOptions *options, gboolean value);
+gboolean gpa_options_get_keep_going (GpaOptions *options);
+
 #endif /*OPTIONS_H*/
 
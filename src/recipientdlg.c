@@ -20,6 +20,7 @@
 # include <config.h>
 #endif
 
+#include <string.h>
 #include <gtk/gtk.h>
 
 #include "gpa.h"
@@ -27,6 +28,7 @@
 
 #include "gtktools.h"
 #include "selectkeydlg.h"
+#include "keysnapshot.h"
 #include "recipientdlg.h"
 
 
@@ -56,6 +58,12 @@ struct _RecipientDlg
 
   /* The selected protocol.  This is also set by update_statushint.  */
   gpgme_protocol_t selected_protocol;
+
+  /* The running key lookups, the number of them not yet finished and
+     the button to stop them.  */
+  struct lookup_batch_s *batch;
+  unsigned int pending_lookups;
+  GtkWidget *stop_button;
 };
 
 
@@ -83,6 +91,17 @@ enum
    at a reasonable value.  */
 #define TRUNCATE_KEYSEARCH_AT 40
 
+/* The keys found for a mailbox are cached for this many seconds.  The
+   cache is also flushed if the keyring files change.  */
+#define RECIPIENT_CACHE_TTL (5 * 60)
+
+/* The maximum number of entries in the recipient cache.  */
+#define RECIPIENT_CACHE_MAX 1000
+
+/* The number of threads looking up keys.  The lookups may wait for
+   the network, thus this does not depend on the number of CPUs.  */
+#define LOOKUP_THREADS 8
+
 
 /* An object to keep information about keys.  */
 struct keyinfo_s
@@ -116,8 +135,65 @@ struct userdata_s
      required for the recipient.  */
   int ignore_recipient;
 
+  /* Set while the keys are being looked up.  */
+  int lookup_pending;
+
+};
+
+
+/* The keys found for a mailbox and protocol.  */
+struct cached_keys_s
+{
+  /* A NULL terminated array of keys or NULL if none were found.  */
+  gpgme_key_t *keys;
+  int truncated;
+  /* The monotonic time when the entry expires.  */
+  gint64 expires;
+};
+
+/* The recipient cache.  It maps "<protocol>:<mailbox>" with a
+   lowercased mailbox to a struct cached_keys_s.  */
+static GHashTable *recipient_cache;
+
+/* The state of the keyring files when the cache was last checked.  */
+static struct gpa_keyring_stamp_s recipient_cache_stamp;
+
+
+/* The key lookups started by one call of parse_recipients.  */
+struct lookup_batch_s
+{
+  int refcount;
+  /* Set if the remaining lookups shall be skipped.  This is read by
+     the worker threads.  */
+  int canceled;
+  /* The dialog to update or NULL.  */
+  RecipientDlg *dialog;
+};
+
+/* The lookup of the keys for one recipient.  */
+struct lookup_job_s
+{
+  struct lookup_batch_s *batch;
+  /* The row of the recipient.  */
+  GtkTreeRowReference *row;
+  char *mailbox;
+  /* The protocols for which the keys were not cached.  */
+  int need_pgp;
+  int need_x509;
+  /* The result; LISTED is not set if the lookup was skipped.  */
+  int listed;
+  struct keyinfo_s pgp;
+  struct keyinfo_s x509;
 };
 
+/* True if gpg can locate keys.  Set by parse_recipients.  */
+static int have_locate = -1;
+
+/* The pool of lookup threads and the gpgme context of each thread.  */
+static GThreadPool *lookup_pool;
+static GPrivate lookup_context
+  = G_PRIVATE_INIT ((GDestroyNotify) gpgme_release);
+
 
 /* Identifiers for the columns of the RECPLIST.  */
 enum
@@ -235,6 +311,20 @@ update_statushint (RecipientDlg *dialog)
   if (dialog->freeze_update_statushint)
     return;
 
+  if (dialog->pending_lookups)
+    {
+      char *text = g_strdup_printf (_("Looking up the keys of %u "
+                                      "recipients..."),
+                                    dialog->pending_lookups);
+
+      gtk_label_set_text (GTK_LABEL (dialog->statushint), text);
+      g_free (text);
+      dialog->usable = 0;
+      gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
+                                         GTK_RESPONSE_OK, FALSE);
+      return;
+    }
+
   model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->clist_keys));
 
   if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->radio_pgp)))
@@ -417,6 +507,8 @@ update_recplist_row (GtkListStore *store, GtkTreeIter *iter,
 
   if (info->ignore_recipient)
     infostr = NULL;
+  else if (info->lookup_pending)
+    infostr = g_strdup (_("[Looking up keys...]"));
   else if (any_pgp && any_x509 && info->pgp.keys[1] && info->x509.keys[1])
     infostr = g_strdup (_("[Ambiguous keys. Right-click to select]"));
   else if (any_pgp && info->pgp.keys[1])
@@ -460,104 +552,421 @@ update_recplist_row (GtkListStore *store, GtkTreeIter *iter,
 }
 
 
-/* Parse one recipient, this is the working horse of parse_recipeints. */
+/* List the keys for MAILBOX and PROTOCOL using CTX and store them at
+   KEYINFO.  This is called by the worker threads.  */
 static void
-parse_one_recipient (gpgme_ctx_t ctx, GtkListStore *store, GtkTreeIter *iter,
-                     struct userdata_s *info)
+list_recipient_keys (gpgme_ctx_t ctx, const char *mailbox,
+                     gpgme_protocol_t protocol, struct keyinfo_s *keyinfo)
 {
-  static int have_locate = -1;
   gpgme_key_t key = NULL;
   gpgme_keylist_mode_t mode;
 
-  if (have_locate == -1)
-    have_locate = is_gpg_version_at_least ("2.0.10");
-
-  g_return_if_fail (info);
-
-  clear_keyinfo (&info->pgp);
-  gpgme_set_protocol (ctx, GPGME_PROTOCOL_OpenPGP);
+  gpgme_set_protocol (ctx, protocol);
   mode = gpgme_get_keylist_mode (ctx);
-  if (have_locate)
+  if (have_locate && protocol == GPGME_PROTOCOL_OpenPGP)
     gpgme_set_keylist_mode (ctx, (mode | (GPGME_KEYLIST_MODE_LOCAL
                                           | GPGME_KEYLIST_MODE_EXTERN)));
-  if (!gpgme_op_keylist_start (ctx, info->mailbox, 0))
+  if (!gpgme_op_keylist_start (ctx, mailbox, 0))
     {
       while (!gpgme_op_keylist_next (ctx, &key))
         {
           if (key->revoked || key->disabled || key->expired
               || !key->can_encrypt)
             gpgme_key_unref (key);
-          else if (append_key_to_keyinfo (&info->pgp, key)
+          else if (append_key_to_keyinfo (keyinfo, key)
                    >= TRUNCATE_KEYSEARCH_AT)
             {
               /* Note that the truncation flag is not 100% correct.  In
                  case the next iteration would not yield a new key we
                  have not actually truncated the search.  */
-              info->pgp.truncated = 1;
+              keyinfo->truncated = 1;
               break;
             }
         }
     }
   gpgme_op_keylist_end (ctx);
   gpgme_set_keylist_mode (ctx, mode);
+}
+
+
+static void
+free_cached_keys (struct cached_keys_s *cached)
+{
+  unsigned int idx;
 
-  clear_keyinfo (&info->x509);
-  gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
-  if (!gpgme_op_keylist_start (ctx, info->mailbox, 0))
+  if (cached->keys)
     {
-      while (!gpgme_op_keylist_next (ctx, &key))
+      for (idx = 0; cached->keys[idx]; idx++)
+        gpgme_key_unref (cached->keys[idx]);
+      g_free (cached->keys);
+    }
+  g_free (cached);
+}
+
+
+/* Create the recipient cache or flush it if the keyring files have
+   changed since it was filled.  */
+static void
+check_recipient_cache (void)
+{
+  struct gpa_keyring_stamp_s stamp;
+
+  gpa_keyring_stamp (&stamp);
+
+  if (!recipient_cache)
+    recipient_cache = g_hash_table_new_full
+      (g_str_hash, g_str_equal, g_free, (GDestroyNotify) free_cached_keys);
+  else if (!memcmp (&stamp, &recipient_cache_stamp, sizeof stamp))
+    return;
+  else
+    g_hash_table_remove_all (recipient_cache);
+
+  recipient_cache_stamp = stamp;
+}
+
+
+/* Return the key of the recipient cache for MAILBOX and PROTOCOL.  */
+static char *
+recipient_cache_key (const char *mailbox, gpgme_protocol_t protocol)
+{
+  char *normalized, *cachekey;
+
+  normalized = g_ascii_strdown (mailbox, -1);
+  g_strstrip (normalized);
+  cachekey = g_strdup_printf ("%d:%s", protocol, normalized);
+  g_free (normalized);
+  return cachekey;
+}
+
+
+/* Return the keys for MAILBOX and PROTOCOL from the recipient cache
+   at KEYINFO.  Returns false if they are not cached.  */
+static gboolean
+lookup_cached_keys (const char *mailbox, gpgme_protocol_t protocol,
+                    struct keyinfo_s *keyinfo)
+{
+  struct cached_keys_s *cached;
+  char *cachekey;
+  unsigned int idx;
+
+  cachekey = recipient_cache_key (mailbox, protocol);
+  cached = g_hash_table_lookup (recipient_cache, cachekey);
+  g_free (cachekey);
+  if (!cached || cached->expires <= g_get_monotonic_time ())
+    return FALSE;
+
+  clear_keyinfo (keyinfo);
+  for (idx = 0; cached->keys && cached->keys[idx]; idx++)
+    {
+      gpgme_key_ref (cached->keys[idx]);
+      append_key_to_keyinfo (keyinfo, cached->keys[idx]);
+    }
+  keyinfo->truncated = cached->truncated;
+  return TRUE;
+}
+
+
+/* Store the keys at KEYINFO found for MAILBOX and PROTOCOL in the
+   recipient cache.  */
+static void
+cache_keys (const char *mailbox, gpgme_protocol_t protocol,
+            struct keyinfo_s *keyinfo)
+{
+  struct cached_keys_s *cached;
+  unsigned int idx, nkeys;
+
+  /* Mailboxes which are not found are cached as well so that a
+     missing key is not located again and again.  */
+  if (g_hash_table_size (recipient_cache) >= RECIPIENT_CACHE_MAX)
+    g_hash_table_remove_all (recipient_cache);
+  cached = g_malloc0 (sizeof *cached);
+  for (nkeys = 0; keyinfo->keys && keyinfo->keys[nkeys]; nkeys++)
+    ;
+  if (nkeys)
+    {
+      cached->keys = g_new (gpgme_key_t, nkeys + 1);
+      for (idx = 0; idx < nkeys; idx++)
         {
-          if (key->revoked || key->disabled || key->expired
-              || !key->can_encrypt)
-            gpgme_key_unref (key);
-          else if (append_key_to_keyinfo (&info->x509,key)
-                   >= TRUNCATE_KEYSEARCH_AT)
-            {
-              info->x509.truncated = 1;
-              break;
-            }
+          cached->keys[idx] = keyinfo->keys[idx];
+          gpgme_key_ref (cached->keys[idx]);
         }
+      cached->keys[nkeys] = NULL;
     }
-  gpgme_op_keylist_end (ctx);
+  cached->truncated = keyinfo->truncated;
+  cached->expires = (g_get_monotonic_time ()
+                     + RECIPIENT_CACHE_TTL * G_USEC_PER_SEC);
+  g_hash_table_replace (recipient_cache,
+                        recipient_cache_key (mailbox, protocol), cached);
+}
+
+
+
+/* Looking up the keys of the recipients.  The keys which are not
+   cached are listed by a pool of worker threads, each with its own
+   gpgme context.  The rows are updated from the main loop as the
+   results arrive.  */
+
+/* Return the gpgme context of the calling worker thread.  */
+static gpgme_ctx_t
+get_lookup_context (void)
+{
+  gpgme_ctx_t ctx = g_private_get (&lookup_context);
+
+  if (!ctx)
+    {
+      if (gpgme_new (&ctx))
+        return NULL;
+      g_private_set (&lookup_context, ctx);
+    }
+  return ctx;
+}
+
+
+static void
+release_lookup_batch (struct lookup_batch_s *batch)
+{
+  if (!--batch->refcount)
+    g_free (batch);
+}
 
-  update_recplist_row (store, iter, info);
+
+static void
+release_lookup_job (struct lookup_job_s *job)
+{
+  release_lookup_batch (job->batch);
+  gtk_tree_row_reference_free (job->row);
+  clear_keyinfo (&job->pgp);
+  clear_keyinfo (&job->x509);
+  g_free (job->mailbox);
+  g_free (job);
 }
 
 
-/* Parse the list of recipients, find possible keys and update the
-   store.  */
+/* Detach DIALOG from its running lookups.  Lookups not yet started
+   are skipped and the results of the others are only cached.  */
 static void
-parse_recipients (GtkListStore *store)
+detach_lookups (RecipientDlg *dialog)
+{
+  if (!dialog->batch)
+    return;
+
+  g_atomic_int_set (&dialog->batch->canceled, 1);
+  dialog->batch->dialog = NULL;
+  release_lookup_batch (dialog->batch);
+  dialog->batch = NULL;
+  dialog->pending_lookups = 0;
+}
+
+
+/* Stop the lookups of DIALOG and show the rows still waiting for
+   their keys as not found.  */
+static void
+stop_lookups (RecipientDlg *dialog)
 {
   GtkTreeModel *model;
   GtkTreeIter iter;
-  gpg_error_t err;
+
+  if (!dialog->batch)
+    return;
+
+  detach_lookups (dialog);
+  gtk_widget_hide (dialog->stop_button);
+
+  dialog->freeze_update_statushint++;
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->clist_keys));
+  if (gtk_tree_model_get_iter_first (model, &iter))
+    do
+      {
+        struct userdata_s *info;
+
+        gtk_tree_model_get (model, &iter, RECPLIST_USERDATA, &info, -1);
+        if (info && info->lookup_pending)
+          {
+            info->lookup_pending = 0;
+            update_recplist_row (GTK_LIST_STORE (model), &iter, info);
+          }
+      }
+    while (gtk_tree_model_iter_next (model, &iter));
+  dialog->freeze_update_statushint--;
+  update_statushint (dialog);
+}
+
+
+/* A lookup job has finished.  */
+static gboolean
+lookup_done_idle_cb (void *data)
+{
+  struct lookup_job_s *job = data;
+  RecipientDlg *dialog = job->batch->dialog;
+  GtkTreeModel *model;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  struct userdata_s *info;
+  int last = 0;
+
+  if (job->listed)
+    {
+      if (job->need_pgp)
+        cache_keys (job->mailbox, GPGME_PROTOCOL_OpenPGP, &job->pgp);
+      if (job->need_x509)
+        cache_keys (job->mailbox, GPGME_PROTOCOL_CMS, &job->x509);
+    }
+
+  /* Count the job first so that the status hint updated along with
+     the row is current.  */
+  if (dialog)
+    last = !--dialog->pending_lookups;
+
+  if (dialog && gtk_tree_row_reference_valid (job->row))
+    {
+      model = gtk_tree_row_reference_get_model (job->row);
+      path = gtk_tree_row_reference_get_path (job->row);
+      info = NULL;
+      if (gtk_tree_model_get_iter (model, &iter, path))
+        gtk_tree_model_get (model, &iter, RECPLIST_USERDATA, &info, -1);
+      gtk_tree_path_free (path);
+
+      /* A key selected by the user meanwhile is kept.  */
+      if (info && info->lookup_pending)
+        {
+          info->lookup_pending = 0;
+          if (job->need_pgp)
+            {
+              clear_keyinfo (&info->pgp);
+              info->pgp = job->pgp;
+              memset (&job->pgp, 0, sizeof job->pgp);
+            }
+          if (job->need_x509)
+            {
+              clear_keyinfo (&info->x509);
+              info->x509 = job->x509;
+              memset (&job->x509, 0, sizeof job->x509);
+            }
+          update_recplist_row (GTK_LIST_STORE (model), &iter, info);
+        }
+    }
+
+  if (last)
+    {
+      detach_lookups (dialog);
+      gtk_widget_hide (dialog->stop_button);
+      update_statushint (dialog);
+    }
+
+  release_lookup_job (job);
+  return FALSE;
+}
+
+
+static void
+lookup_job_func (gpointer data, gpointer user_data)
+{
+  struct lookup_job_s *job = data;
   gpgme_ctx_t ctx;
 
-  err = gpgme_new (&ctx);
-  if (err)
-    gpa_gpgme_error (err);
+  if (!g_atomic_int_get (&job->batch->canceled)
+      && (ctx = get_lookup_context ()))
+    {
+      if (job->need_pgp)
+        list_recipient_keys (ctx, job->mailbox, GPGME_PROTOCOL_OpenPGP,
+                             &job->pgp);
+      if (job->need_x509)
+        list_recipient_keys (ctx, job->mailbox, GPGME_PROTOCOL_CMS,
+                             &job->x509);
+      job->listed = 1;
+    }
+  g_idle_add (lookup_done_idle_cb, job);
+}
+
+
+/* Find the keys for the recipients in the list of DIALOG.  Cached
+   keys are shown at once; the others are looked up in the
+   background.  */
+static void
+parse_recipients (RecipientDlg *dialog)
+{
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  struct lookup_batch_s *batch;
+  GSList *jobs = NULL, *item;
 
+  detach_lookups (dialog);
+  check_recipient_cache ();
+  if (have_locate == -1)
+    have_locate = is_gpg_version_at_least ("2.0.10");
 
-  model = GTK_TREE_MODEL (store);
-  /* Walk through the list, reading each row. */
+  batch = g_malloc0 (sizeof *batch);
+  batch->refcount = 1;
+  batch->dialog = dialog;
 
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (dialog->clist_keys));
   if (gtk_tree_model_get_iter_first (model, &iter))
     do
       {
         struct userdata_s *info;
+        struct lookup_job_s *job;
+        GtkTreePath *path;
+        int need_pgp, need_x509;
 
         gtk_tree_model_get (model, &iter,
                             RECPLIST_USERDATA, &info,
                             -1);
-
-        /* Do something with the data */
-        /*g_print ("parsing mailbox `%s'\n", info? info->mailbox:"(null)");*/
-        parse_one_recipient (ctx, store, &iter,info);
+        if (!info)
+          continue;
+
+        need_pgp = !lookup_cached_keys (info->mailbox,
+                                        GPGME_PROTOCOL_OpenPGP, &info->pgp);
+        need_x509 = !lookup_cached_keys (info->mailbox,
+                                         GPGME_PROTOCOL_CMS, &info->x509);
+        info->lookup_pending = need_pgp || need_x509;
+        update_recplist_row (GTK_LIST_STORE (model), &iter, info);
+        if (!info->lookup_pending)
+          continue;
+
+        job = g_malloc0 (sizeof *job);
+        job->batch = batch;
+        batch->refcount++;
+        path = gtk_tree_model_get_path (model, &iter);
+        job->row = gtk_tree_row_reference_new (model, path);
+        gtk_tree_path_free (path);
+        job->mailbox = g_strdup (info->mailbox);
+        job->need_pgp = need_pgp;
+        job->need_x509 = need_x509;
+        jobs = g_slist_prepend (jobs, job);
+        dialog->pending_lookups++;
       }
     while (gtk_tree_model_iter_next (model, &iter));
 
-  gpgme_release (ctx);
+  if (!jobs)
+    {
+      release_lookup_batch (batch);
+      return;
+    }
+  dialog->batch = batch;
+  gtk_widget_show (dialog->stop_button);
+
+  if (!lookup_pool)
+    {
+      GError *error = NULL;
+
+      lookup_pool = g_thread_pool_new (lookup_job_func, NULL,
+                                       LOOKUP_THREADS, FALSE, &error);
+      if (!lookup_pool)
+        {
+          g_debug ("error creating the thread pool: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
+  jobs = g_slist_reverse (jobs);
+  for (item = jobs; item; item = g_slist_next (item))
+    {
+      if (lookup_pool)
+        g_thread_pool_push (lookup_pool, item->data, NULL);
+      else
+        lookup_job_func (item->data, NULL);
+    }
+  g_slist_free (jobs);
 }
 
 
@@ -658,6 +1067,7 @@ select_key_response_cb (SelectKeyDlg *seldlg, int response, void *user_data)
           gtk_tree_model_get (model, &iter, RECPLIST_USERDATA, &info, -1);
           if (info)
             {
+              info->lookup_pending = 0;
               if (key->protocol == GPGME_PROTOCOL_OpenPGP)
                 {
                   clear_keyinfo (&info->pgp);
@@ -917,6 +1327,14 @@ recipient_dlg_set_property (GObject *object, guint prop_id,
 }
 
 
+static void
+recipient_dlg_dispose (GObject *object)
+{
+  detach_lookups (RECIPIENT_DLG (object));
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+
 static void
 recipient_dlg_finalize (GObject *object)
 {
@@ -1007,8 +1425,13 @@ recipient_dlg_constructor (GType type, guint n_construct_properties,
   widget = gtk_separator_new (GTK_ORIENTATION_HORIZONTAL);
   gtk_box_pack_start (GTK_BOX (vbox), widget, FALSE, FALSE, 0);
 
+  hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
+  gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 0);
   dialog->statushint = gtk_label_new (NULL);
-  gtk_box_pack_start (GTK_BOX (vbox), dialog->statushint, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (hbox), dialog->statushint, TRUE, TRUE, 0);
+  dialog->stop_button = gtk_button_new_with_mnemonic (_("_Stop Lookup"));
+  gtk_widget_set_no_show_all (dialog->stop_button, TRUE);
+  gtk_box_pack_end (GTK_BOX (hbox), dialog->stop_button, FALSE, FALSE, 0);
 
 
   g_signal_connect (G_OBJECT (GTK_TREE_VIEW (dialog->clist_keys)),
@@ -1029,6 +1452,9 @@ recipient_dlg_constructor (GType type, guint n_construct_properties,
   g_signal_connect (G_OBJECT (dialog->radio_auto),
                     "toggled",
                     G_CALLBACK (rbutton_toggled_cb), dialog);
+  g_signal_connect_swapped (G_OBJECT (dialog->stop_button),
+                            "clicked",
+                            G_CALLBACK (stop_lookups), dialog);
 
 
   return object;
@@ -1043,6 +1469,7 @@ recipient_dlg_class_init (RecipientDlgClass *klass)
   parent_class = g_type_class_peek_parent (klass);
 
   object_class->constructor = recipient_dlg_constructor;
+  object_class->dispose = recipient_dlg_dispose;
   object_class->finalize = recipient_dlg_finalize;
   object_class->set_property = recipient_dlg_set_property;
   object_class->get_property = recipient_dlg_get_property;
@@ -1159,7 +1586,7 @@ recipient_dlg_set_recipients (RecipientDlg *dialog, GSList *recipients,
         }
     }
 
-  parse_recipients (store);
+  parse_recipients (dialog);
   dialog->freeze_update_statushint--;
   update_statushint (dialog);
 }
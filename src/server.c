@@ -25,7 +25,10 @@
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #ifndef HAVE_W32_SYSTEM
+# include <unistd.h>
 # include <sys/socket.h>
 # include <sys/un.h>
 #endif /*HAVE_W32_SYSTEM*/
@@ -46,15 +49,34 @@
 #include "gpafiledecryptop.h"
 #include "gpafileverifyop.h"
 #include "gpafileimportop.h"
+#include "gpafilechecksumop.h"
 
 
 #define set_error(e,t) assuan_set_error (ctx, gpg_error (e), (t))
 
+/* Counters for GETINFO stats.  */
+struct server_stats_s
+{
+  /* The number of commands received.  */
+  unsigned long commands;
+  /* The number of crypto operations and how many of them failed.  */
+  unsigned long operations;
+  unsigned long failed;
+  /* The number of bytes the operations read from the clients.  */
+  guint64 bytes;
+  /* The time spent in the operations in microseconds.  */
+  guint64 busy_time;
+};
+
 /* The object used to keep track of the a connection's state.  */
 struct conn_ctrl_s;
 typedef struct conn_ctrl_s *conn_ctrl_t;
 struct conn_ctrl_s
 {
+  /* The number of the connection and the time it was accepted.  */
+  unsigned long id;
+  gint64 accept_time;
+
   /* True if we are currently processing a command.  */
   int in_command;
 
@@ -79,6 +101,14 @@ struct conn_ctrl_s
   /* File descriptor set with the MESSAGE command.  */
   int message_fd;
 
+  /* The number of bytes read from the input descriptors by the
+     gpgme callbacks and their total size or 0 if not known.  The
+     callbacks run in the thread of the operation, thus IO_BYTES is
+     only accessed with IO_LOCK held; see add_io_bytes.  */
+  GMutex io_lock;
+  guint64 io_bytes;
+  guint64 io_total;
+
   /* Flag indicating the the output shall be binary.  */
   int output_binary;
 
@@ -106,14 +136,81 @@ struct conn_ctrl_s
   unsigned int session_number;
   char *session_title;
 
-  /* The list of all files to be processed.  */
+  /* The list of all files to be processed in reverse order.  Use
+     take_files to get them.  */
   GList *files;
+
+  /* The channel of the connection and the source ids of its input
+     watch and of the idle handler dispatching commands already
+     buffered by Assuan.  The watch is removed while a command is
+     being processed so that pipelined commands stay queued.  */
+  GIOChannel *channel;
+  unsigned int watch_id;
+  unsigned int dispatch_id;
+
+  /* The statistics of this connection.  */
+  struct server_stats_s stats;
+
+  /* The progress of the running operation: the name to report it
+     under, its context and handler, the timer for repeating the last
+     state, the start time and the time and byte count last
+     reported.  */
+  const char *progress_what;
+  GpaContext *progress_context;
+  gulong progress_handler;
+  unsigned int progress_timer;
+  gint64 progress_start;
+  gint64 progress_sent_time;
+  guint64 progress_sent;
 };
 
 
 /* The number of active connections.  */
 static int connection_counter;
 
+/* The number of connections accepted and the statistics of all
+   connections.  */
+static unsigned long connections_accepted;
+static struct server_stats_s global_stats;
+
+/* The contexts of all active connections.  */
+static GList *connections;
+
+/* The default backlog of the listening socket and the default
+   maximum number of connections served at a time.  */
+#define DEFAULT_SERVER_BACKLOG  64
+#define DEFAULT_MAX_CONNECTIONS 16
+
+/* The values actually used.  */
+static int listen_backlog;
+static int max_connections;
+
+/* Connections accepted while MAX_CONNECTIONS are being served wait
+   in this queue and are served in the order they arrived.  If the
+   queue holds LISTEN_BACKLOG connections, we stop accepting and
+   further clients wait in the backlog of the socket.  */
+struct waiting_conn_s
+{
+  int fd;
+  gint64 since;
+};
+static GQueue waiting_connections = G_QUEUE_INIT;
+
+/* The number of connections which had to wait and the total time in
+   microseconds they waited.  */
+static unsigned long connections_queued;
+static guint64 queue_time;
+
+/* The listening channel and the source id of its watch or 0 if we do
+   not accept right now.  */
+static GIOChannel *listen_channel;
+static unsigned int listen_id;
+
+/* The minimum time in milliseconds between two PROGRESS status
+   lines.  The last state is repeated at this interval if there is no
+   progress so that clients can detect a stall.  */
+#define PROGRESS_INTERVAL 500
+
 /* A flag requesting a shutdown.  */
 static gboolean shutdown_pending;
 
@@ -127,6 +224,11 @@ static assuan_sock_nonce_t socket_nonce;
 
 /* Forward declarations.  */
 static void run_server_continuation (assuan_context_t ctx, gpg_error_t err);
+static void admit_waiting_connections (void);
+static void drop_waiting_connections (void);
+static gboolean accept_connection_cb (GIOChannel *channel,
+                                      GIOCondition condition, void *data);
+static void resume_input (assuan_context_t ctx);
 
 
 
@@ -194,6 +296,32 @@ free_func (void *p, void *dummy)
 }
 
 
+/* Count N bytes read from the client for CTRL.  This is called by
+   the gpgme callbacks in the thread of the operation.  */
+static void
+add_io_bytes (conn_ctrl_t ctrl, gsize n)
+{
+  g_mutex_lock (&ctrl->io_lock);
+  ctrl->io_bytes += n;
+  g_mutex_unlock (&ctrl->io_lock);
+}
+
+
+/* Return the number of bytes read from the client for CTRL.  */
+static guint64
+get_io_bytes (conn_ctrl_t ctrl)
+{
+  guint64 n;
+
+  g_mutex_lock (&ctrl->io_lock);
+  n = ctrl->io_bytes;
+  g_mutex_unlock (&ctrl->io_lock);
+  return n;
+}
+
+
+#ifdef HAVE_W32_SYSTEM
+/* The callbacks used for the channels under Windows.  */
 static ssize_t
 my_gpgme_read_cb (void *opaque, void *buffer, size_t size)
 {
@@ -212,7 +340,10 @@ my_gpgme_read_cb (void *opaque, void *buffer, size_t size)
       retval = -1;
     }
   else if (status == G_IO_STATUS_NORMAL)
-    retval = (int)nread;
+    {
+      retval = (int)nread;
+      add_io_bytes (ctrl, nread);
+    }
   else if (status == G_IO_STATUS_EOF)
     retval = 0;
   else
@@ -280,7 +411,10 @@ my_gpgme_message_read_cb (void *opaque, void *buffer, size_t size)
       retval = -1;
     }
   else if (status == G_IO_STATUS_NORMAL)
-    retval = (int)nread;
+    {
+      retval = (int)nread;
+      add_io_bytes (ctrl, nread);
+    }
   else if (status == G_IO_STATUS_EOF)
     retval = 0;
   else
@@ -299,6 +433,7 @@ static struct gpgme_data_cbs my_gpgme_message_cbs =
     NULL,
     NULL
   };
+#endif /*HAVE_W32_SYSTEM*/
 
 
 static ssize_t
@@ -352,6 +487,18 @@ release_files (conn_ctrl_t ctrl)
 }
 
 
+/* Return the list of files collected by the FILE commands and pass
+   its ownership to the caller.  */
+static GList *
+take_files (conn_ctrl_t ctrl)
+{
+  GList *files = g_list_reverse (ctrl->files);
+
+  ctrl->files = NULL;
+  return files;
+}
+
+
 static void
 release_keys (gpgme_key_t *keys)
 {
@@ -443,6 +590,94 @@ finish_io_streams (assuan_context_t ctx,
 }
 
 
+#ifndef HAVE_W32_SYSTEM
+/* The size of the buffer gpgme uses to copy the data of the client
+   from and to the engine.  The default of gpgme is only a few KiB,
+   which makes large files take many rounds through the event loop.  */
+#define IO_BUFFER_SIZE "1048576"
+
+/* The callbacks used for the descriptors under Unix.  The read
+   callbacks count the bytes for the progress and the statistics.  */
+static ssize_t
+input_read_cb (void *opaque, void *buffer, size_t size)
+{
+  conn_ctrl_t ctrl = opaque;
+  ssize_t nread;
+
+  nread = read (ctrl->input_fd, buffer, size);
+  if (nread > 0)
+    add_io_bytes (ctrl, nread);
+  return nread;
+}
+
+
+static ssize_t
+message_read_cb (void *opaque, void *buffer, size_t size)
+{
+  conn_ctrl_t ctrl = opaque;
+  ssize_t nread;
+
+  nread = read (ctrl->message_fd, buffer, size);
+  if (nread > 0)
+    add_io_bytes (ctrl, nread);
+  return nread;
+}
+
+
+static ssize_t
+output_write_cb (void *opaque, const void *buffer, size_t size)
+{
+  conn_ctrl_t ctrl = opaque;
+
+  return write (ctrl->output_fd, buffer, size);
+}
+
+
+static struct gpgme_data_cbs input_cbs =
+  {
+    input_read_cb,
+    NULL,
+    NULL,
+    NULL
+  };
+
+static struct gpgme_data_cbs message_cbs =
+  {
+    message_read_cb,
+    NULL,
+    NULL,
+    NULL
+  };
+
+static struct gpgme_data_cbs output_cbs =
+  {
+    NULL,
+    output_write_cb,
+    NULL,
+    NULL
+  };
+
+
+/* Create a data object for a descriptor of the client with the
+   callbacks CBS and a large copy buffer.  */
+static gpg_error_t
+new_io_data (gpgme_data_t *r_data, struct gpgme_data_cbs *cbs,
+             conn_ctrl_t ctrl)
+{
+  gpg_error_t err;
+
+  err = gpgme_data_new_from_cbs (r_data, cbs, ctrl);
+  if (err)
+    return err;
+
+  /* Older versions of gpgme do not know this flag; they just use
+     their default buffer size.  */
+  gpgme_data_set_flag (*r_data, "io-buffer-size", IO_BUFFER_SIZE);
+  return 0;
+}
+#endif /*!HAVE_W32_SYSTEM*/
+
+
 /* Translate the input and output file descriptors and return an error
    if they are not set.  */
 static gpg_error_t
@@ -460,6 +695,18 @@ translate_io_streams (assuan_context_t ctx)
 }
 
 
+/* Return the size of FD if it is a regular file or 0.  */
+static guint64
+regular_file_size (int fd)
+{
+  struct stat st;
+
+  if (fstat (fd, &st) || !S_ISREG (st.st_mode))
+    return 0;
+  return st.st_size;
+}
+
+
 static gpg_error_t
 prepare_io_streams (assuan_context_t ctx,
                     gpgme_data_t *r_input_data, gpgme_data_t *r_output_data,
@@ -475,13 +722,25 @@ prepare_io_streams (assuan_context_t ctx,
   if (r_message_data)
     *r_message_data = NULL;
 
+  /* The total is only known if all input comes from regular files.  */
+  g_mutex_lock (&ctrl->io_lock);
+  ctrl->io_bytes = 0;
+  g_mutex_unlock (&ctrl->io_lock);
+  ctrl->io_total = 0;
   if (ctrl->input_fd != -1 && r_input_data)
+    ctrl->io_total = regular_file_size (ctrl->input_fd);
+  if (ctrl->message_fd != -1 && r_message_data && ctrl->io_total)
     {
+      guint64 size = regular_file_size (ctrl->message_fd);
+
+      ctrl->io_total = size? ctrl->io_total + size : 0;
+    }
+
 #ifdef HAVE_W32_SYSTEM
+  /* Under Windows the descriptors are accessed through channels.  */
+  if (ctrl->input_fd != -1 && r_input_data)
+    {
       ctrl->input_channel = g_io_channel_win32_new_fd (ctrl->input_fd);
-#else
-      ctrl->input_channel = g_io_channel_unix_new (ctrl->input_fd);
-#endif
       if (!ctrl->input_channel)
         {
           /* g_debug ("error creating input channel"); */
@@ -494,11 +753,7 @@ prepare_io_streams (assuan_context_t ctx,
 
   if (ctrl->output_fd != -1 && r_output_data)
     {
-#ifdef HAVE_W32_SYSTEM
       ctrl->output_channel = g_io_channel_win32_new_fd (ctrl->output_fd);
-#else
-      ctrl->output_channel = g_io_channel_unix_new (ctrl->output_fd);
-#endif
       if (!ctrl->output_channel)
         {
           g_debug ("error creating output channel");
@@ -511,11 +766,7 @@ prepare_io_streams (assuan_context_t ctx,
 
   if (ctrl->message_fd != -1 && r_message_data)
     {
-#ifdef HAVE_W32_SYSTEM
       ctrl->message_channel = g_io_channel_win32_new_fd (ctrl->message_fd);
-#else
-      ctrl->message_channel = g_io_channel_unix_new (ctrl->message_fd);
-#endif
       if (!ctrl->message_channel)
         {
           g_debug ("error creating message channel");
@@ -537,8 +788,6 @@ prepare_io_streams (assuan_context_t ctx,
       err = gpgme_data_new_from_cbs (r_output_data, &my_gpgme_data_cbs, ctrl);
       if (err)
         goto leave;
-      if (ctrl->output_binary)
-        gpgme_data_set_encoding (*r_output_data, GPGME_DATA_ENCODING_BINARY);
     }
   if (ctrl->message_channel)
     {
@@ -547,6 +796,32 @@ prepare_io_streams (assuan_context_t ctx,
       if (err)
         goto leave;
     }
+#else /*!HAVE_W32_SYSTEM*/
+  /* Access the descriptors directly instead of going through
+     channels.  gpgme copies the data between them and the pipes to
+     the engine with a large buffer.  */
+  if (ctrl->input_fd != -1 && r_input_data)
+    {
+      err = new_io_data (r_input_data, &input_cbs, ctrl);
+      if (err)
+        goto leave;
+    }
+  if (ctrl->output_fd != -1 && r_output_data)
+    {
+      err = new_io_data (r_output_data, &output_cbs, ctrl);
+      if (err)
+        goto leave;
+    }
+  if (ctrl->message_fd != -1 && r_message_data)
+    {
+      err = new_io_data (r_message_data, &message_cbs, ctrl);
+      if (err)
+        goto leave;
+    }
+#endif /*!HAVE_W32_SYSTEM*/
+
+  if (r_output_data && *r_output_data && ctrl->output_binary)
+    gpgme_data_set_encoding (*r_output_data, GPGME_DATA_ENCODING_BINARY);
 
   err = 0;
 
@@ -557,6 +832,128 @@ prepare_io_streams (assuan_context_t ctx,
 }
 
 
+
+/* Send a PROGRESS status line for the running operation of CTX.  The
+   arguments are the name of the command, a question mark as in the
+   status lines of gpg, the bytes read from the client, the total
+   bytes or 0 if not known, and the throughput in MB/s since the
+   previous line.  */
+static void
+send_progress (assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  gint64 now = g_get_monotonic_time ();
+  guint64 io_bytes = get_io_bytes (ctrl);
+  guint64 rate = 0;
+  char line[100];
+
+  /* Bytes per microsecond are MB/s; the rate is kept in tenths.  */
+  if (now > ctrl->progress_sent_time
+      && io_bytes > ctrl->progress_sent)
+    rate = ((io_bytes - ctrl->progress_sent) * 10
+            / (now - ctrl->progress_sent_time));
+
+  snprintf (line, sizeof line,
+            "%s ? %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+            " %" G_GUINT64_FORMAT ".%u",
+            ctrl->progress_what, io_bytes,
+            ctrl->io_total, rate / 10, (unsigned int)(rate % 10));
+  if (!ctrl->client_died)
+    assuan_write_status (ctx, "PROGRESS", line);
+
+  ctrl->progress_sent_time = now;
+  ctrl->progress_sent = io_bytes;
+}
+
+
+/* Handler for the "progress" signal of the running operation.  The
+   values of gpg are scaled for large inputs and do not cover all
+   operations; thus we only use the signal as a hint to report the
+   bytes counted by our callbacks.  */
+static void
+progress_cb (GpaContext *context, int current, int total, void *data)
+{
+  assuan_context_t ctx = data;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  guint64 io_bytes = get_io_bytes (ctrl);
+
+  if ((ctrl->io_total && io_bytes == ctrl->io_total
+       && ctrl->progress_sent != io_bytes)
+      || (g_get_monotonic_time () - ctrl->progress_sent_time
+          >= PROGRESS_INTERVAL * 1000))
+    send_progress (ctx);
+}
+
+
+/* Timer to repeat the last progress while the operation does not
+   report any.  */
+static gboolean
+progress_timer_cb (void *data)
+{
+  assuan_context_t ctx = data;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  if (g_get_monotonic_time () - ctrl->progress_sent_time
+      >= PROGRESS_INTERVAL * 1000)
+    send_progress (ctx);
+  return TRUE;
+}
+
+
+/* Report the progress of OP, which is run by the command WHAT, to the
+   client of CTX until stop_progress is called.  */
+static void
+start_progress (assuan_context_t ctx, GpaOperation *op, const char *what)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  ctrl->progress_what = what;
+  ctrl->progress_context = g_object_ref (op->context);
+  ctrl->progress_handler = g_signal_connect (G_OBJECT (op->context),
+                                             "progress",
+                                             G_CALLBACK (progress_cb), ctx);
+  ctrl->progress_timer = g_timeout_add (PROGRESS_INTERVAL,
+                                        progress_timer_cb, ctx);
+  ctrl->progress_start = g_get_monotonic_time ();
+  ctrl->progress_sent_time = ctrl->progress_start;
+  ctrl->progress_sent = get_io_bytes (ctrl);
+}
+
+
+/* Stop reporting the progress and account the operation which
+   finished with ERR.  */
+static void
+stop_progress (conn_ctrl_t ctrl, gpg_error_t err)
+{
+  guint64 busy_time;
+  guint64 io_bytes;
+
+  if (!ctrl->progress_context)
+    return;
+
+  g_signal_handler_disconnect (ctrl->progress_context,
+                               ctrl->progress_handler);
+  g_object_unref (ctrl->progress_context);
+  ctrl->progress_context = NULL;
+  g_source_remove (ctrl->progress_timer);
+  ctrl->progress_timer = 0;
+
+  busy_time = g_get_monotonic_time () - ctrl->progress_start;
+  ctrl->stats.operations++;
+  io_bytes = get_io_bytes (ctrl);
+  ctrl->stats.bytes += io_bytes;
+  ctrl->stats.busy_time += busy_time;
+  global_stats.operations++;
+  global_stats.bytes += io_bytes;
+  global_stats.busy_time += busy_time;
+  if (err && gpg_err_code (err) != GPG_ERR_CANCELED)
+    {
+      ctrl->stats.failed++;
+      global_stats.failed++;
+    }
+}
+
+
 
 static const char hlp_session[] =
   "SESSION <number> [<string>]\n"
@@ -712,6 +1109,7 @@ cmd_encrypt (assuan_context_t ctx, char *line)
                     G_CALLBACK (g_object_unref), NULL);
   g_signal_connect_swapped (G_OBJECT (op), "status",
 			    G_CALLBACK (assuan_write_status), ctx);
+  start_progress (ctx, GPA_OPERATION (op), "ENCRYPT");
 
   return not_finished (ctrl);
 
@@ -916,6 +1314,7 @@ cmd_sign (assuan_context_t ctx, char *line)
                     G_CALLBACK (g_object_unref), NULL);
   g_signal_connect_swapped (G_OBJECT (op), "status",
 			    G_CALLBACK (assuan_write_status), ctx);
+  start_progress (ctx, GPA_OPERATION (op), "SIGN");
 
   return not_finished (ctrl);
 
@@ -996,6 +1395,7 @@ cmd_decrypt (assuan_context_t ctx, char *line)
                     G_CALLBACK (g_object_unref), NULL);
   g_signal_connect_swapped (G_OBJECT (op), "status",
 			    G_CALLBACK (assuan_write_status), ctx);
+  start_progress (ctx, GPA_OPERATION (op), "DECRYPT");
 
   return not_finished (ctrl);
 
@@ -1131,6 +1531,7 @@ cmd_verify (assuan_context_t ctx, char *line)
                     G_CALLBACK (g_object_unref), NULL);
   g_signal_connect_swapped (G_OBJECT (op), "status",
 			    G_CALLBACK (assuan_write_status), ctx);
+  start_progress (ctx, GPA_OPERATION (op), "VERIFY");
 
   return not_finished (ctrl);
 
@@ -1222,6 +1623,64 @@ cmd_start_confdialog (assuan_context_t ctx, char *line)
 
 
 
+/* Append the counters STATS to TEXT, each on a line with its name
+   prefixed by PREFIX.  The time is given in milliseconds.  */
+static void
+format_stats (GString *text, const char *prefix,
+              struct server_stats_s *stats)
+{
+  g_string_append_printf (text, "%s.commands %lu\n", prefix, stats->commands);
+  g_string_append_printf (text, "%s.operations %lu\n",
+                          prefix, stats->operations);
+  g_string_append_printf (text, "%s.failed %lu\n", prefix, stats->failed);
+  g_string_append_printf (text, "%s.bytes %" G_GUINT64_FORMAT "\n",
+                          prefix, stats->bytes);
+  g_string_append_printf (text, "%s.busy_time %" G_GUINT64_FORMAT "\n",
+                          prefix, stats->busy_time / 1000);
+}
+
+
+/* Return the number of descriptors held by the connection CTX,
+   including the connection itself.  */
+static unsigned int
+count_connection_fds (assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  unsigned int count = 1;
+
+  if (assuan_get_input_fd (ctx) != ASSUAN_INVALID_FD)
+    count++;
+  if (assuan_get_output_fd (ctx) != ASSUAN_INVALID_FD)
+    count++;
+  if (ctrl->message_fd != -1)
+    count++;
+  return count;
+}
+
+
+/* Append the resources held by the connection CTX to TEXT, each on a
+   line with its name prefixed by PREFIX.  */
+static void
+format_resources (GString *text, const char *prefix, assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  g_string_append_printf (text, "%s.fds %u\n",
+                          prefix, count_connection_fds (ctx));
+  g_string_append_printf (text, "%s.files %u\n",
+                          prefix, g_list_length (ctrl->files));
+  g_string_append_printf (text, "%s.recipients %u\n",
+                          prefix, g_slist_length (ctrl->recipients));
+  g_string_append_printf (text, "%s.pending %d\n",
+                          prefix, !!(ctrl->gpa_op || ctrl->cont_cmd));
+  g_string_append_printf (text, "%s.queued %d\n",
+                          prefix, !!assuan_pending_line (ctx));
+  g_string_append_printf (text, "%s.age %" G_GINT64_FORMAT "\n", prefix,
+                          (g_get_monotonic_time () - ctrl->accept_time)
+                          / 1000);
+}
+
+
 static const char hlp_getinfo[] =
   "GETINFO <what>\n"
   "\n"
@@ -1230,7 +1689,15 @@ static const char hlp_getinfo[] =
   "\n"
   "  version     - Return the version of the program.\n"
   "  name        - Return the name of the program\n"
-  "  pid         - Return the process id of the server.";
+  "  pid         - Return the process id of the server.\n"
+  "  stats       - Return the counters of this connection and of\n"
+  "                all connections as \"<name> <value>\" lines.\n"
+  "  connections - Return the resources held by each active\n"
+  "                connection in the same format.\n"
+  "\n"
+  "The resources are the open descriptors (fds), the collected files\n"
+  "and recipients, whether an operation is pending, whether further\n"
+  "commands are queued and the age in milliseconds.";
 static gpg_error_t
 cmd_getinfo (assuan_context_t ctx, char *line)
 {
@@ -1253,6 +1720,44 @@ cmd_getinfo (assuan_context_t ctx, char *line)
       const char *s = PACKAGE_NAME;
       err = assuan_send_data (ctx, s, strlen (s));
     }
+  else if (!strcmp (line, "stats"))
+    {
+      conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+      GString *text = g_string_new (NULL);
+
+      format_stats (text, "conn", &ctrl->stats);
+      format_resources (text, "conn", ctx);
+      format_stats (text, "global", &global_stats);
+      g_string_append_printf (text, "global.connections %lu\n"
+                              "global.active %d\n"
+                              "global.max_connections %d\n"
+                              "global.backlog %d\n"
+                              "global.waiting %u\n"
+                              "global.queued %lu\n"
+                              "global.queue_time %" G_GUINT64_FORMAT "\n",
+                              connections_accepted, connection_counter,
+                              max_connections, listen_backlog,
+                              g_queue_get_length (&waiting_connections),
+                              connections_queued, queue_time / 1000);
+      err = assuan_send_data (ctx, text->str, text->len);
+      g_string_free (text, TRUE);
+    }
+  else if (!strcmp (line, "connections"))
+    {
+      GString *text = g_string_new (NULL);
+      GList *item;
+      char prefix[30];
+
+      for (item = connections; item; item = g_list_next (item))
+        {
+          conn_ctrl_t ctrl = assuan_get_pointer (item->data);
+
+          snprintf (prefix, sizeof prefix, "conn%lu", ctrl->id);
+          format_resources (text, prefix, item->data);
+        }
+      err = assuan_send_data (ctx, text->str, text->len);
+      g_string_free (text, TRUE);
+    }
   else
     err = set_error (GPG_ERR_ASS_PARAMETER, "unknown value for WHAT");
 
@@ -1288,7 +1793,7 @@ cmd_file (assuan_context_t ctx, char *line)
 
   file_item = g_malloc0 (sizeof (*file_item));
   file_item->filename_in = g_strdup (line);
-  ctrl->files = g_list_append (ctrl->files, file_item);
+  ctrl->files = g_list_prepend (ctrl->files, file_item);
 
   return assuan_process_done (ctx, err);
 }
@@ -1302,6 +1807,7 @@ impl_encrypt_sign_files (assuan_context_t ctx, int encr, int sign)
   gpg_error_t err = 0;
   conn_ctrl_t ctrl = assuan_get_pointer (ctx);
   GpaFileOperation *op;
+  GList *files;
 
   if (! ctrl->files)
     {
@@ -1309,22 +1815,23 @@ impl_encrypt_sign_files (assuan_context_t ctx, int encr, int sign)
       return assuan_process_done (ctx, err);
     }
 
+  /* Ownership of the files is passed to the operation.  */
+  files = take_files (ctrl);
+
   /* FIXME: Needs a root window.  Need to set "sign" default.  */
   if (encr && sign)
     op = (GpaFileOperation *)
-      gpa_file_encrypt_sign_operation_new (NULL, ctrl->files, FALSE);
+      gpa_file_encrypt_sign_operation_new (NULL, files, FALSE);
   else if (encr)
     op = (GpaFileOperation *)
-      gpa_file_encrypt_operation_new (NULL, ctrl->files, FALSE);
+      gpa_file_encrypt_operation_new (NULL, files, FALSE);
   else if (sign)
     op = (GpaFileOperation *)
-      gpa_file_sign_operation_new (NULL, ctrl->files, FALSE);
+      gpa_file_sign_operation_new (NULL, files, FALSE);
   else
     op = (GpaFileOperation *)
-      gpa_file_import_operation_new (NULL, ctrl->files);
+      gpa_file_import_operation_new (NULL, files);
 
-  /* Ownership of CTRL->files was passed to callee.  */
-  ctrl->files = NULL;
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), NULL);
 
@@ -1407,6 +1914,7 @@ impl_decrypt_verify_files (assuan_context_t ctx, int decrypt, int verify)
   gpg_error_t err = 0;
   conn_ctrl_t ctrl = assuan_get_pointer (ctx);
   GpaFileOperation *op;
+  GList *files;
 
   if (! ctrl->files)
     {
@@ -1414,19 +1922,20 @@ impl_decrypt_verify_files (assuan_context_t ctx, int decrypt, int verify)
       return assuan_process_done (ctx, err);
     }
 
+  /* Ownership of the files is passed to the operation.  */
+  files = take_files (ctrl);
+
   /* FIXME: Needs a root window.  Need to enable "verify".  */
   if (decrypt && verify)
     op = (GpaFileOperation *)
-      gpa_file_decrypt_verify_operation_new (NULL, ctrl->files);
+      gpa_file_decrypt_verify_operation_new (NULL, files);
   else if (decrypt)
     op = (GpaFileOperation *)
-      gpa_file_decrypt_operation_new (NULL, ctrl->files);
+      gpa_file_decrypt_operation_new (NULL, files);
   else
     op = (GpaFileOperation *)
-      gpa_file_verify_operation_new (NULL, ctrl->files);
+      gpa_file_verify_operation_new (NULL, files);
 
-  /* Ownership of CTRL->files was passed to callee.  */
-  ctrl->files = NULL;
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), NULL);
 
@@ -1527,6 +2036,35 @@ cmd_import_files (assuan_context_t ctx, char *line)
 
 
 
+/* Create or, if VERIFY is set, verify checksum files for the files
+   given by FILE commands.  */
+static gpg_error_t
+impl_checksum_files (assuan_context_t ctx, int verify)
+{
+  gpg_error_t err = 0;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  GpaFileChecksumOperation *op;
+  GList *files;
+
+  if (! ctrl->files)
+    {
+      err = set_error (GPG_ERR_ASS_SYNTAX, "no files specified");
+      return assuan_process_done (ctx, err);
+    }
+
+  /* Ownership of the files is passed to the operation.  */
+  files = take_files (ctrl);
+
+  /* FIXME: Needs a root window.  */
+  op = gpa_file_checksum_operation_new (NULL, files, verify);
+
+  g_signal_connect (G_OBJECT (op), "completed",
+		    G_CALLBACK (g_object_unref), NULL);
+
+  return assuan_process_done (ctx, err);
+}
+
+
 /* CHECKSUM_CREATE_FILES --nohup  */
 static gpg_error_t
 cmd_checksum_create_files (assuan_context_t ctx, char *line)
@@ -1546,8 +2084,7 @@ cmd_checksum_create_files (assuan_context_t ctx, char *line)
       return assuan_process_done (ctx, err);
     }
 
-  err = set_error (GPG_ERR_NOT_IMPLEMENTED, "not implemented");
-  return assuan_process_done (ctx, err);
+  return impl_checksum_files (ctx, 0);
 }
 
 
@@ -1570,8 +2107,7 @@ cmd_checksum_verify_files (assuan_context_t ctx, char *line)
       return assuan_process_done (ctx, err);
     }
 
-  err = set_error (GPG_ERR_NOT_IMPLEMENTED, "not implemented");
-  return assuan_process_done (ctx, err);
+  return impl_checksum_files (ctx, 1);
 }
 
 
@@ -1582,6 +2118,7 @@ cmd_kill_uiserver (assuan_context_t ctx, char *line)
 {
   (void)line;
   shutdown_pending = TRUE;
+  drop_waiting_connections ();
   return assuan_process_done (ctx, 0);
 }
 
@@ -1632,6 +2169,18 @@ output_notify (assuan_context_t ctx, char *line)
 }
 
 
+/* Count the commands for GETINFO stats.  */
+static gpg_error_t
+pre_cmd_notify (assuan_context_t ctx, const char *cmd)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  ctrl->stats.commands++;
+  global_stats.commands++;
+  return 0;
+}
+
+
 
 /* Tell libassuan about our commands.   */
 static int
@@ -1724,13 +2273,18 @@ connection_startup (assuan_fd_t fd)
     }
 
   ctrl = g_malloc0 (sizeof *ctrl);
+  g_mutex_init (&ctrl->io_lock);
   assuan_set_pointer (ctx, ctrl);
   assuan_set_log_stream (ctx, stderr);
   assuan_register_reset_notify (ctx, reset_notify);
   assuan_register_output_notify (ctx, output_notify);
+  assuan_register_pre_cmd_notify (ctx, pre_cmd_notify);
   ctrl->message_fd = -1;
+  ctrl->id = ++connections_accepted;
+  ctrl->accept_time = g_get_monotonic_time ();
 
   connection_counter++;
+  connections = g_list_append (connections, ctx);
   return ctx;
 }
 
@@ -1745,11 +2299,23 @@ connection_finish (assuan_context_t ctx)
       conn_ctrl_t ctrl = assuan_get_pointer (ctx);
 
       reset_notify (ctx, NULL);
+      /* An operation still running at this point lost its client.  */
+      stop_progress (ctrl, gpg_error (GPG_ERR_EPIPE));
+      if (ctrl->watch_id)
+        g_source_remove (ctrl->watch_id);
+      if (ctrl->dispatch_id)
+        g_source_remove (ctrl->dispatch_id);
+      if (ctrl->channel)
+        g_io_channel_unref (ctrl->channel);
+      connections = g_list_remove (connections, ctx);
       assuan_release (ctx);
+      g_mutex_clear (&ctrl->io_lock);
       g_free (ctrl);
       connection_counter--;
       if (!connection_counter && shutdown_pending)
         g_application_quit (G_APPLICATION(get_gpa_application ()));
+      else if (!shutdown_pending)
+        admit_waiting_connections ();
     }
 }
 
@@ -1767,11 +2333,14 @@ run_server_continuation (assuan_context_t ctx, gpg_error_t err)
       g_debug ("no context in gpa_run_server_continuation");
       return;
     }
+  stop_progress (ctrl, err);
   g_debug ("calling gpa_run_server_continuation (%s)", gpg_strerror (err));
   if (!ctrl->cont_cmd)
     {
       g_debug ("no continuation defined; using default");
       assuan_process_done (ctx, err);
+      if (!ctrl->in_command)
+        resume_input (ctx);
     }
   else if (ctrl->client_died)
     {
@@ -1783,11 +2352,88 @@ run_server_continuation (assuan_context_t ctx, gpg_error_t err)
       cont_cmd = ctrl->cont_cmd;
       ctrl->cont_cmd = NULL;
       cont_cmd (ctx, err);
+      /* Now the commands queued meanwhile can be processed.  */
+      if (!ctrl->in_command && !ctrl->cont_cmd)
+        resume_input (ctx);
     }
   g_debug ("leaving gpa_run_server_continuation");
 }
 
 
+/* Process the next command of the connection CTX.  Returns false if
+   the connection has been finished.  */
+static gboolean
+process_next_command (assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  gpg_error_t err;
+  int done = 0;
+
+  ctrl->in_command++;
+  err = assuan_process_next (ctx, &done);
+  ctrl->in_command--;
+  if (err)
+    {
+      g_debug ("assuan_process_next returned: %s <%s>",
+               gpg_strerror (err), gpg_strsource (err));
+    }
+  else
+    {
+      g_debug ("assuan_process_next returned: %s",
+               done ? "done" : "success");
+    }
+  if (gpg_err_code (err) == GPG_ERR_EAGAIN)
+    ; /* Ignore.  */
+  else if (!err && done)
+    {
+      if (ctrl->cont_cmd)
+        {
+          ctrl->client_died = 1; /* Need to delay the cleanup.  */
+          if (ctrl->watch_id)
+            g_source_remove (ctrl->watch_id);
+          ctrl->watch_id = 0;
+        }
+      else
+        connection_finish (ctx);
+      return FALSE;
+    }
+  else if (gpg_err_code (err) == GPG_ERR_UNFINISHED)
+    {
+      if (!ctrl->is_unfinished)
+        {
+          /* It is quite possible that some other subsystem
+             returns that error code.  Tell the user about
+             this curiosity and finish the command.  */
+          g_debug ("note: Unfinished error code not emitted by us");
+          if (ctrl->cont_cmd)
+            g_debug ("OOPS: pending continuation!");
+          assuan_process_done (ctx, err);
+        }
+    }
+  else
+    assuan_process_done (ctx, err);
+
+  return TRUE;
+}
+
+
+/* Idle handler to process the commands which Assuan has already
+   read from the connection.  */
+static gboolean
+dispatch_idle_cb (void *data)
+{
+  assuan_context_t ctx = data;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  ctrl->dispatch_id = 0;
+  if (ctrl->cont_cmd || ctrl->in_command)
+    return FALSE;  /* resume_input reschedules us.  */
+  if (process_next_command (ctx) && !ctrl->cont_cmd)
+    resume_input (ctx);
+  return FALSE;
+}
+
+
 /* This function is called by the main event loop if data can be read
    from the status channel.  */
 static gboolean
@@ -1795,107 +2441,71 @@ receive_cb (GIOChannel *channel, GIOCondition condition, void *data)
 {
   assuan_context_t ctx = data;
   conn_ctrl_t ctrl = assuan_get_pointer (ctx);
-  gpg_error_t err;
 
   assert (ctrl);
   if (condition & G_IO_IN)
     {
       g_debug ("receive_cb");
-      if (ctrl->cont_cmd)
+      if (ctrl->cont_cmd || ctrl->in_command)
         {
-          g_debug ("  input received while waiting for continuation");
-          g_usleep (2000000);
+          /* Leave the input in the socket until the pending command
+             has finished; run_server_continuation resumes us.  */
+          g_debug ("  input received while processing a command; queued");
+          ctrl->watch_id = 0;
+          return FALSE;
         }
-      else if (ctrl->in_command)
-        {
-          g_debug ("  input received while still processing command");
-          g_usleep (2000000);
-        }
-      else
+      if (!process_next_command (ctx))
+        return FALSE; /* Remove from the watch.  */
+      if (ctrl->cont_cmd)
         {
-	  int done = 0;
-          ctrl->in_command++;
-          err = assuan_process_next (ctx, &done);
-          ctrl->in_command--;
-	  if (err)
-	    {
-	      g_debug ("assuan_process_next returned: %s <%s>",
-		       gpg_strerror (err), gpg_strsource (err));
-	    }
-	  else
-	    {
-	      g_debug ("assuan_process_next returned: %s",
-		       done ? "done" : "success");
-	    }
-          if (gpg_err_code (err) == GPG_ERR_EAGAIN)
-            ; /* Ignore.  */
-          else if (!err && done)
-            {
-              if (ctrl->cont_cmd)
-                ctrl->client_died = 1; /* Need to delay the cleanup.  */
-              else
-                connection_finish (ctx);
-              return FALSE; /* Remove from the watch.  */
-            }
-          else if (gpg_err_code (err) == GPG_ERR_UNFINISHED)
-            {
-              if (!ctrl->is_unfinished)
-                {
-                  /* It is quite possible that some other subsystem
-                     returns that error code.  Tell the user about
-                     this curiosity and finish the command.  */
-                  g_debug ("note: Unfinished error code not emitted by us");
-                  if (ctrl->cont_cmd)
-                    g_debug ("OOPS: pending continuation!");
-                  assuan_process_done (ctx, err);
-                }
-            }
-          else
-            assuan_process_done (ctx, err);
+          ctrl->watch_id = 0;
+          return FALSE;
         }
+      /* Several commands may have been read at once.  */
+      if (assuan_pending_line (ctx) && !ctrl->dispatch_id)
+        ctrl->dispatch_id = g_idle_add (dispatch_idle_cb, ctx);
     }
   return TRUE;
 }
 
 
-/* This function is called by the main event loop if the listen fd is
-   readable.  The function runs the accept and prepares the
-   connection.  */
-static gboolean
-accept_connection_cb (GIOChannel *listen_channel,
-                      GIOCondition condition, void *data)
+/* Watch the connection CTX for input again and process the commands
+   which have already been read.  */
+static void
+resume_input (assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  if (!ctrl->channel)
+    return;
+  if (!ctrl->watch_id)
+    ctrl->watch_id = g_io_add_watch (ctrl->channel, G_IO_IN, receive_cb, ctx);
+  if (assuan_pending_line (ctx) && !ctrl->dispatch_id)
+    ctrl->dispatch_id = g_idle_add (dispatch_idle_cb, ctx);
+}
+
+
+/* Start serving the accepted connection at FD.  FD is closed on
+   error.  */
+static void
+serve_connection (int fd)
 {
   gpg_error_t err;
-  int listen_fd, fd;
-  struct sockaddr_un paddr;
-  socklen_t plen = sizeof paddr;
   assuan_context_t ctx;
+  conn_ctrl_t ctrl;
   GIOChannel *channel;
-  unsigned int source_id;
-
-  g_debug ("new connection request");
-#ifdef HAVE_W32_SYSTEM
-  listen_fd = g_io_channel_win32_get_fd (listen_channel);
-#else
-  listen_fd = g_io_channel_unix_get_fd (listen_channel);
-#endif
-  fd = accept (listen_fd, (struct sockaddr *)&paddr, &plen);
-  if (fd == -1)
-    {
-      g_debug ("error accepting connection: %s", strerror (errno));
-      goto leave;
-    }
-  if (assuan_sock_check_nonce ((assuan_fd_t) fd, &socket_nonce))
-    {
-      g_debug ("new connection at fd %d refused", fd);
-      goto leave;
-    }
 
   g_debug ("new connection at fd %d", fd);
   ctx = connection_startup ((assuan_fd_t) fd);
   if (!ctx)
-    goto leave;
+    {
+      assuan_sock_close ((assuan_fd_t) fd);
+      return;
+    }
+  ctrl = assuan_get_pointer (ctx);
 
+  /* From now on, connection_finish releases the slot of the
+     connection and closes FD along with CTX.  */
 #ifdef HAVE_W32_SYSTEM
   channel = g_io_channel_win32_new_socket (fd);
 #else
@@ -1904,31 +2514,130 @@ accept_connection_cb (GIOChannel *listen_channel,
   if (!channel)
     {
       g_debug ("error creating a channel for fd %d\n", fd);
-      goto leave;
+      connection_finish (ctx);
+      return;
     }
   g_io_channel_set_encoding (channel, NULL, NULL);
   g_io_channel_set_buffered (channel, FALSE);
+  ctrl->channel = channel;
 
-  source_id = g_io_add_watch (channel, G_IO_IN, receive_cb, ctx);
-  if (!source_id)
+  ctrl->watch_id = g_io_add_watch (channel, G_IO_IN, receive_cb, ctx);
+  if (!ctrl->watch_id)
     {
       g_debug ("error creating watch for fd %d", fd);
-      g_io_channel_shutdown (channel, 0, NULL);
-      goto leave;
+      connection_finish (ctx);
+      return;
     }
   err = assuan_accept (ctx);
   if (err)
     {
       g_debug ("assuan accept failed: %s", gpg_strerror (err));
-      g_io_channel_shutdown (channel, 0, NULL);
-      goto leave;
+      connection_finish (ctx);
+      return;
     }
   g_debug ("connection at fd %d ready", fd);
-  fd = -1;
+}
 
- leave:
-  if (fd != -1)
-    assuan_sock_close ((assuan_fd_t) fd);
+
+/* Serve the waiting connections for which there is room now and
+   start accepting again if the wait queue is no longer full.  */
+static void
+admit_waiting_connections (void)
+{
+  struct waiting_conn_s *waiting;
+
+  while (connection_counter < max_connections
+         && (waiting = g_queue_pop_head (&waiting_connections)))
+    {
+      queue_time += g_get_monotonic_time () - waiting->since;
+      serve_connection (waiting->fd);
+      g_free (waiting);
+    }
+
+  if (listen_channel && !listen_id
+      && g_queue_get_length (&waiting_connections) < (guint)listen_backlog)
+    {
+      g_debug ("accepting connections again");
+      listen_id = g_io_add_watch (listen_channel, G_IO_IN,
+                                  accept_connection_cb, NULL);
+    }
+}
+
+
+/* Stop accepting and close all waiting connections.  This is used
+   on shutdown; the connections being served are finished normally.  */
+static void
+drop_waiting_connections (void)
+{
+  struct waiting_conn_s *waiting;
+
+  if (listen_id)
+    {
+      g_source_remove (listen_id);
+      listen_id = 0;
+    }
+  while ((waiting = g_queue_pop_head (&waiting_connections)))
+    {
+      g_debug ("closing waiting connection at fd %d", waiting->fd);
+      assuan_sock_close ((assuan_fd_t) waiting->fd);
+      g_free (waiting);
+    }
+}
+
+
+/* This function is called by the main event loop if the listen fd is
+   readable.  The function runs the accept and prepares the
+   connection or queues it if too many connections are active.  */
+static gboolean
+accept_connection_cb (GIOChannel *channel,
+                      GIOCondition condition, void *data)
+{
+  int listen_fd, fd;
+  struct sockaddr_un paddr;
+  socklen_t plen = sizeof paddr;
+  struct waiting_conn_s *waiting;
+
+  g_debug ("new connection request");
+#ifdef HAVE_W32_SYSTEM
+  listen_fd = g_io_channel_win32_get_fd (channel);
+#else
+  listen_fd = g_io_channel_unix_get_fd (channel);
+#endif
+  fd = accept (listen_fd, (struct sockaddr *)&paddr, &plen);
+  if (fd == -1)
+    {
+      g_debug ("error accepting connection: %s", strerror (errno));
+      return TRUE;
+    }
+  if (assuan_sock_check_nonce ((assuan_fd_t) fd, &socket_nonce))
+    {
+      g_debug ("new connection at fd %d refused", fd);
+      assuan_sock_close ((assuan_fd_t) fd);
+      return TRUE;
+    }
+
+  /* Connections which arrive while others are waiting go to the end
+     of the queue so that nobody can overtake.  */
+  if (connection_counter < max_connections
+      && g_queue_is_empty (&waiting_connections))
+    {
+      serve_connection (fd);
+      return TRUE;
+    }
+
+  g_debug ("connection at fd %d has to wait", fd);
+  waiting = g_malloc (sizeof *waiting);
+  waiting->fd = fd;
+  waiting->since = g_get_monotonic_time ();
+  g_queue_push_tail (&waiting_connections, waiting);
+  connections_queued++;
+  if (g_queue_get_length (&waiting_connections) >= (guint)listen_backlog)
+    {
+      /* Leave further clients in the backlog of the socket.  */
+      g_debug ("too many waiting connections; not accepting");
+      listen_id = 0;
+      return FALSE;
+    }
   return TRUE; /* Keep the listen_fd in the event loop.  */
 }
 
@@ -1999,7 +2708,10 @@ gpa_start_server (void)
   g_free (socket_name);
   socket_name = NULL;
 
-  if (listen ((int) fd, 5) == -1)
+  listen_backlog = server_backlog > 0? server_backlog : DEFAULT_SERVER_BACKLOG;
+  max_connections = (server_max_connections > 0? server_max_connections
+                     : DEFAULT_MAX_CONNECTIONS);
+  if (listen ((int) fd, listen_backlog) == -1)
     {
       g_debug ("listen() failed: %s\n", strerror (errno));
       assuan_sock_close (fd);
@@ -2027,7 +2739,8 @@ gpa_start_server (void)
       assuan_sock_close (fd);
       return;
     }
-
+  listen_channel = channel;
+  listen_id = source_id;
 }
 
 /* Set a flag to shutdown the server in a friendly way.  */
@@ -2035,6 +2748,7 @@ void
 gpa_stop_server (void)
 {
   shutdown_pending = TRUE;
+  drop_waiting_connections ();
   if (!connection_counter)
     g_application_quit (G_APPLICATION(get_gpa_application ()));
 }
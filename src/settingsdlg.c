@@ -98,6 +98,13 @@ struct _SettingsDlg
     char *ip_addr;    /* Malloced server address or NULL.  */
   } akl;
 
+  /* Data for the file operations frame.  */
+  struct {
+    GtkWidget *frame;
+    GtkSpinButton *workers;
+    GtkToggleButton *keep_going;
+  } fileop;
+
 };
 
 struct _SettingsDlgClass
@@ -176,6 +183,7 @@ update_show_advanced_options (SettingsDlg *dialog)
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
       if (dialog->akl.enabled)
         gtk_widget_show_all (dialog->akl.frame);
+      gtk_widget_show_all (dialog->fileop.frame);
     }
   else
     {
@@ -185,6 +193,7 @@ update_show_advanced_options (SettingsDlg *dialog)
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
       if (dialog->akl.enabled)
         gtk_widget_hide (dialog->akl.frame);
+      gtk_widget_hide (dialog->fileop.frame);
     }
 }
 
@@ -701,6 +710,64 @@ auto_key_locate_frame (SettingsDlg *dialog)
   return frame;
 }
 
+
+/*
+   File operations section.
+ */
+static void
+fileop_changed_cb (SettingsDlg *dialog)
+{
+  update_modified (dialog, 1);
+}
+
+
+static GtkWidget *
+file_operations_frame (SettingsDlg *dialog)
+{
+  GtkWidget *frame;
+  GtkWidget *label;
+  GtkWidget *frame_vbox;
+  GtkWidget *hbox;
+  GtkWidget *spin;
+  GtkWidget *button;
+
+  /* Build UI.  */
+  frame = gtk_frame_new (NULL);
+  gtk_frame_set_shadow_type (GTK_FRAME (frame), GTK_SHADOW_NONE);
+  label = gtk_label_new (_("<b>File operations</b>"));
+  gtk_label_set_use_markup (GTK_LABEL (label), TRUE);
+  gtk_frame_set_label_widget (GTK_FRAME (frame), label);
+
+  frame_vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  gtk_container_add (GTK_CONTAINER (frame), frame_vbox);
+
+  hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 5);
+  gtk_container_add (GTK_CONTAINER (frame_vbox), hbox);
+  label = gtk_label_new_with_mnemonic (_("_Files processed at a time:"));
+  gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
+  /* 0 selects a value based on the number of processors.  */
+  spin = gtk_spin_button_new_with_range (0, 64, 1);
+  gtk_widget_set_tooltip_text (spin, _("Use 0 to select the number "
+                                       "automatically."));
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), spin);
+  gtk_box_pack_start (GTK_BOX (hbox), spin, FALSE, FALSE, 0);
+  dialog->fileop.workers = GTK_SPIN_BUTTON (spin);
+  g_signal_connect_swapped (G_OBJECT (spin), "value-changed",
+                            G_CALLBACK (fileop_changed_cb), dialog);
+
+  button = gtk_check_button_new_with_mnemonic
+    (_("_Continue with the next file after an error"));
+  gtk_container_add (GTK_CONTAINER (frame_vbox), button);
+  dialog->fileop.keep_going = GTK_TOGGLE_BUTTON (button);
+  g_signal_connect_swapped (G_OBJECT (button), "toggled",
+                            G_CALLBACK (fileop_changed_cb), dialog);
+
+  dialog->fileop.frame = frame;
+
+  return frame;
+}
+
+
 /* Update the state of the action buttons.  */
 static void
 update_modified (SettingsDlg *dialog, int is_modified)
@@ -751,6 +818,12 @@ load_settings (SettingsDlg *dialog)
   if (dialog->akl.enabled)
     parse_akl (dialog);
 
+  /* File operations section.  */
+  gtk_spin_button_set_value (dialog->fileop.workers,
+                             gpa_options_get_file_workers (options));
+  gtk_toggle_button_set_active (dialog->fileop.keep_going,
+                                !!gpa_options_get_keep_going (options));
+
 
   update_modified (dialog, 0);
 }
@@ -804,6 +877,13 @@ save_settings (SettingsDlg *dialog)
                                        dialog->keyserver.url);
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 
+  gpa_options_set_file_workers
+    (gpa_options_get_instance (),
+     gtk_spin_button_get_value_as_int (dialog->fileop.workers));
+  gpa_options_set_keep_going
+    (gpa_options_get_instance (),
+     gtk_toggle_button_get_active (dialog->fileop.keep_going));
+
   if (!dialog->akl.enabled)
     ;
   else if (dialog->akl.method_idx == -1)
@@ -968,6 +1048,10 @@ settings_dlg_constructor (GType type, guint n_construct_properties,
                           FALSE, FALSE, 0);
     }
 
+  /* The file operations section.  */
+  frame = file_operations_frame (dialog);
+  gtk_box_pack_start (GTK_BOX (box), frame, FALSE, FALSE, 0);
+
   /* Connect the response signal.  */
   g_signal_connect (G_OBJECT (dialog), "response",
                     G_CALLBACK (dialog_response), NULL);